@@ -3723,8 +3723,11 @@ FS_API fs_result fs_file_open_or_info(fs* pFS,
             opening the file. It's not necessary if we're just grabbing file
             info.
             */
-            if (ppFile != NULL) {
-              fs_increment_opened_archive_ref_count(pFS, iMountPoint.pArchive);
+            if (ppFile != NULL &&
+                fs_increment_opened_archive_ref_count(
+                    pFS, iMountPoint.pArchive) > 0) {
+              /* The reference must be given back when the file is closed. */
+              fs_file_proxy_set_unref_archive_on_close(*ppFile, FS_TRUE);
             }
 
             return FS_SUCCESS;
@@ -4168,7 +4171,8 @@ static fs_iterator_item* fs_iterator_internal_find(
   for (iItem = 0; iItem < pIterator->itemCount; iItem += 1) {
     fs_iterator_item* pItem = (fs_iterator_item*)FS_OFFSET_PTR(
         pIterator, sizeof(fs_iterator_internal) + cursor);
-    if (fs_strncmp(fs_iterator_item_name(pItem), pName, pItem->nameLen) == 0) {
+    if (fs_strncmp(fs_iterator_item_name(pItem), pName, pItem->nameLen) == 0 &&
+        pName[pItem->nameLen] == '\0') {
       return pItem;
     }
 
@@ -1,5 +1,12 @@
 ---@diagnostic disable: undefined-global
 
+-- SIMD kernels are only compiled in when the compiler targets a CPU that has
+-- them, the default x86-64 baseline stops at SSE2
+newoption {
+  trigger = "native",
+  description = "Tune for the build host, enables its AVX2/SSSE3/NEON paths"
+}
+
 workspace "ProjectWorkspace"
   configurations { "Debug", "Release" }
   location "."
@@ -15,6 +22,9 @@ workspace "ProjectWorkspace"
     defines { "NDEBUG" }
     optimize "Speed"
 
+  filter "options:native"
+    buildoptions { "-march=native" }
+
 -- Rxi Log Library
 project "mk_log"
   kind "StaticLib"
@@ -90,19 +100,75 @@ project "mk_sqt"
     "src/pak/*.c",
     "src/lmp/*.c",
     "src/wad/*.c",
+    "src/img/*.c",
+    "src/vfs/*.c",
+    "src/pk3/*.c",
+    "src/pakz/*.c",
     "src/ui/*.c",
   }
   includedirs {"src", "deps"}
   links { "mk_log:static", "mk_args:static", "mk_fs:static", "mk_stb:static", "mk_sokol:static" }
   buildoptions { "-std=c2x" }
   defines { "SOKOL_GLCORE" }
-  defines { "_POSIX_C_SOURCE=199309L" }  -- Needed for some C23 features
+  defines { "_POSIX_C_SOURCE=200809L" }  -- Needed for pread and some C23 features
 
   filter "system:macosx"
     links { "Cocoa.framework", "OpenGL.framework", "IOKit.framework" }
+    defines { "_DARWIN_C_SOURCE" }  -- F_NOCACHE for direct writes
 
   filter "system:linux"
-    links { "X11", "Xi", "Xcursor", "GL", "m" }
+    links { "X11", "Xi", "Xcursor", "GL", "m", "pthread" }
+    defines { "_GNU_SOURCE" }  -- O_DIRECT and posix_fallocate
+
+-- Tests
+project "mk_tests"
+  kind "ConsoleApp"
+  language "C"
+  location "BUILD"
+  targetdir "BUILD"
+  objdir "BUILD"
+  targetname "tests"
+  files {
+    "tests/*.c",
+    "src/pak/*.c",
+    "src/lmp/*.c",
+    "src/wad/*.c",
+    "src/img/*.c",
+    "src/vfs/*.c",
+    "src/pk3/*.c",
+    "src/pakz/*.c",
+  }
+  includedirs {"src", "deps"}
+  links { "mk_log:static", "mk_fs:static", "mk_stb:static" }
+  buildoptions { "-std=c2x" }
+  defines { "_POSIX_C_SOURCE=200809L" }
+
+  filter "system:macosx"
+    defines { "_DARWIN_C_SOURCE" }
+
+  filter "system:linux"
+    links { "m", "pthread" }
+    defines { "_GNU_SOURCE" }
+
+-- Test Action
+newaction {
+  trigger = "test",
+  description = "Run the tests against BUILD/",
+  execute = function()
+    local units = os.execute("BUILD/tests")
+    local trips = os.execute("tests/roundtrip.sh BUILD/sqt")
+    os.exit(units and trips and 0 or 1)
+  end
+}
+
+-- Benchmark Action
+newaction {
+  trigger = "bench",
+  description = "Time the pixel kernels in BUILD/ (build config=release)",
+  execute = function()
+    os.exit(os.execute("BUILD/tests --bench") and 0 or 1)
+  end
+}
 
 -- GLSL Shader Compilation Action
 newaction {
@@ -1,23 +1,62 @@
 #include <stdbool.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "../../deps/optparse.h"
+#include "../utils/types.h"
+
+bool cmd_lmp_info(char **argv);
+bool cmd_lmp_decode(char **argv);
+bool cmd_lmp_encode(char **argv);
+bool cmd_lmp_colormap(char **argv);
+
+static struct optparse_long opts[] = {{"help", 'h', OPTPARSE_NONE}, {0}};
+
+static const struct {
+  char name[16];
+  bool (*cmd)(char **);
+} cmds[] = {{"info", cmd_lmp_info},
+            {"decode", cmd_lmp_decode},
+            {"encode", cmd_lmp_encode},
+            {"colormap", cmd_lmp_colormap}};
+
+static void usage() {
+  printf("usage: sqt lmp [-h] <info|decode|encode|colormap> [OPTION]...\n");
+}
 
 bool cmd_lmp(char **argv) {
-  int i, option;
-  struct optparse options;
+  struct optparse optp;
+  optparse_init(&optp, argv);
+  optp.permute = 0;
 
-  optparse_init(&options, argv);
-  while ((option = optparse(&options, "h")) != -1) {
-    switch (option) {
+  int opt;
+  while ((opt = optparse_long(&optp, opts, NULL)) != -1) {
+    switch (opt) {
     case 'h':
-      puts("usage: sleep [-h] [NUMBER]...");
+      usage();
       return true;
+
     case '?':
-      printf("%s: %s\n", argv[0], options.errmsg);
+      usage();
+      printf("%s: %s\n", argv[0], optp.errmsg);
       return false;
     }
   }
 
-  return true;
+  char **subargv = argv + optp.optind;
+  if (!subargv[0]) {
+    printf("%s: missing subcommand\n", argv[0]);
+    usage();
+    return false;
+  }
+
+  int cmdsln = sizeof(cmds) / sizeof(*cmds);
+  for (u8 i = 0; i < cmdsln; i++) {
+    if (!strcmp(cmds[i].name, subargv[0])) {
+      return cmds[i].cmd(subargv);
+    }
+  }
+
+  printf("%s: invalid subcommand: %s\n", argv[0], subargv[0]);
+  return false;
 }
@@ -0,0 +1,79 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../../deps/optparse.h"
+#include "../lmp/lmp.h"
+
+static struct optparse_long opts[] = {{"help", 'h', OPTPARSE_NONE},
+                                      {"palette", 'p', OPTPARSE_REQUIRED},
+                                      {"output", 'o', OPTPARSE_REQUIRED},
+                                      {"mod", 'M', OPTPARSE_REQUIRED},
+                                      {"levels", 'l', OPTPARSE_REQUIRED},
+                                      {"brights", 'b', OPTPARSE_REQUIRED},
+                                      {"range", 'r', OPTPARSE_REQUIRED},
+                                      {0}};
+
+static void _usage() {
+  printf(
+      "usage: sqt lmp colormap (-p [PALETTE] -o [FILE] | --mod [DIR]) "
+      "[--levels N] [--brights N] [--range F]\n");
+}
+
+static bool _lmp_colormap(cstr pal, cstr fp, cstr mod, const lmp_opts* o) {
+  arena m = {0};
+  lmperr e = mod ? lmp_colormap_mod(&m, mod, o) : lmp_colormap(&m, pal, fp, o);
+  arena_finish(&m);
+  return e == LMP_ERR_OK;
+}
+
+bool cmd_lmp_colormap(char** argv) {
+  struct optparse optp;
+  optparse_init(&optp, argv);
+  optp.permute = 0;
+
+  cstr pal = NULL;
+  cstr output = NULL;
+  cstr mod = NULL;
+  lmp_opts lo = {.brights = LMP_COLORMAP_BRIGHTS};
+
+  int opt;
+  while ((opt = optparse_long(&optp, opts, NULL)) != -1) {
+    switch (opt) {
+      case 'h':
+        _usage();
+        return true;
+      case 'p':
+        pal = optp.optarg;
+        break;
+      case 'o':
+        output = optp.optarg;
+        break;
+      case 'M':
+        mod = optp.optarg;
+        break;
+      case 'l':
+        lo.levels = (u32)strtoul(optp.optarg, NULL, 10);
+        break;
+      case 'b':
+        lo.brights = (u32)strtoul(optp.optarg, NULL, 10);
+        break;
+      case 'r':
+        lo.range = strtof(optp.optarg, NULL);
+        break;
+      case '?':
+        _usage();
+        printf("%s: %s\n", argv[0], optp.errmsg);
+        return false;
+    }
+  }
+
+  if (mod || (pal && output)) {
+    _lmp_colormap(pal, output, mod, &lo);
+  } else {
+    _usage();
+  }
+
+  return true;
+}
@@ -0,0 +1,75 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../../deps/optparse.h"
+#include "../lmp/lmp.h"
+
+static struct optparse_long opts[] = {{"help", 'h', OPTPARSE_NONE},
+                                      {"output", 'o', OPTPARSE_REQUIRED},
+                                      {"palette", 'p', OPTPARSE_REQUIRED},
+                                      {"level", 'l', OPTPARSE_REQUIRED},
+                                      {0}};
+
+static void _usage() {
+  printf(
+      "usage: sqt lmp decode -o [DIR] [-p PALETTE] [--level 0-9] "
+      "[FILE]...\n");
+}
+
+static bool _lmp_decode(cstr* files, u32 count, cstr dir, const lmp_opts* o) {
+  arena m = {0};
+  lmperr e = lmp_decode(&m, files, count, dir, o);
+  arena_finish(&m);
+  return e == LMP_ERR_OK;
+}
+
+bool cmd_lmp_decode(char** argv) {
+  struct optparse optp;
+  optparse_init(&optp, argv);
+  optp.permute = 0;
+
+  cstr output = NULL;
+  lmp_opts lo = {.level = PNG_LEVEL_DEFAULT};
+
+  int opt;
+  while ((opt = optparse_long(&optp, opts, NULL)) != -1) {
+    switch (opt) {
+      case 'h':
+        _usage();
+        return true;
+      case 'o':
+        output = optp.optarg;
+        break;
+      case 'p':
+        lo.palette = optp.optarg;
+        break;
+      case 'l':
+        if (!png_level_parse(optp.optarg, &lo.level)) {
+          _usage();
+          printf("%s: invalid level '%s', expected 0-9\n", argv[0],
+                 optp.optarg);
+          return false;
+        }
+        break;
+      case '?':
+        _usage();
+        printf("%s: %s\n", argv[0], optp.errmsg);
+        return false;
+    }
+  }
+
+  cstr* files = (cstr*)argv + optp.optind;
+  u32 count = 0;
+  while (files[count])
+    count++;
+
+  if (output && count) {
+    _lmp_decode(files, count, output, &lo);
+  } else {
+    _usage();
+  }
+
+  return true;
+}
@@ -0,0 +1,67 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "../../deps/optparse.h"
+#include "../lmp/lmp.h"
+
+static struct optparse_long opts[] = {{"help", 'h', OPTPARSE_NONE},
+                                      {"output", 'o', OPTPARSE_REQUIRED},
+                                      {"palette", 'p', OPTPARSE_REQUIRED},
+                                      {"fast", 'f', OPTPARSE_NONE},
+                                      {0}};
+
+static void _usage() {
+  printf("usage: sqt lmp encode -o [DIR] -p [PALETTE] [--fast] [IMAGE]...\n");
+}
+
+static bool _lmp_encode(cstr* files, u32 count, cstr dir, const lmp_opts* o) {
+  arena m = {0};
+  lmperr e = lmp_encode(&m, files, count, dir, o);
+  arena_finish(&m);
+  return e == LMP_ERR_OK;
+}
+
+bool cmd_lmp_encode(char** argv) {
+  struct optparse optp;
+  optparse_init(&optp, argv);
+  optp.permute = 0;
+
+  cstr output = NULL;
+  lmp_opts lo = {0};
+
+  int opt;
+  while ((opt = optparse_long(&optp, opts, NULL)) != -1) {
+    switch (opt) {
+      case 'h':
+        _usage();
+        return true;
+      case 'o':
+        output = optp.optarg;
+        break;
+      case 'p':
+        lo.palette = optp.optarg;
+        break;
+      case 'f':
+        lo.fast = true;
+        break;
+      case '?':
+        _usage();
+        printf("%s: %s\n", argv[0], optp.errmsg);
+        return false;
+    }
+  }
+
+  cstr* files = (cstr*)argv + optp.optind;
+  u32 count = 0;
+  while (files[count])
+    count++;
+
+  if (output && lo.palette && count) {
+    _lmp_encode(files, count, output, &lo);
+  } else {
+    _usage();
+  }
+
+  return true;
+}
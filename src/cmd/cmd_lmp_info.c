@@ -0,0 +1,49 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "../../deps/optparse.h"
+#include "../lmp/lmp.h"
+
+static struct optparse_long opts[] = {{"help", 'h', OPTPARSE_NONE}, {0}};
+
+static void _usage() { printf("usage: sqt lmp info [FILE]...\n"); }
+
+static bool _lmp_info(cstr* files, u32 count) {
+  arena m = {0};
+  lmperr e = lmp_info(&m, files, count);
+  arena_finish(&m);
+  return e == LMP_ERR_OK;
+}
+
+bool cmd_lmp_info(char** argv) {
+  struct optparse optp;
+  optparse_init(&optp, argv);
+  optp.permute = 0;
+
+  int opt;
+  while ((opt = optparse_long(&optp, opts, NULL)) != -1) {
+    switch (opt) {
+      case 'h':
+        _usage();
+        return true;
+      case '?':
+        _usage();
+        printf("%s: %s\n", argv[0], optp.errmsg);
+        return false;
+    }
+  }
+
+  cstr* files = (cstr*)argv + optp.optind;
+  u32 count = 0;
+  while (files[count])
+    count++;
+
+  if (count) {
+    _lmp_info(files, count);
+  } else {
+    _usage();
+  }
+
+  return true;
+}
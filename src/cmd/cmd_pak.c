@@ -9,6 +9,14 @@ bool cmd_pak_info(char **argv);
 bool cmd_pak_list(char **argv);
 bool cmd_pak_extract(char **argv);
 bool cmd_pak_create(char **argv);
+bool cmd_pak_export(char **argv);
+bool cmd_pak_resolve(char **argv);
+bool cmd_pak_convert(char **argv);
+bool cmd_pak_deflate(char **argv);
+bool cmd_pak_inflate(char **argv);
+bool cmd_pak_cat(char **argv);
+bool cmd_pak_compact(char **argv);
+bool cmd_pak_grep(char **argv);
 
 static struct optparse_long opts[] = {{"help", 'h', OPTPARSE_NONE}, {0}};
 
@@ -18,10 +26,20 @@ static const struct {
 } cmds[] = {{"info", cmd_pak_info},
             {"list", cmd_pak_list},
             {"extract", cmd_pak_extract},
-            {"create", cmd_pak_create}};
+            {"create", cmd_pak_create},
+            {"export", cmd_pak_export},
+            {"resolve", cmd_pak_resolve},
+            {"convert", cmd_pak_convert},
+            {"deflate", cmd_pak_deflate},
+            {"inflate", cmd_pak_inflate},
+            {"cat", cmd_pak_cat},
+            {"compact", cmd_pak_compact},
+            {"grep", cmd_pak_grep}};
 
 static void usage() {
-  printf("usage: sqt pack [-h] <info|list|extract|create> [OPTION]...\n");
+  printf(
+      "usage: sqt pack [-h] <info|list|extract|create|export|resolve|"
+      "convert|deflate|inflate|cat|compact|grep> [OPTION]...\n");
 }
 
 bool cmd_pak(char **argv) {
@@ -0,0 +1,66 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "../../deps/optparse.h"
+#include "../pakz/pakz.h"
+
+static struct optparse_long opts[] = {{"help", 'h', OPTPARSE_NONE},
+                                      {"input", 'i', OPTPARSE_REQUIRED},
+                                      {"output", 'o', OPTPARSE_REQUIRED},
+                                      {0}};
+
+static void _usage() {
+  printf(
+      "usage: sqt pack cat -i [FILE] [-o OUT] [NAME]...\n"
+      "       entries of a deflated pak, written to stdout without -o\n");
+}
+
+static bool _pak_cat(cstr fp, cstr* names, u32 count, cstr out) {
+  arena m = {0};
+  pakz z = {0};
+  pakzerr e = pakz_cat(&m, fp, names, count, out, &z);
+  arena_finish(&m);
+  return e == PAKZ_ERR_OK;
+}
+
+bool cmd_pak_cat(char** argv) {
+  struct optparse optp;
+  optparse_init(&optp, argv);
+  optp.permute = 0;
+
+  cstr input = NULL;
+  cstr output = NULL;
+
+  int opt;
+  while ((opt = optparse_long(&optp, opts, NULL)) != -1) {
+    switch (opt) {
+      case 'h':
+        _usage();
+        return true;
+      case 'i':
+        input = optp.optarg;
+        break;
+      case 'o':
+        output = optp.optarg;
+        break;
+      case '?':
+        _usage();
+        printf("%s: %s\n", argv[0], optp.errmsg);
+        return false;
+    }
+  }
+
+  cstr* names = (cstr*)argv + optp.optind;
+  u32 names_count = 0;
+  while (names[names_count])
+    names_count++;
+
+  if (input && names_count) {
+    return _pak_cat(input, names, names_count, output);
+  } else {
+    _usage();
+  }
+
+  return true;
+}
@@ -0,0 +1,75 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../../deps/optparse.h"
+#include "../pak/pak.h"
+
+static struct optparse_long opts[] = {{"help", 'h', OPTPARSE_NONE},
+                                      {"input", 'i', OPTPARSE_REQUIRED},
+                                      {"output", 'o', OPTPARSE_REQUIRED},
+                                      {"direct", 'd', OPTPARSE_NONE},
+                                      {"order", 't', OPTPARSE_REQUIRED},
+                                      {"align", 'a', OPTPARSE_REQUIRED},
+                                      {0}};
+
+static void _usage() {
+  printf(
+      "usage: sqt pack compact -i [FILE] -o [FILE] [--direct] "
+      "[--order TRACE] [--align N]\n");
+}
+
+static bool _pak_compact(cstr fp, cstr op, const pak_opts* o) {
+  arena m = {0};
+  pak p = {0};
+  pakerr e = pak_compact(&m, fp, op, o, &p);
+  arena_finish(&m);
+  return e == PAK_ERR_OK;
+}
+
+bool cmd_pak_compact(char** argv) {
+  struct optparse optp;
+  optparse_init(&optp, argv);
+  optp.permute = 0;
+
+  cstr input = NULL;
+  cstr output = NULL;
+  pak_opts po = {0};
+
+  int opt;
+  while ((opt = optparse_long(&optp, opts, NULL)) != -1) {
+    switch (opt) {
+      case 'h':
+        _usage();
+        return true;
+      case 'i':
+        input = optp.optarg;
+        break;
+      case 'o':
+        output = optp.optarg;
+        break;
+      case 'd':
+        po.direct = true;
+        break;
+      case 't':
+        po.order = optp.optarg;
+        break;
+      case 'a':
+        po.align = (u32)strtoul(optp.optarg, NULL, 10);
+        break;
+      case '?':
+        _usage();
+        printf("%s: %s\n", argv[0], optp.errmsg);
+        return false;
+    }
+  }
+
+  if (input && output) {
+    _pak_compact(input, output, &po);
+  } else {
+    _usage();
+  }
+
+  return true;
+}
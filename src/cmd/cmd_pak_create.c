@@ -1,3 +1,81 @@
 #include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
-bool cmd_pak_create(char **argv) { return 0; }
+#include "../../deps/optparse.h"
+#include "../pak/pak.h"
+
+static struct optparse_long opts[] = {{"help", 'h', OPTPARSE_NONE},
+                                      {"input", 'i', OPTPARSE_REQUIRED},
+                                      {"output", 'o', OPTPARSE_REQUIRED},
+                                      {"direct", 'd', OPTPARSE_NONE},
+                                      {"order", 't', OPTPARSE_REQUIRED},
+                                      {"align", 'a', OPTPARSE_REQUIRED},
+                                      {"watch", 'w', OPTPARSE_NONE},
+                                      {0}};
+
+static void _usage() {
+  printf(
+      "usage: sqt pack create -i [DIR] -o [FILE] [--direct] "
+      "[--order TRACE] [--align N] [--watch]\n");
+}
+
+static bool _pak_create(cstr dir, cstr fp, const pak_opts* o, bool watch) {
+  arena m = {0};
+  pak p = {0};
+  pakerr e = watch ? pak_watch(&m, dir, fp, o, &p)
+                   : pak_create(&m, dir, fp, o, &p);
+  arena_finish(&m);
+  return e == PAK_ERR_OK;
+}
+
+bool cmd_pak_create(char** argv) {
+  struct optparse optp;
+  optparse_init(&optp, argv);
+  optp.permute = 0;
+
+  cstr input = NULL;
+  cstr output = NULL;
+  pak_opts po = {0};
+  bool watch = false;
+
+  int opt;
+  while ((opt = optparse_long(&optp, opts, NULL)) != -1) {
+    switch (opt) {
+      case 'h':
+        _usage();
+        return true;
+      case 'i':
+        input = optp.optarg;
+        break;
+      case 'o':
+        output = optp.optarg;
+        break;
+      case 'd':
+        po.direct = true;
+        break;
+      case 't':
+        po.order = optp.optarg;
+        break;
+      case 'a':
+        po.align = (u32)strtoul(optp.optarg, NULL, 10);
+        break;
+      case 'w':
+        watch = true;
+        break;
+      case '?':
+        _usage();
+        printf("%s: %s\n", argv[0], optp.errmsg);
+        return false;
+    }
+  }
+
+  if (input && output) {
+    _pak_create(input, output, &po, watch);
+  } else {
+    _usage();
+  }
+
+  return true;
+}
@@ -0,0 +1,80 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../../deps/optparse.h"
+#include "../pakz/pakz.h"
+
+static struct optparse_long opts[] = {{"help", 'h', OPTPARSE_NONE},
+                                      {"input", 'i', OPTPARSE_REQUIRED},
+                                      {"output", 'o', OPTPARSE_REQUIRED},
+                                      {"direct", 'd', OPTPARSE_NONE},
+                                      {"chunk", 'c', OPTPARSE_REQUIRED},
+                                      {"level", 'l', OPTPARSE_REQUIRED},
+                                      {0}};
+
+static void _usage() {
+  printf(
+      "usage: sqt pack deflate -i [PAK] -o [FILE] [--direct] "
+      "[--chunk 64-256 KB] [--level 0-9]\n");
+}
+
+static bool _pak_deflate(cstr fp, cstr out, const pakz_opts* o) {
+  arena m = {0};
+  pakz z = {0};
+  pakzerr e = pakz_deflate(&m, fp, out, o, &z);
+  arena_finish(&m);
+  return e == PAKZ_ERR_OK;
+}
+
+bool cmd_pak_deflate(char** argv) {
+  struct optparse optp;
+  optparse_init(&optp, argv);
+  optp.permute = 0;
+
+  cstr input = NULL;
+  cstr output = NULL;
+  pakz_opts po = {.chunk = PAKZ_CHUNK_DEFAULT, .level = PNG_LEVEL_DEFAULT};
+
+  int opt;
+  while ((opt = optparse_long(&optp, opts, NULL)) != -1) {
+    switch (opt) {
+      case 'h':
+        _usage();
+        return true;
+      case 'i':
+        input = optp.optarg;
+        break;
+      case 'o':
+        output = optp.optarg;
+        break;
+      case 'd':
+        po.direct = true;
+        break;
+      case 'c':
+        po.chunk = (u32)strtoul(optp.optarg, NULL, 10) * 1024;
+        break;
+      case 'l':
+        if (!png_level_parse(optp.optarg, &po.level)) {
+          _usage();
+          printf("%s: invalid level '%s', expected 0-9\n", argv[0],
+                 optp.optarg);
+          return false;
+        }
+        break;
+      case '?':
+        _usage();
+        printf("%s: %s\n", argv[0], optp.errmsg);
+        return false;
+    }
+  }
+
+  if (input && output) {
+    _pak_deflate(input, output, &po);
+  } else {
+    _usage();
+  }
+
+  return true;
+}
@@ -0,0 +1,84 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../../deps/optparse.h"
+#include "../pak/pak.h"
+
+static struct optparse_long opts[] = {{"help", 'h', OPTPARSE_NONE},
+                                      {"input", 'i', OPTPARSE_REQUIRED},
+                                      {"output", 'o', OPTPARSE_REQUIRED},
+                                      {"direct", 'd', OPTPARSE_NONE},
+                                      {"png", 'g', OPTPARSE_NONE},
+                                      {"palette", 'p', OPTPARSE_REQUIRED},
+                                      {"level", 'l', OPTPARSE_REQUIRED},
+                                      {0}};
+
+static void _usage() {
+  printf(
+      "usage: sqt pack export -i [FILE] -o [DIR] --png [-p PALETTE] "
+      "[--level 0-9] [--direct]\n");
+}
+
+static bool _pak_export(cstr fp, cstr dir, const pak_opts* o) {
+  arena m = {0};
+  pak p = {0};
+  pakerr e = pak_export(&m, fp, dir, o, &p);
+  arena_finish(&m);
+  return e == PAK_ERR_OK;
+}
+
+bool cmd_pak_export(char** argv) {
+  struct optparse optp;
+  optparse_init(&optp, argv);
+  optp.permute = 0;
+
+  cstr input = NULL;
+  cstr output = NULL;
+  pak_opts po = {.level = PNG_LEVEL_DEFAULT};
+
+  int opt;
+  while ((opt = optparse_long(&optp, opts, NULL)) != -1) {
+    switch (opt) {
+      case 'h':
+        _usage();
+        return true;
+      case 'i':
+        input = optp.optarg;
+        break;
+      case 'o':
+        output = optp.optarg;
+        break;
+      case 'd':
+        po.direct = true;
+        break;
+      case 'g':
+        po.png = true;
+        break;
+      case 'p':
+        po.palette = optp.optarg;
+        break;
+      case 'l':
+        if (!png_level_parse(optp.optarg, &po.level)) {
+          _usage();
+          printf("%s: invalid level '%s', expected 0-9\n", argv[0],
+                 optp.optarg);
+          return false;
+        }
+        break;
+      case '?':
+        _usage();
+        printf("%s: %s\n", argv[0], optp.errmsg);
+        return false;
+    }
+  }
+
+  if (input && output && po.png) {
+    _pak_export(input, output, &po);
+  } else {
+    _usage();
+  }
+
+  return true;
+}
@@ -8,16 +8,20 @@
 static struct optparse_long opts[] = {{"help", 'h', OPTPARSE_NONE},
                                       {"input", 'i', OPTPARSE_REQUIRED},
                                       {"output", 'o', OPTPARSE_REQUIRED},
+                                      {"direct", 'd', OPTPARSE_NONE},
+                                      {"update", 'u', OPTPARSE_NONE},
                                       {0}};
 
 static void _usage() {
-  printf("usage: sqt pack extract -i [FILE] -o [DIR]\n");
+  printf(
+      "usage: sqt pack extract -i [FILE] -o [DIR] [--direct] [--update]\n");
 }
 
-static bool _pak_extract(cstr fp, cstr dir) {
+static bool _pak_extract(cstr fp, cstr dir, const pak_opts* o) {
   arena m = {0};
   pak p = {0};
-  pakerr e = pak_extract(&m, fp, dir, &p);
+  pakerr e = pak_extract(&m, fp, dir, o, &p);
+  arena_finish(&m);
   return e == PAK_ERR_OK;
 }
 
@@ -28,6 +32,7 @@ bool cmd_pak_extract(char** argv) {
 
   cstr input = NULL;
   cstr output = NULL;
+  pak_opts po = {0};
 
   int opt;
   while ((opt = optparse_long(&optp, opts, NULL)) != -1) {
@@ -41,6 +46,12 @@ bool cmd_pak_extract(char** argv) {
       case 'o':
         output = optp.optarg;
         break;
+      case 'd':
+        po.direct = true;
+        break;
+      case 'u':
+        po.update = true;
+        break;
       case '?':
         _usage();
         printf("%s: %s\n", argv[0], optp.errmsg);
@@ -49,7 +60,7 @@ bool cmd_pak_extract(char** argv) {
   }
 
   if (input && output) {
-    _pak_extract(input, output);
+    _pak_extract(input, output, &po);
   } else {
     _usage();
   }
@@ -0,0 +1,105 @@
+#include <ctype.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../../deps/optparse.h"
+#include "../pak/pak.h"
+
+static struct optparse_long opts[] = {{"help", 'h', OPTPARSE_NONE},
+                                      {"input", 'i', OPTPARSE_REQUIRED},
+                                      {"hex", 'x', OPTPARSE_NONE},
+                                      {0}};
+
+static void _usage() {
+  printf(
+      "usage: sqt pack grep PATTERN -i [FILE] [FILE]... [--hex]\n"
+      "       prints 'pak:entry:offset' for every match, --hex reads\n"
+      "       PATTERN as hex bytes such as '49 44 50 4f', fails when\n"
+      "       nothing matches\n");
+}
+
+// Hex digits in pairs, whitespace between bytes is ignored
+static sz _parse_hex(cstr text, u8* out) {
+  sz n = 0;
+  for (cstr p = text; *p;) {
+    if (isspace((u8)*p)) {
+      p++;
+      continue;
+    }
+    if (!isxdigit((u8)p[0]) || !isxdigit((u8)p[1]))
+      return 0;
+    char pair[3] = {p[0], p[1], '\0'};
+    out[n++] = (u8)strtoul(pair, NULL, 16);
+    p += 2;
+  }
+  return n;
+}
+
+static bool _pak_grep(cstr* paths, u32 count, const u8* pat, sz len) {
+  arena m = {0};
+  pakerr e = pak_grep(&m, paths, count, pat, len);
+  arena_finish(&m);
+  return e == PAK_ERR_OK;
+}
+
+bool cmd_pak_grep(char** argv) {
+  struct optparse optp;
+  optparse_init(&optp, argv);
+
+  // every -i and every argument after the pattern is a pak to search
+  u32 argc = 0;
+  while (argv[argc])
+    argc++;
+  cstr* paths = (cstr*)malloc((argc ? argc : 1) * sizeof(cstr));
+  makesure(paths != NULL, "malloc failed");
+  u32 count = 0;
+  bool hex = false;
+
+  int opt;
+  while ((opt = optparse_long(&optp, opts, NULL)) != -1) {
+    switch (opt) {
+      case 'h':
+        _usage();
+        free(paths);
+        return true;
+      case 'i':
+        paths[count++] = optp.optarg;
+        break;
+      case 'x':
+        hex = true;
+        break;
+      case '?':
+        _usage();
+        printf("%s: %s\n", argv[0], optp.errmsg);
+        free(paths);
+        return false;
+    }
+  }
+
+  cstr pattern = optparse_arg(&optp);
+  for (cstr p; (p = optparse_arg(&optp));)
+    paths[count++] = p;
+
+  bool ok = true;
+  if (pattern && pattern[0] && count) {
+    sz len = strlen(pattern);
+    u8* pat = (u8*)malloc(len);
+    makesure(pat != NULL, "malloc failed");
+    if (hex) {
+      len = _parse_hex(pattern, pat);
+      makesure(len > 0, "'%s' is not a list of hex bytes", pattern);
+    } else {
+      memcpy(pat, pattern, len);
+    }
+    ok = _pak_grep(paths, count, pat, len);
+    free(pat);
+  } else {
+    _usage();
+    ok = false;
+  }
+
+  free(paths);
+  return ok;
+}
@@ -0,0 +1,64 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "../../deps/optparse.h"
+#include "../pakz/pakz.h"
+
+static struct optparse_long opts[] = {{"help", 'h', OPTPARSE_NONE},
+                                      {"input", 'i', OPTPARSE_REQUIRED},
+                                      {"output", 'o', OPTPARSE_REQUIRED},
+                                      {"direct", 'd', OPTPARSE_NONE},
+                                      {0}};
+
+static void _usage() {
+  printf("usage: sqt pack inflate -i [FILE] -o [PAK] [--direct]\n");
+}
+
+static bool _pak_inflate(cstr fp, cstr out, const pakz_opts* o) {
+  arena m = {0};
+  pakz z = {0};
+  pakzerr e = pakz_inflate(&m, fp, out, o, &z);
+  arena_finish(&m);
+  return e == PAKZ_ERR_OK;
+}
+
+bool cmd_pak_inflate(char** argv) {
+  struct optparse optp;
+  optparse_init(&optp, argv);
+  optp.permute = 0;
+
+  cstr input = NULL;
+  cstr output = NULL;
+  pakz_opts po = {0};
+
+  int opt;
+  while ((opt = optparse_long(&optp, opts, NULL)) != -1) {
+    switch (opt) {
+      case 'h':
+        _usage();
+        return true;
+      case 'i':
+        input = optp.optarg;
+        break;
+      case 'o':
+        output = optp.optarg;
+        break;
+      case 'd':
+        po.direct = true;
+        break;
+      case '?':
+        _usage();
+        printf("%s: %s\n", argv[0], optp.errmsg);
+        return false;
+    }
+  }
+
+  if (input && output) {
+    _pak_inflate(input, output, &po);
+  } else {
+    _usage();
+  }
+
+  return true;
+}
@@ -17,6 +17,7 @@ static bool _pak_info(cstr fp) {
   arena m = {0};
   pak p = {0};
   pakerr e = pak_info(&m, fp, &p);
+  arena_finish(&m);
   return e == PAK_ERR_OK;
 }
 
@@ -0,0 +1,75 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "../../deps/optparse.h"
+#include "../vfs/vfs.h"
+
+static struct optparse_long opts[] = {{"help", 'h', OPTPARSE_NONE},
+                                      {"base", 'b', OPTPARSE_REQUIRED},
+                                      {"game", 'g', OPTPARSE_REQUIRED},
+                                      {0}};
+
+static void _usage() {
+  printf(
+      "usage: sqt pak resolve [-b BASEDIR] [-g GAME]... [NAME]...\n"
+      "       id1 is always mounted first, every --game stacks on top\n");
+}
+
+static bool _pak_resolve(cstr base,
+                         cstr* games,
+                         u32 count,
+                         cstr* names,
+                         u32 names_count) {
+  arena m = {0};
+  vfserr e = vfs_resolve(&m, base, games, count, names, names_count);
+  arena_finish(&m);
+  return e == VFS_ERR_OK;
+}
+
+bool cmd_pak_resolve(char** argv) {
+  struct optparse optp;
+  optparse_init(&optp, argv);
+  optp.permute = 0;
+
+  cstr base = ".";
+  cstr games[VFS_MAX_GAMES] = {"id1"};
+  u32 count = 1;
+
+  int opt;
+  while ((opt = optparse_long(&optp, opts, NULL)) != -1) {
+    switch (opt) {
+      case 'h':
+        _usage();
+        return true;
+      case 'b':
+        base = optp.optarg;
+        break;
+      case 'g':
+        if (count == VFS_MAX_GAMES) {
+          printf("%s: at most %u games can be stacked\n", argv[0],
+                 VFS_MAX_GAMES);
+          return false;
+        }
+        games[count++] = optp.optarg;
+        break;
+      case '?':
+        _usage();
+        printf("%s: %s\n", argv[0], optp.errmsg);
+        return false;
+    }
+  }
+
+  cstr* names = (cstr*)argv + optp.optind;
+  u32 names_count = 0;
+  while (names[names_count])
+    names_count++;
+
+  if (names_count) {
+    return _pak_resolve(base, games, count, names, names_count);
+  } else {
+    _usage();
+  }
+
+  return true;
+}
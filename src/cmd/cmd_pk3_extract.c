@@ -0,0 +1,64 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "../../deps/optparse.h"
+#include "../pk3/pk3.h"
+
+static struct optparse_long opts[] = {{"help", 'h', OPTPARSE_NONE},
+                                      {"input", 'i', OPTPARSE_REQUIRED},
+                                      {"output", 'o', OPTPARSE_REQUIRED},
+                                      {"direct", 'd', OPTPARSE_NONE},
+                                      {0}};
+
+static void _usage() {
+  printf("usage: sqt pk3 extract -i [FILE] -o [DIR] [--direct]\n");
+}
+
+static bool _pk3_extract(cstr fp, cstr dir, const pk3_opts* o) {
+  arena m = {0};
+  pk3 z = {0};
+  pk3err e = pk3_extract(&m, fp, dir, o, &z);
+  arena_finish(&m);
+  return e == PK3_ERR_OK;
+}
+
+bool cmd_pk3_extract(char** argv) {
+  struct optparse optp;
+  optparse_init(&optp, argv);
+  optp.permute = 0;
+
+  cstr input = NULL;
+  cstr output = NULL;
+  pk3_opts po = {0};
+
+  int opt;
+  while ((opt = optparse_long(&optp, opts, NULL)) != -1) {
+    switch (opt) {
+      case 'h':
+        _usage();
+        return true;
+      case 'i':
+        input = optp.optarg;
+        break;
+      case 'o':
+        output = optp.optarg;
+        break;
+      case 'd':
+        po.direct = true;
+        break;
+      case '?':
+        _usage();
+        printf("%s: %s\n", argv[0], optp.errmsg);
+        return false;
+    }
+  }
+
+  if (input && output) {
+    _pk3_extract(input, output, &po);
+  } else {
+    _usage();
+  }
+
+  return true;
+}
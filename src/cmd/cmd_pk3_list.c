@@ -0,0 +1,46 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "../../deps/optparse.h"
+#include "../pk3/pk3.h"
+
+static struct optparse_long opts[] = {{"help", 'h', OPTPARSE_NONE},
+                                      {"input", 'i', OPTPARSE_REQUIRED},
+                                      {0}};
+
+static void _usage() {
+  printf("usage: sqt pk3 list -i [FILE]\n");
+}
+
+static bool _pk3_list(cstr fp) {
+  arena m = {0};
+  pk3 z = {0};
+  pk3err e = pk3_list(&m, fp, &z);
+  arena_finish(&m);
+  return e == PK3_ERR_OK;
+}
+
+bool cmd_pk3_list(char** argv) {
+  struct optparse optp;
+  optparse_init(&optp, argv);
+  optp.permute = 0;
+
+  int opt;
+  while ((opt = optparse_long(&optp, opts, NULL)) != -1) {
+    switch (opt) {
+      case 'h':
+        _usage();
+        return true;
+      case 'i':
+        _pk3_list(optp.optarg);
+        break;
+      case '?':
+        _usage();
+        printf("%s: %s\n", argv[0], optp.errmsg);
+        return false;
+    }
+  }
+
+  return true;
+}
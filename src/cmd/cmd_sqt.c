@@ -1,24 +1,34 @@
 #include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "../../deps/optparse.h"
 #include "../utils/types.h"
+#include "../utils/arena.h"
+#include "../utils/thread.h"
 
 bool cmd_pak(char **argv);
 bool cmd_lmp(char **argv);
 bool cmd_wad(char **argv);
+bool cmd_pk3(char **argv);
 
-static struct optparse_long opts[] = {
-    {"help", 'h', OPTPARSE_NONE}, {"version", 'v', OPTPARSE_NONE}, {0}};
+static struct optparse_long opts[] = {{"help", 'h', OPTPARSE_NONE},
+                                      {"version", 'v', OPTPARSE_NONE},
+                                      {"mem-stats", 'm', OPTPARSE_NONE},
+                                      {"jobs", 'j', OPTPARSE_REQUIRED},
+                                      {0}};
 
 static const struct {
   char name[8];
   bool (*cmd)(char **);
-} cmds[] = {{"pak", cmd_pak}, {"lmp", cmd_lmp}, {"wad", cmd_wad}};
+} cmds[] = {{"pak", cmd_pak},
+            {"lmp", cmd_lmp},
+            {"wad", cmd_wad},
+            {"pk3", cmd_pk3}};
 
 static void usage() {
-  printf("usage: example [-h] <pak|lmp|wad> [OPTION]...\n");
+  printf("usage: example [-h] [--mem-stats] [-j JOBS] <pak|lmp|wad|pk3> [OPTION]...\n");
 }
 
 static void version() { printf("version 0.0.1\n"); }
@@ -37,6 +47,12 @@ bool cmd_sqt(char **argv) {
     case 'v':
       version();
       return true;
+    case 'm':
+      arena_stats_enable(true);
+      break;
+    case 'j':
+      thread_set_count((u32)atoi(optp.optarg));
+      break;
 
     case '?':
       usage();
@@ -58,5 +58,5 @@ bool cmd_wad(char **argv) {
   }
 
   printf("%s: invalid subcommand: %s\n", argv[0], subargv[0]);
-  return true;
+  return false;
 }
@@ -1,3 +1,82 @@
 #include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
 
-bool cmd_wad_create(char **argv) { return 0; }
+#include "../../deps/optparse.h"
+#include "../wad/wad.h"
+
+static struct optparse_long opts[] = {{"help", 'h', OPTPARSE_NONE},
+                                      {"input", 'i', OPTPARSE_REQUIRED},
+                                      {"output", 'o', OPTPARSE_REQUIRED},
+                                      {"palette", 'p', OPTPARSE_REQUIRED},
+                                      {"direct", 'd', OPTPARSE_NONE},
+                                      {"fast", 'f', OPTPARSE_NONE},
+                                      {"fullbright", 'b', OPTPARSE_NONE},
+                                      {"gamma", 'g', OPTPARSE_NONE},
+                                      {0}};
+
+static void _usage() {
+  printf(
+      "usage: sqt wad create -i [DIR] -o [FILE] -p [PALETTE] [--direct] "
+      "[--fast] [--fullbright] [--gamma]\n");
+}
+
+static bool _wad_create(cstr dir, cstr fp, const wad_opts* o) {
+  arena m = {0};
+  wad w = {0};
+  waderr e = wad_create(&m, dir, fp, o, &w);
+  arena_finish(&m);
+  return e == WAD_ERR_OK;
+}
+
+bool cmd_wad_create(char** argv) {
+  struct optparse optp;
+  optparse_init(&optp, argv);
+  optp.permute = 0;
+
+  cstr input = NULL;
+  cstr output = NULL;
+  wad_opts po = {0};
+
+  int opt;
+  while ((opt = optparse_long(&optp, opts, NULL)) != -1) {
+    switch (opt) {
+      case 'h':
+        _usage();
+        return true;
+      case 'i':
+        input = optp.optarg;
+        break;
+      case 'o':
+        output = optp.optarg;
+        break;
+      case 'p':
+        po.palette = optp.optarg;
+        break;
+      case 'd':
+        po.direct = true;
+        break;
+      case 'f':
+        po.fast = true;
+        break;
+      case 'b':
+        po.fullbright = true;
+        break;
+      case 'g':
+        po.gamma = true;
+        break;
+      case '?':
+        _usage();
+        printf("%s: %s\n", argv[0], optp.errmsg);
+        return false;
+    }
+  }
+
+  if (input && output && po.palette) {
+    _wad_create(input, output, &po);
+  } else {
+    _usage();
+  }
+
+  return true;
+}
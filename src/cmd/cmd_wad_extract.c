@@ -1,3 +1,88 @@
 #include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
-bool cmd_wad_extract(char **argv) { return 0; }
+#include "../../deps/optparse.h"
+#include "../wad/wad.h"
+
+static struct optparse_long opts[] = {{"help", 'h', OPTPARSE_NONE},
+                                      {"input", 'i', OPTPARSE_REQUIRED},
+                                      {"output", 'o', OPTPARSE_REQUIRED},
+                                      {"direct", 'd', OPTPARSE_NONE},
+                                      {"png", 'g', OPTPARSE_NONE},
+                                      {"mips", 'm', OPTPARSE_NONE},
+                                      {"palette", 'p', OPTPARSE_REQUIRED},
+                                      {"level", 'l', OPTPARSE_REQUIRED},
+                                      {0}};
+
+static void _usage() {
+  printf(
+      "usage: sqt wad extract -i [FILE] -o [DIR] [--direct] [--png [--mips] "
+      "[-p PALETTE] [--level 0-9]]\n");
+}
+
+static bool _wad_extract(cstr fp, cstr dir, const wad_opts* o) {
+  arena m = {0};
+  wad w = {0};
+  waderr e = wad_extract(&m, fp, dir, o, &w);
+  arena_finish(&m);
+  return e == WAD_ERR_OK;
+}
+
+bool cmd_wad_extract(char** argv) {
+  struct optparse optp;
+  optparse_init(&optp, argv);
+  optp.permute = 0;
+
+  cstr input = NULL;
+  cstr output = NULL;
+  wad_opts po = {.level = PNG_LEVEL_DEFAULT};
+
+  int opt;
+  while ((opt = optparse_long(&optp, opts, NULL)) != -1) {
+    switch (opt) {
+      case 'h':
+        _usage();
+        return true;
+      case 'i':
+        input = optp.optarg;
+        break;
+      case 'o':
+        output = optp.optarg;
+        break;
+      case 'd':
+        po.direct = true;
+        break;
+      case 'g':
+        po.png = true;
+        break;
+      case 'm':
+        po.mips = true;
+        break;
+      case 'p':
+        po.palette = optp.optarg;
+        break;
+      case 'l':
+        if (!png_level_parse(optp.optarg, &po.level)) {
+          _usage();
+          printf("%s: invalid level '%s', expected 0-9\n", argv[0],
+                 optp.optarg);
+          return false;
+        }
+        break;
+      case '?':
+        _usage();
+        printf("%s: %s\n", argv[0], optp.errmsg);
+        return false;
+    }
+  }
+
+  if (input && output) {
+    _wad_extract(input, output, &po);
+  } else {
+    _usage();
+  }
+
+  return true;
+}
@@ -1,3 +1,46 @@
 #include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
 
-bool cmd_wad_list(char **argv) { return 0; }
+#include "../../deps/optparse.h"
+#include "../wad/wad.h"
+
+static struct optparse_long opts[] = {{"help", 'h', OPTPARSE_NONE},
+                                      {"input", 'i', OPTPARSE_REQUIRED},
+                                      {0}};
+
+static void _usage() {
+  printf("usage: sqt wad list -i [FILE]\n");
+}
+
+static bool _wad_list(cstr fp) {
+  arena m = {0};
+  wad w = {0};
+  waderr e = wad_list(&m, fp, &w);
+  arena_finish(&m);
+  return e == WAD_ERR_OK;
+}
+
+bool cmd_wad_list(char** argv) {
+  struct optparse optp;
+  optparse_init(&optp, argv);
+  optp.permute = 0;
+
+  int opt;
+  while ((opt = optparse_long(&optp, opts, NULL)) != -1) {
+    switch (opt) {
+      case 'h':
+        _usage();
+        return true;
+      case 'i':
+        _wad_list(optp.optarg);
+        break;
+      case '?':
+        _usage();
+        printf("%s: %s\n", argv[0], optp.errmsg);
+        return false;
+    }
+  }
+
+  return true;
+}
@@ -0,0 +1,9 @@
+#define IMG_IMPLEMENTATION
+#define MIP_IMPLEMENTATION
+#define PALETTE_IMPLEMENTATION
+#define PNG_IMPLEMENTATION
+
+#include "img.h"
+#include "mip.h"
+#include "palette.h"
+#include "png.h"
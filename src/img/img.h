@@ -0,0 +1,201 @@
+#ifndef _IMG_HEADER_
+#define _IMG_HEADER_
+
+#include <string.h>
+
+#include "../utils/types.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+// Pixel kernels shared by every indexed image converter. RGBA pixels are u32
+// in memory order R, G, B, A, indices are u8, and palettes are the 256 entry
+// RGBA tables palette.h builds.
+
+/* ****************** img API ****************** */
+
+// dst[i] = lut[src[i]], gathers on AVX2, table lookups on NEON
+void img_expand(u32* dst, const u8* src, sz n, const u32* lut);
+
+// Clears dst[i] wherever src[i] == index, used for the 255 cutout colour
+void img_mask_index(u32* dst, const u8* src, sz n, u8 index);
+
+// RGBA to indices through a 2^(3*bits) cube indexed by the top 'bits' of
+// each channel, pixels with alpha below 128 become 'clear'. The cube must be
+// readable 3 bytes past its end, the AVX2 path gathers whole dwords
+void img_quantize_lut(u8* dst,
+                      const u8* rgba,
+                      sz n,
+                      const u8* cube,
+                      u32 bits,
+                      u8 clear);
+
+/* ****************** img API ****************** */
+
+//  _                 _                           _        _   _
+// (_)               | |                         | |      | | (_)
+//  _ _ __ ___  _ __ | | ___ _ __ ___   ___ _ __ | |_ __ _| |_ _  ___  _ __
+// | | '_ ` _ \| '_ \| |/ _ \ '_ ` _ \ / _ \ '_ \| __/ _` | __| |/ _ \| '_ \
+// | | | | | | | |_) | |  __/ | | | | |  __/ | | | || (_| | |_| | (_) | | | |
+// |_|_| |_| |_| .__/|_|\___|_| |_| |_|\___|_| |_|\__\__,_|\__|_|\___/|_| |_|
+//             | |
+//             |_|
+
+#ifdef IMG_IMPLEMENTATION
+
+/*****************************
+ * EXPORTED FUNCTIONS
+ *****************************/
+
+void img_expand(u32* dst, const u8* src, sz n, const u32* lut) {
+  sz i = 0;
+#if defined(__AVX2__)
+  for (; i + 8 <= n; i += 8) {
+    __m128i idx = _mm_loadl_epi64((const __m128i*)(src + i));
+    __m256i v = _mm256_i32gather_epi32((const int*)lut,
+                                       _mm256_cvtepu8_epi32(idx), 4);
+    _mm256_storeu_si256((__m256i*)(dst + i), v);
+  }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+  // the table is split into one 256 byte plane per channel, each looked up
+  // as four 64 byte tbl quarters; out of range lanes read as zero, so the
+  // quarters simply OR together
+  uint8x16x4_t planes[4][4];
+  for (u32 c = 0; c < 4; c++) {
+    u8 tmp[256];
+    for (u32 k = 0; k < 256; k++)
+      tmp[k] = (u8)(lut[k] >> (8 * c));
+    for (u32 q = 0; q < 4; q++)
+      planes[c][q] = vld1q_u8_x4(tmp + q * 64);
+  }
+
+  const uint8x16_t step = vdupq_n_u8(64);
+  for (; i + 16 <= n; i += 16) {
+    uint8x16_t idx[4];
+    idx[0] = vld1q_u8(src + i);
+    idx[1] = vsubq_u8(idx[0], step);
+    idx[2] = vsubq_u8(idx[1], step);
+    idx[3] = vsubq_u8(idx[2], step);
+
+    uint8x16x4_t out;
+    for (u32 c = 0; c < 4; c++) {
+      uint8x16_t v = vqtbl4q_u8(planes[c][0], idx[0]);
+      v = vorrq_u8(v, vqtbl4q_u8(planes[c][1], idx[1]));
+      v = vorrq_u8(v, vqtbl4q_u8(planes[c][2], idx[2]));
+      out.val[c] = vorrq_u8(v, vqtbl4q_u8(planes[c][3], idx[3]));
+    }
+    vst4q_u8((u8*)(dst + i), out);
+  }
+#else
+  // without a gather a plain unrolled loop is already one load per pixel.
+  // pshufb only indexes 16 bytes, a 256 entry table takes 16 shuffles and
+  // selects per channel and ran ~10x slower than this loop on SSSE3
+  for (; i + 4 <= n; i += 4) {
+    dst[i] = lut[src[i]];
+    dst[i + 1] = lut[src[i + 1]];
+    dst[i + 2] = lut[src[i + 2]];
+    dst[i + 3] = lut[src[i + 3]];
+  }
+#endif
+  for (; i < n; i++)
+    dst[i] = lut[src[i]];
+}
+
+void img_mask_index(u32* dst, const u8* src, sz n, u8 index) {
+  sz i = 0;
+#if defined(__AVX2__)
+  const __m128i key = _mm_set1_epi8((char)index);
+  for (; i + 8 <= n; i += 8) {
+    __m128i eq = _mm_cmpeq_epi8(_mm_loadl_epi64((const __m128i*)(src + i)),
+                                key);
+    __m256i m = _mm256_cvtepi8_epi32(eq);
+    __m256i v = _mm256_loadu_si256((const __m256i*)(dst + i));
+    _mm256_storeu_si256((__m256i*)(dst + i), _mm256_andnot_si256(m, v));
+  }
+#elif defined(__SSE2__)
+  // widening the byte compare twice turns it into one mask per pixel
+  const __m128i key = _mm_set1_epi8((char)index);
+  for (; i + 16 <= n; i += 16) {
+    __m128i eq = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(src + i)),
+                                key);
+    __m128i lo = _mm_unpacklo_epi8(eq, eq);
+    __m128i hi = _mm_unpackhi_epi8(eq, eq);
+    __m128i m[4] = {_mm_unpacklo_epi16(lo, lo), _mm_unpackhi_epi16(lo, lo),
+                    _mm_unpacklo_epi16(hi, hi), _mm_unpackhi_epi16(hi, hi)};
+    for (u32 k = 0; k < 4; k++) {
+      __m128i* p = (__m128i*)(dst + i + k * 4);
+      _mm_storeu_si128(p, _mm_andnot_si128(m[k], _mm_loadu_si128(p)));
+    }
+  }
+#elif defined(__ARM_NEON)
+  const uint8x8_t key = vdup_n_u8(index);
+  for (; i + 8 <= n; i += 8) {
+    uint8x8_t eq = vceq_u8(vld1_u8(src + i), key);
+    int16x8_t w = vreinterpretq_s16_s8(vmovl_s8(vreinterpret_s8_u8(eq)));
+    uint32x4_t lo = vreinterpretq_u32_s32(vmovl_s16(vget_low_s16(w)));
+    uint32x4_t hi = vreinterpretq_u32_s32(vmovl_s16(vget_high_s16(w)));
+    vst1q_u32(dst + i, vbicq_u32(vld1q_u32(dst + i), lo));
+    vst1q_u32(dst + i + 4, vbicq_u32(vld1q_u32(dst + i + 4), hi));
+  }
+#endif
+  for (; i < n; i++) {
+    if (src[i] == index)
+      dst[i] = 0;
+  }
+}
+
+void img_quantize_lut(u8* dst,
+                      const u8* rgba,
+                      sz n,
+                      const u8* cube,
+                      u32 bits,
+                      u8 clear) {
+  u32 s = 8 - bits;
+  sz i = 0;
+#if defined(__AVX2__)
+  // cell indices are built in 32-bit lanes and the cube is gathered with
+  // byte scale, the low byte of every gathered dword is the answer
+  const __m256i cmask = _mm256_set1_epi32((1 << bits) - 1);
+  const __m256i bmask = _mm256_set1_epi32(0xFF);
+  const __m256i half = _mm256_set1_epi32(128);
+  const __m128i shift = _mm_cvtsi32_si128((int)s);
+  for (; i + 8 <= n; i += 8) {
+    __m256i px = _mm256_loadu_si256((const __m256i*)(rgba + i * 4));
+    __m256i r = _mm256_and_si256(_mm256_srl_epi32(px, shift), cmask);
+    __m256i g = _mm256_and_si256(
+        _mm256_srl_epi32(_mm256_srli_epi32(px, 8), shift), cmask);
+    __m256i b = _mm256_and_si256(
+        _mm256_srl_epi32(_mm256_srli_epi32(px, 16), shift), cmask);
+    __m256i cell = _mm256_or_si256(
+        _mm256_slli_epi32(r, 2 * bits),
+        _mm256_or_si256(_mm256_slli_epi32(g, bits), b));
+
+    __m256i v = _mm256_and_si256(
+        _mm256_i32gather_epi32((const int*)cube, cell, 1), bmask);
+    __m256i transparent = _mm256_cmpgt_epi32(half, _mm256_srli_epi32(px, 24));
+    v = _mm256_blendv_epi8(v, _mm256_set1_epi32(clear), transparent);
+
+    // 8 dwords down to 8 bytes
+    __m256i p16 = _mm256_packus_epi32(v, v);
+    __m256i p8 = _mm256_packus_epi16(p16, p16);
+    u32 lo = (u32)_mm256_extract_epi32(p8, 0);
+    u32 hi = (u32)_mm256_extract_epi32(p8, 4);
+    memcpy(dst + i, &lo, 4);
+    memcpy(dst + i + 4, &hi, 4);
+  }
+#endif
+  for (; i < n; i++) {
+    const u8* p = rgba + i * 4;
+    dst[i] = p[3] < 128 ? clear
+                        : cube[(p[0] >> s) << (2 * bits) |
+                               (p[1] >> s) << bits | (p[2] >> s)];
+  }
+}
+
+#endif  // IMG_IMPLEMENTATION
+#endif  //_IMG_HEADER_
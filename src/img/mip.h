@@ -0,0 +1,264 @@
+#ifndef _MIP_HEADER_
+#define _MIP_HEADER_
+
+#include <math.h>
+#include <pthread.h>
+
+#include "../utils/types.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+// Linear light is kept in 14 bits so four samples still sum inside a u16
+static constexpr u32 MIP_LINEAR_BITS = 14;
+static constexpr u32 MIP_LINEAR_MAX = (1 << MIP_LINEAR_BITS) - 1;
+
+/* ****************** mip API ****************** */
+
+// Halves an RGBA image with a 2x2 box filter, 'w' and 'h' are the source
+// sides and must be even
+void mip_box_rgba8(u8* dst, const u8* src, u32 w, u32 h);
+void mip_box_rgba16(u16* dst, const u16* src, u32 w, u32 h);
+
+// The same for '{' cutout textures: colour averages only the texels with
+// alpha of 128 or more, so the colour hidden behind the cutout does not bleed
+// into the edges of smaller levels. Alpha is still the plain average
+void mip_cutout_rgba8(u8* dst, const u8* src, u32 w, u32 h);
+void mip_cutout_rgba16(u16* dst, const u16* src, u32 w, u32 h);
+
+// sRGB to 14-bit linear light and back, alpha is scaled without a curve
+void mip_to_linear(u16* dst, const u8* src, sz n);
+void mip_from_linear(u8* dst, const u16* src, sz n);
+
+/* ****************** mip API ****************** */
+
+//  _                 _                           _        _   _
+// (_)               | |                         | |      | | (_)
+//  _ _ __ ___  _ __ | | ___ _ __ ___   ___ _ __ | |_ __ _| |_ _  ___  _ __
+// | | '_ ` _ \| '_ \| |/ _ \ '_ ` _ \ / _ \ '_ \| __/ _` | __| |/ _ \| '_ \
+// | | | | | | | |_) | |  __/ | | | | |  __/ | | | || (_| | |_| | (_) | | | |
+// |_|_| |_| |_| .__/|_|\___|_| |_| |_|\___|_| |_|\__\__,_|\__|_|\___/|_| |_|
+//             | |
+//             |_|
+
+#ifdef MIP_IMPLEMENTATION
+
+/*****************************
+ * HIDDEN FUNCTIONS
+ *****************************/
+
+static u16 _mip_to_lin[256];
+static u8 _mip_from_lin[MIP_LINEAR_MAX + 1];
+static pthread_once_t _mip_once = PTHREAD_ONCE_INIT;
+
+static void _mip_init_tables(void) {
+  for (u32 i = 0; i < 256; i++) {
+    f32 c = (f32)i / 255.0f;
+    f32 l = c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+    _mip_to_lin[i] = (u16)(l * MIP_LINEAR_MAX + 0.5f);
+  }
+  for (u32 i = 0; i <= MIP_LINEAR_MAX; i++) {
+    f32 l = (f32)i / MIP_LINEAR_MAX;
+    f32 c = l <= 0.0031308f ? l * 12.92f
+                            : 1.055f * powf(l, 1.0f / 2.4f) - 0.055f;
+    _mip_from_lin[i] = (u8)(c * 255.0f + 0.5f);
+  }
+}
+
+// One output pixel from the four samples of a 2x2 block. A block with no
+// texel at or above 'cutoff' is cleared by its alpha anyway, its colour is
+// the plain average
+static void _mip_cutout(const u32 px[4][4], u32 cutoff, u32 out[4]) {
+  u32 sum[4] = {0};
+  u32 kept = 0;
+  for (u32 k = 0; k < 4; k++) {
+    sum[3] += px[k][3];
+    if (px[k][3] < cutoff)
+      continue;
+    for (u32 c = 0; c < 3; c++)
+      sum[c] += px[k][c];
+    kept++;
+  }
+  for (u32 c = 0; c < 3; c++) {
+    if (!kept)
+      sum[c] = px[0][c] + px[1][c] + px[2][c] + px[3][c];
+    u32 n = kept ? kept : 4;
+    out[c] = (sum[c] + n / 2) / n;
+  }
+  out[3] = (sum[3] + 2) >> 2;
+}
+
+/*****************************
+ * EXPORTED FUNCTIONS
+ *****************************/
+
+void mip_box_rgba8(u8* dst, const u8* src, u32 w, u32 h) {
+  u32 ow = w / 2;
+  for (u32 y = 0; y < h / 2; y++) {
+    const u8* r0 = src + (sz)(2 * y) * w * 4;
+    const u8* r1 = r0 + (sz)w * 4;
+    u8* o = dst + (sz)y * ow * 4;
+    u32 x = 0;
+
+#if defined(__SSE2__)
+    // four source pixels of both rows give two outputs: widen to 16 bits,
+    // add the rows, then fold each pixel pair with a 64-bit shift
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i two = _mm_set1_epi16(2);
+    for (; x + 2 <= ow; x += 2) {
+      __m128i a = _mm_loadu_si128((const __m128i*)(r0 + x * 8));
+      __m128i b = _mm_loadu_si128((const __m128i*)(r1 + x * 8));
+      __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero),
+                                 _mm_unpacklo_epi8(b, zero));
+      __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero),
+                                 _mm_unpackhi_epi8(b, zero));
+      lo = _mm_add_epi16(lo, _mm_srli_si128(lo, 8));
+      hi = _mm_add_epi16(hi, _mm_srli_si128(hi, 8));
+      __m128i s = _mm_unpacklo_epi64(lo, hi);
+      s = _mm_srli_epi16(_mm_add_epi16(s, two), 2);
+      _mm_storel_epi64((__m128i*)(o + x * 4), _mm_packus_epi16(s, s));
+    }
+#elif defined(__ARM_NEON)
+    // deinterleaved loads turn neighbouring pixels into neighbouring lanes
+    for (; x + 8 <= ow; x += 8) {
+      uint8x16x4_t a = vld4q_u8(r0 + x * 8);
+      uint8x16x4_t b = vld4q_u8(r1 + x * 8);
+      uint8x8x4_t s;
+      for (u32 c = 0; c < 4; c++) {
+        uint16x8_t t = vaddq_u16(vpaddlq_u8(a.val[c]), vpaddlq_u8(b.val[c]));
+        s.val[c] = vrshrn_n_u16(t, 2);
+      }
+      vst4_u8(o + x * 4, s);
+    }
+#endif
+
+    for (; x < ow; x++) {
+      for (u32 c = 0; c < 4; c++) {
+        u32 s = r0[x * 8 + c] + r0[x * 8 + 4 + c] + r1[x * 8 + c] +
+                r1[x * 8 + 4 + c];
+        o[x * 4 + c] = (u8)((s + 2) >> 2);
+      }
+    }
+  }
+}
+
+void mip_box_rgba16(u16* dst, const u16* src, u32 w, u32 h) {
+  u32 ow = w / 2;
+  for (u32 y = 0; y < h / 2; y++) {
+    const u16* r0 = src + (sz)(2 * y) * w * 4;
+    const u16* r1 = r0 + (sz)w * 4;
+    u16* o = dst + (sz)y * ow * 4;
+    u32 x = 0;
+
+#if defined(__SSE2__)
+    const __m128i two = _mm_set1_epi16(2);
+    for (; x + 2 <= ow; x += 2) {
+      __m128i a = _mm_add_epi16(_mm_loadu_si128((const __m128i*)(r0 + x * 8)),
+                                _mm_loadu_si128((const __m128i*)(r1 + x * 8)));
+      __m128i b = _mm_add_epi16(
+          _mm_loadu_si128((const __m128i*)(r0 + x * 8 + 8)),
+          _mm_loadu_si128((const __m128i*)(r1 + x * 8 + 8)));
+      a = _mm_add_epi16(a, _mm_srli_si128(a, 8));
+      b = _mm_add_epi16(b, _mm_srli_si128(b, 8));
+      __m128i s = _mm_unpacklo_epi64(a, b);
+      s = _mm_srli_epi16(_mm_add_epi16(s, two), 2);
+      _mm_storeu_si128((__m128i*)(o + x * 4), s);
+    }
+#elif defined(__ARM_NEON)
+    for (; x + 4 <= ow; x += 4) {
+      uint16x8x4_t a = vld4q_u16(r0 + x * 8);
+      uint16x8x4_t b = vld4q_u16(r1 + x * 8);
+      uint16x4x4_t s;
+      for (u32 c = 0; c < 4; c++) {
+        uint32x4_t t = vaddq_u32(vpaddlq_u16(a.val[c]), vpaddlq_u16(b.val[c]));
+        s.val[c] = vrshrn_n_u32(t, 2);
+      }
+      vst4_u16(o + x * 4, s);
+    }
+#endif
+
+    for (; x < ow; x++) {
+      for (u32 c = 0; c < 4; c++) {
+        u32 s = r0[x * 8 + c] + r0[x * 8 + 4 + c] + r1[x * 8 + c] +
+                r1[x * 8 + 4 + c];
+        o[x * 4 + c] = (u16)((s + 2) >> 2);
+      }
+    }
+  }
+}
+
+void mip_cutout_rgba8(u8* dst, const u8* src, u32 w, u32 h) {
+  u32 ow = w / 2;
+  for (u32 y = 0; y < h / 2; y++) {
+    const u8* r0 = src + (sz)(2 * y) * w * 4;
+    const u8* r1 = r0 + (sz)w * 4;
+    u8* o = dst + (sz)y * ow * 4;
+    for (u32 x = 0; x < ow; x++) {
+      const u8* at[4] = {r0 + x * 8, r0 + x * 8 + 4, r1 + x * 8,
+                         r1 + x * 8 + 4};
+      u32 px[4][4];
+      u32 out[4];
+      for (u32 k = 0; k < 4; k++) {
+        for (u32 c = 0; c < 4; c++)
+          px[k][c] = at[k][c];
+      }
+      _mip_cutout(px, 128, out);
+      for (u32 c = 0; c < 4; c++)
+        o[x * 4 + c] = (u8)out[c];
+    }
+  }
+}
+
+void mip_cutout_rgba16(u16* dst, const u16* src, u32 w, u32 h) {
+  // 128 in the linear alpha scale of mip_to_linear
+  const u32 cutoff = (128 * MIP_LINEAR_MAX + 127) / 255;
+  u32 ow = w / 2;
+  for (u32 y = 0; y < h / 2; y++) {
+    const u16* r0 = src + (sz)(2 * y) * w * 4;
+    const u16* r1 = r0 + (sz)w * 4;
+    u16* o = dst + (sz)y * ow * 4;
+    for (u32 x = 0; x < ow; x++) {
+      const u16* at[4] = {r0 + x * 8, r0 + x * 8 + 4, r1 + x * 8,
+                          r1 + x * 8 + 4};
+      u32 px[4][4];
+      u32 out[4];
+      for (u32 k = 0; k < 4; k++) {
+        for (u32 c = 0; c < 4; c++)
+          px[k][c] = at[k][c];
+      }
+      _mip_cutout(px, cutoff, out);
+      for (u32 c = 0; c < 4; c++)
+        o[x * 4 + c] = (u16)out[c];
+    }
+  }
+}
+
+void mip_to_linear(u16* dst, const u8* src, sz n) {
+  pthread_once(&_mip_once, _mip_init_tables);
+  for (sz i = 0; i < n; i++) {
+    const u8* p = src + i * 4;
+    u16* o = dst + i * 4;
+    o[0] = _mip_to_lin[p[0]];
+    o[1] = _mip_to_lin[p[1]];
+    o[2] = _mip_to_lin[p[2]];
+    o[3] = (u16)((p[3] * MIP_LINEAR_MAX + 127) / 255);
+  }
+}
+
+void mip_from_linear(u8* dst, const u16* src, sz n) {
+  pthread_once(&_mip_once, _mip_init_tables);
+  for (sz i = 0; i < n; i++) {
+    const u16* p = src + i * 4;
+    u8* o = dst + i * 4;
+    o[0] = _mip_from_lin[p[0]];
+    o[1] = _mip_from_lin[p[1]];
+    o[2] = _mip_from_lin[p[2]];
+    o[3] = (u8)((p[3] * 255 + MIP_LINEAR_MAX / 2) / MIP_LINEAR_MAX);
+  }
+}
+
+#endif  // MIP_IMPLEMENTATION
+#endif  //_MIP_HEADER_
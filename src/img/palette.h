@@ -0,0 +1,396 @@
+#ifndef _PALETTE_HEADER_
+#define _PALETTE_HEADER_
+
+#include <string.h>
+#include <stdlib.h>
+
+#include "../utils/types.h"
+#include "../utils/io.h"
+#include "../utils/macros.h"
+#include "../utils/thread.h"
+#include "img.h"
+#include "png.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+static constexpr u32 PALETTE_COLORS = 256;
+static constexpr u32 PALETTE_LEN = PALETTE_COLORS * 3;
+static constexpr u32 PALETTE_FULLBRIGHTS = 224;  // first fullbright index
+static constexpr u8 PALETTE_TRANSPARENT = 255;
+static constexpr u32 PALETTE_CUBE_BITS = 5;      // 32 x 32 x 32 cells
+static constexpr u32 PALETTE_CUBE_SIDE = 1 << PALETTE_CUBE_BITS;
+static constexpr u32 PALETTE_CUBE_CELLS =
+    PALETTE_CUBE_SIDE * PALETTE_CUBE_SIDE * PALETTE_CUBE_SIDE;
+
+typedef struct {
+  u8 rgb[PALETTE_LEN];      // palette.lmp contents
+  u32 rgba[PALETTE_COLORS]; // index to RGBA expansion table
+  i16 soa[3][PALETTE_COLORS];  // channels split out for the SIMD search
+  u32 first;                // searchable index range is [first, last]
+  u32 last;
+
+  // quantization cube, built by palette_build_quant
+  u8* cube;         // nearest index to every cell centre
+  u32* cell_start;  // candidates of cell c are cand[cell_start[c]..c+1]
+  u8* cand;         // indices that can be nearest to some colour in a cell
+} palette;
+
+/* ****************** palette API ****************** */
+
+void palette_load(palette*, cstr);
+void palette_from_rgb(palette*, const u8*);
+void palette_free(palette*);
+
+// Restricts the search to [first, last] and builds the lookup cube
+void palette_build_quant(palette*, u32, u32);
+
+// Nearest palette index, brute force over the whole range (SIMD)
+u8 palette_nearest_full(const palette*, i32, i32, i32);
+
+// Nearest palette index through the cube, exact when 'exact' is set
+u8 palette_nearest(const palette*, u8, u8, u8, bool);
+
+// RGBA pixels to indices, alpha below 128 maps to PALETTE_TRANSPARENT
+void palette_quantize(const palette*, u8*, const u8*, sz, bool);
+
+// Indices to RGBA, PALETTE_TRANSPARENT becomes clear when 'transparent'
+void palette_expand(const palette*, u32*, const u8*, sz, bool);
+
+// Indexed PNG at deflate 'level' (0 stores), PALETTE_TRANSPARENT gets a
+// clear tRNS entry when 'transparent'
+void palette_write_png(const palette*, cstr, const u8*, u32, u32, bool, u32);
+
+/* ****************** palette API ****************** */
+
+//  _                 _                           _        _   _
+// (_)               | |                         | |      | | (_)
+//  _ _ __ ___  _ __ | | ___ _ __ ___   ___ _ __ | |_ __ _| |_ _  ___  _ __
+// | | '_ ` _ \| '_ \| |/ _ \ '_ ` _ \ / _ \ '_ \| __/ _` | __| |/ _ \| '_ \
+// | | | | | | | |_) | |  __/ | | | | |  __/ | | | || (_| | |_| | (_) | | | |
+// |_|_| |_| |_| .__/|_|\___|_| |_| |_|\___|_| |_|\__\__,_|\__|_|\___/|_| |_|
+//             | |
+//             |_|
+
+#ifdef PALETTE_IMPLEMENTATION
+
+/*****************************
+ * HIDDEN FUNCTIONS
+ *****************************/
+
+static inline u32 _pal_cell(u32 r, u32 g, u32 b) {
+  u32 s = 8 - PALETTE_CUBE_BITS;
+  return (r >> s) << (2 * PALETTE_CUBE_BITS) | (g >> s) << PALETTE_CUBE_BITS |
+         (b >> s);
+}
+
+static inline i32 _pal_dist(const palette* p, u32 i, i32 r, i32 g, i32 b) {
+  i32 dr = p->soa[0][i] - r;
+  i32 dg = p->soa[1][i] - g;
+  i32 db = p->soa[2][i] - b;
+  return dr * dr + dg * dg + db * db;
+}
+
+typedef struct {
+  palette* p;
+  u8* cand[PALETTE_CUBE_SIDE];    // candidates per red slice
+  u32 count[PALETTE_CUBE_SIDE];
+  u32* cell_count;                // candidates per cell
+} pal_build_job;
+
+// One red slice of the cube: a colour can only be nearest to some point of a
+// cell if its closest distance to the cell beats the best worst-case distance
+// of any colour, everything else is pruned from that cell's candidate list
+static void _pal_build_slice(void* ctx, u32 ri, u32 worker) {
+  pal_build_job* job = (pal_build_job*)ctx;
+  palette* p = job->p;
+  u32 side = 1 << (8 - PALETTE_CUBE_BITS);
+  u32 cells = PALETTE_CUBE_SIDE * PALETTE_CUBE_SIDE;
+
+  u8* out = (u8*)malloc((sz)cells * (p->last - p->first + 1));
+  makesure(out != NULL, "malloc failed");
+  u32 n = 0;
+
+  i32 mind[PALETTE_COLORS];
+  for (u32 gi = 0; gi < PALETTE_CUBE_SIDE; gi++) {
+    for (u32 bi = 0; bi < PALETTE_CUBE_SIDE; bi++) {
+      i32 lo[3] = {(i32)(ri * side), (i32)(gi * side), (i32)(bi * side)};
+      i32 best_max = INT32_MAX;
+
+      for (u32 i = p->first; i <= p->last; i++) {
+        i32 dmin = 0, dmax = 0;
+        for (u32 c = 0; c < 3; c++) {
+          i32 v = p->soa[c][i];
+          i32 hi = lo[c] + (i32)side - 1;
+          i32 near = v < lo[c] ? lo[c] - v : (v > hi ? v - hi : 0);
+          i32 far = v - lo[c] > hi - v ? v - lo[c] : hi - v;
+          dmin += near * near;
+          dmax += far * far;
+        }
+        mind[i] = dmin;
+        if (dmax < best_max)
+          best_max = dmax;
+      }
+
+      u32 c = _pal_cell(lo[0], lo[1], lo[2]);
+      u32 start = n;
+      for (u32 i = p->first; i <= p->last; i++) {
+        if (mind[i] <= best_max)
+          out[n++] = (u8)i;
+      }
+      job->cell_count[c] = n - start;
+
+      i32 half = (i32)side / 2;
+      p->cube[c] = palette_nearest_full(p, lo[0] + half, lo[1] + half,
+                                        lo[2] + half);
+    }
+  }
+
+  job->cand[ri] = out;
+  job->count[ri] = n;
+}
+
+/*****************************
+ * EXPORTED FUNCTIONS
+ *****************************/
+
+void palette_from_rgb(palette* p, const u8* rgb) {
+  memset(p, 0, sizeof(*p));
+  memcpy(p->rgb, rgb, PALETTE_LEN);
+  for (u32 i = 0; i < PALETTE_COLORS; i++) {
+    const u8* c = rgb + i * 3;
+    p->rgba[i] = (u32)c[0] | (u32)c[1] << 8 | (u32)c[2] << 16 | 0xFF000000u;
+    p->soa[0][i] = c[0];
+    p->soa[1][i] = c[1];
+    p->soa[2][i] = c[2];
+  }
+  p->first = 0;
+  p->last = PALETTE_COLORS - 1;
+}
+
+void palette_load(palette* p, cstr path) {
+  u8* buf = NULL;
+  sz size = load_file(path, &buf);
+  makesure(size >= PALETTE_LEN, "'%s' is not a palette", path);
+  palette_from_rgb(p, buf);
+  free(buf);
+}
+
+void palette_free(palette* p) {
+  free(p->cube);
+  free(p->cell_start);
+  free(p->cand);
+  p->cube = NULL;
+  p->cell_start = NULL;
+  p->cand = NULL;
+}
+
+void palette_build_quant(palette* p, u32 first, u32 last) {
+  makesure(first <= last && last < PALETTE_COLORS, "invalid palette range");
+  palette_free(p);
+  p->first = first;
+  p->last = last;
+
+  p->cube = (u8*)malloc(PALETTE_CUBE_CELLS + 3);  // gather slack, see img.h
+  p->cell_start = (u32*)malloc((PALETTE_CUBE_CELLS + 1) * sizeof(u32));
+  pal_build_job job = {.p = p};
+  job.cell_count = (u32*)malloc(PALETTE_CUBE_CELLS * sizeof(u32));
+  makesure(p->cube && p->cell_start && job.cell_count, "malloc failed");
+
+  thread_parallel_for(PALETTE_CUBE_SIDE, _pal_build_slice, &job);
+
+  // slices are contiguous ranges of cells, so their lists simply concatenate
+  sz total = 0;
+  for (u32 ri = 0; ri < PALETTE_CUBE_SIDE; ri++)
+    total += job.count[ri];
+  p->cand = (u8*)malloc(total);
+  makesure(p->cand != NULL, "malloc failed");
+
+  u32 at = 0;
+  for (u32 ri = 0; ri < PALETTE_CUBE_SIDE; ri++) {
+    memcpy(p->cand + at, job.cand[ri], job.count[ri]);
+    at += job.count[ri];
+    free(job.cand[ri]);
+  }
+
+  at = 0;
+  for (u32 c = 0; c < PALETTE_CUBE_CELLS; c++) {
+    p->cell_start[c] = at;
+    at += job.cell_count[c];
+  }
+  p->cell_start[PALETTE_CUBE_CELLS] = at;
+  free(job.cell_count);
+}
+
+u8 palette_nearest_full(const palette* p, i32 r, i32 g, i32 b) {
+  u32 i = p->first;
+  i32 best = INT32_MAX;
+  u32 besti = p->first;
+
+#if defined(__SSE2__)
+  // eight colours per step: (dr, dg) pairs and (db, 0) pairs go through
+  // pmaddwd so the squared sums land in 32-bit lanes without overflowing
+  const __m128i vr = _mm_set1_epi16((i16)r);
+  const __m128i vg = _mm_set1_epi16((i16)g);
+  const __m128i vb = _mm_set1_epi16((i16)b);
+  const __m128i zero = _mm_setzero_si128();
+  __m128i bestv = _mm_set1_epi32(INT32_MAX);
+  __m128i bestiv = _mm_setzero_si128();
+  __m128i idx = _mm_setr_epi32((i32)i, (i32)i + 1, (i32)i + 2, (i32)i + 3);
+  const __m128i four = _mm_set1_epi32(4);
+
+  for (; i + 8 <= p->last + 1; i += 8) {
+    __m128i dr = _mm_sub_epi16(_mm_loadu_si128((const __m128i*)&p->soa[0][i]),
+                               vr);
+    __m128i dg = _mm_sub_epi16(_mm_loadu_si128((const __m128i*)&p->soa[1][i]),
+                               vg);
+    __m128i db = _mm_sub_epi16(_mm_loadu_si128((const __m128i*)&p->soa[2][i]),
+                               vb);
+
+    __m128i rg_lo = _mm_unpacklo_epi16(dr, dg);
+    __m128i rg_hi = _mm_unpackhi_epi16(dr, dg);
+    __m128i b_lo = _mm_unpacklo_epi16(db, zero);
+    __m128i b_hi = _mm_unpackhi_epi16(db, zero);
+
+    __m128i d_lo = _mm_add_epi32(_mm_madd_epi16(rg_lo, rg_lo),
+                                 _mm_madd_epi16(b_lo, b_lo));
+    __m128i d_hi = _mm_add_epi32(_mm_madd_epi16(rg_hi, rg_hi),
+                                 _mm_madd_epi16(b_hi, b_hi));
+
+    // strict less keeps the lowest index on ties, like the scalar loop
+    __m128i lt = _mm_cmplt_epi32(d_lo, bestv);
+    bestv = _mm_or_si128(_mm_and_si128(lt, d_lo), _mm_andnot_si128(lt, bestv));
+    bestiv = _mm_or_si128(_mm_and_si128(lt, idx), _mm_andnot_si128(lt, bestiv));
+    idx = _mm_add_epi32(idx, four);
+
+    lt = _mm_cmplt_epi32(d_hi, bestv);
+    bestv = _mm_or_si128(_mm_and_si128(lt, d_hi), _mm_andnot_si128(lt, bestv));
+    bestiv = _mm_or_si128(_mm_and_si128(lt, idx), _mm_andnot_si128(lt, bestiv));
+    idx = _mm_add_epi32(idx, four);
+  }
+
+  i32 bd[4], bi[4];
+  _mm_storeu_si128((__m128i*)bd, bestv);
+  _mm_storeu_si128((__m128i*)bi, bestiv);
+  for (u32 k = 0; k < 4; k++) {
+    if (bd[k] < best || (bd[k] == best && (u32)bi[k] < besti)) {
+      best = bd[k];
+      besti = (u32)bi[k];
+    }
+  }
+#elif defined(__ARM_NEON)
+  const int16x8_t vr = vdupq_n_s16((i16)r);
+  const int16x8_t vg = vdupq_n_s16((i16)g);
+  const int16x8_t vb = vdupq_n_s16((i16)b);
+  int32x4_t bestv = vdupq_n_s32(INT32_MAX);
+  uint32x4_t bestiv = vdupq_n_u32(0);
+  uint32x4_t idx = {i, i + 1, i + 2, i + 3};
+  const uint32x4_t four = vdupq_n_u32(4);
+
+  for (; i + 8 <= p->last + 1; i += 8) {
+    int16x8_t dr = vsubq_s16(vld1q_s16(&p->soa[0][i]), vr);
+    int16x8_t dg = vsubq_s16(vld1q_s16(&p->soa[1][i]), vg);
+    int16x8_t db = vsubq_s16(vld1q_s16(&p->soa[2][i]), vb);
+
+    int32x4_t d_lo = vmull_s16(vget_low_s16(dr), vget_low_s16(dr));
+    d_lo = vmlal_s16(d_lo, vget_low_s16(dg), vget_low_s16(dg));
+    d_lo = vmlal_s16(d_lo, vget_low_s16(db), vget_low_s16(db));
+    int32x4_t d_hi = vmull_s16(vget_high_s16(dr), vget_high_s16(dr));
+    d_hi = vmlal_s16(d_hi, vget_high_s16(dg), vget_high_s16(dg));
+    d_hi = vmlal_s16(d_hi, vget_high_s16(db), vget_high_s16(db));
+
+    uint32x4_t lt = vcltq_s32(d_lo, bestv);
+    bestv = vbslq_s32(lt, d_lo, bestv);
+    bestiv = vbslq_u32(lt, idx, bestiv);
+    idx = vaddq_u32(idx, four);
+
+    lt = vcltq_s32(d_hi, bestv);
+    bestv = vbslq_s32(lt, d_hi, bestv);
+    bestiv = vbslq_u32(lt, idx, bestiv);
+    idx = vaddq_u32(idx, four);
+  }
+
+  i32 bd[4];
+  u32 bi[4];
+  vst1q_s32(bd, bestv);
+  vst1q_u32(bi, bestiv);
+  for (u32 k = 0; k < 4; k++) {
+    if (bd[k] < best || (bd[k] == best && bi[k] < besti)) {
+      best = bd[k];
+      besti = bi[k];
+    }
+  }
+#endif
+
+  for (; i <= p->last; i++) {
+    i32 d = _pal_dist(p, i, r, g, b);
+    if (d < best) {
+      best = d;
+      besti = i;
+    }
+  }
+  return (u8)besti;
+}
+
+u8 palette_nearest(const palette* p, u8 r, u8 g, u8 b, bool exact) {
+  u32 c = _pal_cell(r, g, b);
+  if (!exact)
+    return p->cube[c];
+
+  const u8* cand = p->cand + p->cell_start[c];
+  u32 n = p->cell_start[c + 1] - p->cell_start[c];
+  i32 best = INT32_MAX;
+  u8 besti = cand[0];
+  for (u32 k = 0; k < n; k++) {
+    i32 d = _pal_dist(p, cand[k], r, g, b);
+    if (d < best) {
+      best = d;
+      besti = cand[k];
+    }
+  }
+  return besti;
+}
+
+void palette_quantize(const palette* p,
+                      u8* dst,
+                      const u8* rgba,
+                      sz n,
+                      bool exact) {
+  if (!exact) {
+    img_quantize_lut(dst, rgba, n, p->cube, PALETTE_CUBE_BITS,
+                     PALETTE_TRANSPARENT);
+    return;
+  }
+  for (sz i = 0; i < n; i++) {
+    const u8* px = rgba + i * 4;
+    dst[i] = px[3] < 128 ? PALETTE_TRANSPARENT
+                         : palette_nearest(p, px[0], px[1], px[2], true);
+  }
+}
+
+void palette_expand(const palette* p,
+                    u32* dst,
+                    const u8* src,
+                    sz n,
+                    bool transparent) {
+  img_expand(dst, src, n, p->rgba);
+  if (transparent)
+    img_mask_index(dst, src, n, PALETTE_TRANSPARENT);
+}
+
+void palette_write_png(const palette* p,
+                       cstr path,
+                       const u8* pixels,
+                       u32 width,
+                       u32 height,
+                       bool transparent,
+                       u32 level) {
+  png_write(path, pixels, width, height, p->rgba,
+            transparent ? PALETTE_TRANSPARENT : -1, level);
+}
+
+#endif  // PALETTE_IMPLEMENTATION
+#endif  //_PALETTE_HEADER_
@@ -0,0 +1,337 @@
+#ifndef _PNG_HEADER_
+#define _PNG_HEADER_
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../utils/types.h"
+#include "../utils/io.h"
+#include "../utils/macros.h"
+
+static constexpr u32 PNG_LEVEL_STORE = 0;    // no compression, for previews
+static constexpr u32 PNG_LEVEL_DEFAULT = 6;
+static constexpr u32 PNG_LEVEL_MAX = 9;
+static constexpr u32 PNG_STORE_BLOCK = 65535;  // largest stored deflate block
+
+// 8-bit indexed image, split in two steps so pipelines can filter and
+// compress on different threads
+typedef struct {
+  u32 width;
+  u32 height;
+  u32 level;
+  u8 plte[256 * 3];
+  u8 trns[256];
+  u32 trns_len;   // 0 when nothing is transparent
+  u8* filtered;   // height rows of a filter byte plus width indices (malloc)
+  sz filtered_len;
+} png_image;
+
+/* ****************** png API ****************** */
+
+// Builds PLTE/tRNS from an RGBA lookup table and filters the rows, a
+// 'transparent' index below 0 means the image is opaque
+void png_prepare(png_image*, const u8*, u32, u32, const u32*, i32, u32);
+
+// Compresses and assembles the file, releases the filtered rows and returns
+// a malloc'd buffer of 'len' bytes
+u8* png_encode(png_image*, sz*);
+
+// Both of the above, straight to 'path'
+void png_write(cstr, const u8*, u32, u32, const u32*, i32, u32);
+
+u32 png_crc32(u32, const u8*, sz);
+u32 png_adler32(u32, const u8*, sz);
+
+// Parses a --level argument, false unless it is a whole number within
+// PNG_LEVEL_STORE..PNG_LEVEL_MAX
+bool png_level_parse(cstr, u32*);
+
+/* ****************** png API ****************** */
+
+//  _                 _                           _        _   _
+// (_)               | |                         | |      | | (_)
+//  _ _ __ ___  _ __ | | ___ _ __ ___   ___ _ __ | |_ __ _| |_ _  ___  _ __
+// | | '_ ` _ \| '_ \| |/ _ \ '_ ` _ \ / _ \ '_ \| __/ _` | __| |/ _ \| '_ \
+// | | | | | | | |_) | |  __/ | | | | |  __/ | | | || (_| | |_| | (_) | | | |
+// |_|_| |_| |_| .__/|_|\___|_| |_| |_|\___|_| |_|\__\__,_|\__|_|\___/|_| |_|
+//             | |
+//             |_|
+
+#ifdef PNG_IMPLEMENTATION
+
+// stb_image_write implements this but leaves it out of its public header
+unsigned char* stbi_zlib_compress(unsigned char*, int, int*, int);
+
+/*****************************
+ * HIDDEN FUNCTIONS
+ *****************************/
+
+static u32 _png_crc_table[4][256];
+static pthread_once_t _png_once = PTHREAD_ONCE_INIT;
+
+static void _png_init_tables(void) {
+  for (u32 i = 0; i < 256; i++) {
+    u32 c = i;
+    for (u32 k = 0; k < 8; k++)
+      c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+    _png_crc_table[0][i] = c;
+  }
+  // slicing by four: table t holds the crc of a byte followed by t zeros
+  for (u32 i = 0; i < 256; i++) {
+    u32 c = _png_crc_table[0][i];
+    for (u32 t = 1; t < 4; t++) {
+      c = _png_crc_table[0][c & 0xFF] ^ (c >> 8);
+      _png_crc_table[t][i] = c;
+    }
+  }
+}
+
+static void _png_put32(u8* p, u32 v) {
+  p[0] = (u8)(v >> 24);
+  p[1] = (u8)(v >> 16);
+  p[2] = (u8)(v >> 8);
+  p[3] = (u8)v;
+}
+
+static u32 _png_sad(const u8* row, sz n) {
+  u32 s = 0;
+  for (sz i = 0; i < n; i++)
+    s += (u32)abs((i8)row[i]);
+  return s;
+}
+
+// Per row, keeps whichever of None, Sub and Up has the smallest sum of
+// absolute (signed) residuals; Average and Paeth rarely win on indexed art
+// and cost the most to evaluate
+static void _png_filter(png_image* img, const u8* pixels) {
+  u32 w = img->width;
+  sz stride = (sz)w + 1;
+  u8* cand = (u8*)malloc(w * 2);
+  makesure(cand != NULL, "malloc failed");
+
+  for (u32 y = 0; y < img->height; y++) {
+    const u8* row = pixels + (sz)y * w;
+    u8* out = img->filtered + y * stride;
+
+    if (img->level == PNG_LEVEL_STORE) {
+      out[0] = 0;
+      memcpy(out + 1, row, w);
+      continue;
+    }
+
+    u8* sub = cand;
+    u8* up = cand + w;
+    sub[0] = row[0];
+    for (u32 x = 1; x < w; x++)
+      sub[x] = (u8)(row[x] - row[x - 1]);
+    const u8* prev = y ? row - w : NULL;
+    for (u32 x = 0; x < w; x++)
+      up[x] = prev ? (u8)(row[x] - prev[x]) : row[x];
+
+    u32 sn = _png_sad(row, w);
+    u32 ss = _png_sad(sub, w);
+    u32 su = y ? _png_sad(up, w) : UINT32_MAX;
+
+    if (sn <= ss && sn <= su) {
+      out[0] = 0;
+      memcpy(out + 1, row, w);
+    } else if (ss <= su) {
+      out[0] = 1;
+      memcpy(out + 1, sub, w);
+    } else {
+      out[0] = 2;
+      memcpy(out + 1, up, w);
+    }
+  }
+  free(cand);
+}
+
+// zlib stream of stored blocks, the data is only framed, never searched
+static u8* _png_store(const u8* data, sz len, sz* out_len) {
+  sz blocks = len / PNG_STORE_BLOCK + 1;
+  sz n = 2 + blocks * 5 + len + 4;
+  u8* out = (u8*)malloc(n);
+  makesure(out != NULL, "malloc failed");
+
+  u8* p = out;
+  *p++ = 0x78;
+  *p++ = 0x01;
+  sz left = len;
+  const u8* src = data;
+  do {
+    u32 bl = left > PNG_STORE_BLOCK ? PNG_STORE_BLOCK : (u32)left;
+    left -= bl;
+    *p++ = left ? 0 : 1;  // BFINAL on the last block, BTYPE 00
+    p[0] = (u8)bl;
+    p[1] = (u8)(bl >> 8);
+    p[2] = (u8)~bl;
+    p[3] = (u8)(~bl >> 8);
+    p += 4;
+    memcpy(p, src, bl);
+    p += bl;
+    src += bl;
+  } while (left);
+
+  _png_put32(p, png_adler32(1, data, len));
+  p += 4;
+  *out_len = (sz)(p - out);
+  return out;
+}
+
+static u8* _png_chunk(u8* p, cstr type, const u8* data, u32 len) {
+  _png_put32(p, len);
+  memcpy(p + 4, type, 4);
+  if (len)
+    memcpy(p + 8, data, len);
+  _png_put32(p + 8 + len, png_crc32(0, p + 4, len + 4));
+  return p + 12 + len;
+}
+
+/*****************************
+ * EXPORTED FUNCTIONS
+ *****************************/
+
+u32 png_crc32(u32 crc, const u8* data, sz len) {
+  pthread_once(&_png_once, _png_init_tables);
+  u32 c = ~crc;
+  sz i = 0;
+  for (; i + 4 <= len; i += 4) {
+    c ^= (u32)data[i] | (u32)data[i + 1] << 8 | (u32)data[i + 2] << 16 |
+         (u32)data[i + 3] << 24;
+    c = _png_crc_table[3][c & 0xFF] ^ _png_crc_table[2][(c >> 8) & 0xFF] ^
+        _png_crc_table[1][(c >> 16) & 0xFF] ^ _png_crc_table[0][c >> 24];
+  }
+  for (; i < len; i++)
+    c = _png_crc_table[0][(c ^ data[i]) & 0xFF] ^ (c >> 8);
+  return ~c;
+}
+
+u32 png_adler32(u32 adler, const u8* data, sz len) {
+  u32 a = adler & 0xFFFF;
+  u32 b = adler >> 16;
+  // 5552 is the longest run before b can overflow 32 bits
+  while (len) {
+    sz n = len < 5552 ? len : 5552;
+    len -= n;
+    while (n--) {
+      a += *data++;
+      b += a;
+    }
+    a %= 65521;
+    b %= 65521;
+  }
+  return b << 16 | a;
+}
+
+void png_prepare(png_image* img,
+                 const u8* pixels,
+                 u32 width,
+                 u32 height,
+                 const u32* lut,
+                 i32 transparent,
+                 u32 level) {
+  makesure(width > 0 && height > 0, "cannot encode an empty image");
+  img->width = width;
+  img->height = height;
+  img->level = level > PNG_LEVEL_MAX ? PNG_LEVEL_MAX : level;
+
+  for (u32 i = 0; i < 256; i++) {
+    img->plte[i * 3] = (u8)lut[i];
+    img->plte[i * 3 + 1] = (u8)(lut[i] >> 8);
+    img->plte[i * 3 + 2] = (u8)(lut[i] >> 16);
+  }
+
+  // tRNS may stop at the last non-opaque entry
+  img->trns_len = 0;
+  if (transparent >= 0 && transparent < 256) {
+    memset(img->trns, 0xFF, sizeof(img->trns));
+    img->trns[transparent] = 0;
+    img->trns_len = (u32)transparent + 1;
+  }
+
+  img->filtered_len = (sz)height * (width + 1);
+  img->filtered = (u8*)malloc(img->filtered_len);
+  makesure(img->filtered != NULL, "malloc failed");
+  _png_filter(img, pixels);
+}
+
+u8* png_encode(png_image* img, sz* len) {
+  static const u8 signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+
+  sz zlen = 0;
+  u8* z = NULL;
+  if (img->level == PNG_LEVEL_STORE) {
+    z = _png_store(img->filtered, img->filtered_len, &zlen);
+  } else {
+    // stb's compressor keeps 2 * quality candidates per hash chain
+    int zl = 0;
+    z = stbi_zlib_compress(img->filtered, (int)img->filtered_len, &zl,
+                           (int)img->level * 4);
+    makesure(z != NULL, "deflate failed");
+    zlen = (sz)zl;
+  }
+  free(img->filtered);
+  img->filtered = NULL;
+
+  u8 ihdr[13];
+  _png_put32(ihdr, img->width);
+  _png_put32(ihdr + 4, img->height);
+  ihdr[8] = 8;   // bit depth
+  ihdr[9] = 3;   // indexed colour
+  ihdr[10] = 0;  // deflate
+  ihdr[11] = 0;  // adaptive filtering
+  ihdr[12] = 0;  // no interlace
+
+  sz n = sizeof(signature) + 12 * 5 + sizeof(ihdr) + sizeof(img->plte) +
+         img->trns_len + zlen;
+  u8* out = (u8*)malloc(n);
+  makesure(out != NULL, "malloc failed");
+
+  u8* p = out;
+  memcpy(p, signature, sizeof(signature));
+  p += sizeof(signature);
+  p = _png_chunk(p, "IHDR", ihdr, sizeof(ihdr));
+  p = _png_chunk(p, "PLTE", img->plte, sizeof(img->plte));
+  if (img->trns_len)
+    p = _png_chunk(p, "tRNS", img->trns, img->trns_len);
+  p = _png_chunk(p, "IDAT", z, (u32)zlen);
+  p = _png_chunk(p, "IEND", NULL, 0);
+  free(z);
+
+  *len = (sz)(p - out);
+  return out;
+}
+
+void png_write(cstr path,
+               const u8* pixels,
+               u32 width,
+               u32 height,
+               const u32* lut,
+               i32 transparent,
+               u32 level) {
+  png_image img;
+  png_prepare(&img, pixels, width, height, lut, transparent, level);
+  sz len = 0;
+  u8* data = png_encode(&img, &len);
+
+  file_writer w;
+  file_writer_opts wo = {.flush_size = file_writer_flush_for(len),
+                         .prealloc = len};
+  file_writer_open(path, &wo, &w);
+  file_writer_write(&w, data, len);
+  file_writer_close(&w);
+  free(data);
+}
+
+bool png_level_parse(cstr arg, u32* level) {
+  char* end = NULL;
+  unsigned long v = strtoul(arg, &end, 10);
+  if (end == arg || *end || arg[0] == '-' || v > PNG_LEVEL_MAX)
+    return false;
+  *level = (u32)v;
+  return true;
+}
+
+#endif  // PNG_IMPLEMENTATION
+#endif  //_PNG_HEADER_
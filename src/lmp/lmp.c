@@ -0,0 +1,3 @@
+#define LMP_IMPLEMENTATION
+
+#include "lmp.h"
@@ -0,0 +1,483 @@
+#ifndef _LMP_HEADER_
+#define _LMP_HEADER_
+
+#include <string.h>
+#include <strings.h>
+
+#include "../../deps/fs.h"
+#include "../../deps/stb_image.h"
+#include "../utils/types.h"
+#include "../utils/io.h"
+#include "../utils/macros.h"
+#include "../utils/arena.h"
+#include "../utils/endian.h"
+#include "../utils/thread.h"
+#include "../img/palette.h"
+
+static constexpr u32 LMP_QPIC_HEADER_LEN = 8;
+static constexpr u32 LMP_COLORMAP_LEVELS = 64;
+static constexpr u32 LMP_COLORMAP_LEN = LMP_COLORMAP_LEVELS * PALETTE_COLORS;
+static constexpr u32 LMP_MAX_PATH_LEN = 1024;
+static constexpr u32 LMP_MAX_SIDE = 4096;  // sanity bound for qpic headers
+static constexpr u32 LMP_COLORMAP_BRIGHTS = 32;
+static constexpr f32 LMP_COLORMAP_RANGE = 2.0f;  // level 0 is twice as bright
+
+typedef enum lmperr { LMP_ERR_UNKNOWN = -1, LMP_ERR_OK = 0 } lmperr;
+
+typedef enum {
+  LMP_KIND_UNKNOWN = 0,
+  LMP_KIND_QPIC,      // width, height and width * height palette indices
+  LMP_KIND_PALETTE,   // 256 RGB triplets
+  LMP_KIND_COLORMAP,  // 64 light levels of 256 indices, plus a brights byte
+} lmp_kind;
+
+typedef struct {
+  file_view view;     // whole file, pixels point into it
+  lmp_kind kind;
+  u32 width;
+  u32 height;
+  sz size;            // lump size in bytes
+  const u8* pixels;   // indices for qpic/colormap, RGB triplets for palette
+} lmp;
+
+typedef struct {
+  cstr palette;  // palette.lmp, needed for qpic and colormap conversion
+  bool fast;     // encode: quantize with the cube alone, no exact search
+  u32 level;     // decode: png deflate level, 0 stores uncompressed
+  u32 levels;    // colormap: light levels, 0 means LMP_COLORMAP_LEVELS
+  u32 brights;   // colormap: trailing fullbright colours that never shade
+  f32 range;     // colormap: brightness of level 0, 0 means the default
+} lmp_opts;
+
+// Classifies a lump from its name and contents, 'data' is not copied so it
+// must outlive the result (this is what lets pak members decode in place)
+lmp_kind lmp_parse(const u8*, sz, cstr, lmp*);
+void lmp_open(cstr, lmp*);
+void lmp_close(lmp*);
+cstr lmp_kind_name(lmp_kind);
+
+// Batch operations over many files, converted in parallel
+lmperr lmp_info(arena*, cstr*, u32);
+lmperr lmp_decode(arena*, cstr*, u32, cstr, const lmp_opts*);
+lmperr lmp_encode(arena*, cstr*, u32, cstr, const lmp_opts*);
+
+// colormap.lmp from a palette, or next to every palette.lmp under a mod
+lmperr lmp_colormap(arena*, cstr, cstr, const lmp_opts*);
+lmperr lmp_colormap_mod(arena*, cstr, const lmp_opts*);
+
+//  _                 _                           _        _   _
+// (_)               | |                         | |      | | (_)
+//  _ _ __ ___  _ __ | | ___ _ __ ___   ___ _ __ | |_ __ _| |_ _  ___  _ __
+// | | '_ ` _ \| '_ \| |/ _ \ '_ ` _ \ / _ \ '_ \| __/ _` | __| |/ _ \| '_ \
+// | | | | | | | |_) | |  __/ | | | | |  __/ | | | || (_| | |_| | (_) | | | |
+// |_|_| |_| |_| .__/|_|\___|_| |_| |_|\___|_| |_|\__\__,_|\__|_|\___/|_| |_|
+//             | |
+//             |_|
+
+#ifdef LMP_IMPLEMENTATION
+
+/*****************************
+ * HIDDEN FUNCTIONS
+ *****************************/
+
+static cstr _lmp_basename(cstr path) {
+  cstr s = strrchr(path, '/');
+  return s ? s + 1 : path;
+}
+
+// '<dir>/<file name without extension>.<ext>'
+static void _lmp_out_path(char* buf, cstr dir, cstr path, cstr ext) {
+  cstr name = _lmp_basename(path);
+  cstr dot = strrchr(name, '.');
+  i32 len = dot ? (i32)(dot - name) : (i32)strlen(name);
+  snprintf(buf, LMP_MAX_PATH_LEN * 2, "%s/%.*s.%s", dir, len, name, ext);
+}
+
+static void _lmp_make_dir(cstr dir) {
+  makesure(strlen(dir) < LMP_MAX_PATH_LEN,
+           "output director '%s' path length is larger than supported max of "
+           "'%d'",
+           dir, LMP_MAX_PATH_LEN);
+  fs_file_info od;
+  if (fs_info(NULL, dir, FS_READ, &od) == FS_SUCCESS) {
+    makesure(od.directory, "'%s' exists and is not a directory", dir);
+    return;
+  }
+  makesure(fs_mkdir(NULL, dir, 0) == FS_SUCCESS,
+           "failed to create directory '%s'", dir);
+}
+
+static void _lmp_write(cstr path, const u8* data, sz size) {
+  file_writer fw;
+  file_writer_opts wo = {.prealloc = size};
+  file_writer_open(path, &wo, &fw);
+  file_writer_write(&fw, data, size);
+  file_writer_close(&fw);
+}
+
+static bool _lmp_is_qpic(const u8* data, sz size, lmp* l) {
+  if (size < LMP_QPIC_HEADER_LEN)
+    return false;
+  i32 wh[2];
+  memcpy(wh, data, sizeof(wh));
+  i32 w = endian_i32(wh[0]);
+  i32 h = endian_i32(wh[1]);
+  if (w <= 0 || h <= 0 || w > (i32)LMP_MAX_SIDE || h > (i32)LMP_MAX_SIDE ||
+      LMP_QPIC_HEADER_LEN + (sz)w * h != size)
+    return false;
+
+  l->kind = LMP_KIND_QPIC;
+  l->width = (u32)w;
+  l->height = (u32)h;
+  l->pixels = data + LMP_QPIC_HEADER_LEN;
+  return true;
+}
+
+typedef struct {
+  cstr* files;
+  cstr dir;
+  const lmp_opts* o;
+  palette pal;
+  bool has_pal;
+  lmp* items;    // info results (arena)
+} lmp_job;
+
+static void _lmp_info_one(void* ctx, u32 i, u32 worker) {
+  lmp_job* job = (lmp_job*)ctx;
+  lmp* l = &job->items[i];
+  lmp_open(job->files[i], l);
+  file_view_close(&l->view);  // only the header fields are printed
+  l->pixels = NULL;
+}
+
+static void _lmp_decode_one(void* ctx, u32 i, u32 worker) {
+  lmp_job* job = (lmp_job*)ctx;
+  cstr path = job->files[i];
+  char out[LMP_MAX_PATH_LEN * 2];
+  _lmp_out_path(out, job->dir, path, "png");
+
+  lmp l;
+  lmp_open(path, &l);
+
+  switch (l.kind) {
+    case LMP_KIND_QPIC:
+    case LMP_KIND_COLORMAP:
+      makesure(job->has_pal, "'%s' needs a palette to decode, pass --palette",
+               path);
+      palette_write_png(&job->pal, out, l.pixels, l.width, l.height,
+                        l.kind == LMP_KIND_QPIC, job->o->level);
+      break;
+    case LMP_KIND_PALETTE: {
+      palette pal;
+      palette_from_rgb(&pal, l.pixels);
+      u8 swatch[PALETTE_COLORS];
+      for (u32 c = 0; c < PALETTE_COLORS; c++)
+        swatch[c] = (u8)c;
+      palette_write_png(&pal, out, swatch, 16, 16, false, job->o->level);
+      break;
+    }
+    default:
+      log_warn("skipping '%s', not a qpic, palette or colormap", path);
+      break;
+  }
+
+  lmp_close(&l);
+}
+
+static void _lmp_encode_one(void* ctx, u32 i, u32 worker) {
+  lmp_job* job = (lmp_job*)ctx;
+  cstr path = job->files[i];
+  char out[LMP_MAX_PATH_LEN * 2];
+  _lmp_out_path(out, job->dir, path, "lmp");
+
+  int w, h, comp;
+  u8* rgba = stbi_load(path, &w, &h, &comp, 4);
+  makesure(rgba != NULL, "failed to load '%s': %s", path,
+           stbi_failure_reason());
+  makesure(w <= (int)LMP_MAX_SIDE && h <= (int)LMP_MAX_SIDE,
+           "'%s' is %dx%d, larger than a qpic can be", path, w, h);
+
+  sz n = (sz)w * h;
+  u8* data = (u8*)malloc(LMP_QPIC_HEADER_LEN + n);
+  makesure(data != NULL, "malloc failed");
+  i32 wh[2] = {endian_i32(w), endian_i32(h)};
+  memcpy(data, wh, sizeof(wh));
+  palette_quantize(&job->pal, data + LMP_QPIC_HEADER_LEN, rgba, n,
+                   !job->o->fast);
+  stbi_image_free(rgba);
+
+  _lmp_write(out, data, LMP_QPIC_HEADER_LEN + n);
+  free(data);
+}
+
+typedef struct {
+  char (*palettes)[LMP_MAX_PATH_LEN];
+  palette* pals;
+  u8** maps;      // levels * 256 + 1 bytes per palette
+  u32 levels;
+  u32 brights;
+  f32 range;
+} lmp_colormap_job;
+
+// One light level of one palette, the same curve the id tools used: scale
+// every shadable colour by 'frac' and take the nearest non-fullbright, values
+// above 255 are left unclamped so overbright levels keep their hue
+static void _lmp_colormap_row(void* ctx, u32 i, u32 worker) {
+  lmp_colormap_job* job = (lmp_colormap_job*)ctx;
+  u32 map = i / job->levels;
+  u32 l = i % job->levels;
+  const palette* p = &job->pals[map];
+  u8* row = job->maps[map] + (sz)l * PALETTE_COLORS;
+
+  f32 frac = job->range - job->range * (f32)l / (f32)(job->levels - 1);
+  u32 c = 0;
+  for (; c < PALETTE_COLORS - job->brights; c++) {
+    const u8* rgb = p->rgb + c * 3;
+    row[c] = palette_nearest_full(p, (i32)(rgb[0] * frac + 0.5f),
+                                  (i32)(rgb[1] * frac + 0.5f),
+                                  (i32)(rgb[2] * frac + 0.5f));
+  }
+  for (; c < PALETTE_COLORS; c++)
+    row[c] = (u8)c;
+}
+
+// palette.lmp files under 'dir', counted when 'job' is NULL
+static void _lmp_collect_palettes(cstr dir, lmp_colormap_job* job, u32* n) {
+  fs_iterator* it = fs_first(NULL, dir, FS_READ);
+  for (; it; it = fs_next(it)) {
+    char sub[LMP_MAX_PATH_LEN];
+    makesure(snprintf(sub, sizeof(sub), "%s/%s", dir, it->pName) <
+                 (int)sizeof(sub),
+             "'%s/%s' is longer than '%u' characters", dir, it->pName,
+             LMP_MAX_PATH_LEN - 1);
+
+    if (it->info.directory) {
+      _lmp_collect_palettes(sub, job, n);
+      continue;
+    }
+    if (strcasecmp(it->pName, "palette.lmp"))
+      continue;
+
+    if (job)
+      memcpy(job->palettes[*n], sub, sizeof(sub));
+    (*n)++;
+  }
+}
+
+static void _lmp_colormap_run(arena* m, lmp_colormap_job* job, u32 count,
+                              const lmp_opts* o) {
+  job->levels = o->levels ? o->levels : LMP_COLORMAP_LEVELS;
+  job->brights = o->brights;
+  job->range = o->range > 0 ? o->range : LMP_COLORMAP_RANGE;
+  makesure(job->levels >= 2 && job->levels <= 256,
+           "a colormap needs 2 to 256 light levels, not '%u'", job->levels);
+  makesure(job->brights < PALETTE_COLORS,
+           "at least one colour has to be shaded, '%u' brights is too many",
+           job->brights);
+
+  sz size = (sz)job->levels * PALETTE_COLORS + 1;
+  for (u32 i = 0; i < count; i++) {
+    palette_load(&job->pals[i], job->palettes[i]);
+    job->pals[i].last = PALETTE_COLORS - job->brights - 1;
+    job->maps[i] = (u8*)arena_alloc(m, size, 1);
+    notnull(job->maps[i]);
+    job->maps[i][size - 1] = (u8)job->brights;
+  }
+
+  // every row of every map is independent, so they all share one pool
+  thread_parallel_for(count * job->levels, _lmp_colormap_row, job);
+}
+
+
+/*****************************
+ * EXPORTED FUNCTIONS
+ *****************************/
+
+lmp_kind lmp_parse(const u8* data, sz size, cstr name, lmp* l) {
+  l->kind = LMP_KIND_UNKNOWN;
+  l->width = 0;
+  l->height = 0;
+  l->size = size;
+  l->pixels = NULL;
+  cstr base = name ? _lmp_basename(name) : "";
+
+  // the two well known names win, then the qpic header has to add up
+  bool is_pal = !strcasecmp(base, "palette.lmp");
+  bool is_cmap = !strcasecmp(base, "colormap.lmp");
+  if (!is_pal && !is_cmap && _lmp_is_qpic(data, size, l))
+    return l->kind;
+
+  if ((is_pal || size == PALETTE_LEN) && size >= PALETTE_LEN) {
+    l->kind = LMP_KIND_PALETTE;
+    l->width = 16;
+    l->height = 16;
+    l->pixels = data;
+  } else if ((is_cmap || size == LMP_COLORMAP_LEN ||
+              size == LMP_COLORMAP_LEN + 1) &&
+             size >= LMP_COLORMAP_LEN) {
+    l->kind = LMP_KIND_COLORMAP;
+    l->width = PALETTE_COLORS;
+    l->height = LMP_COLORMAP_LEVELS;
+    l->pixels = data;
+  }
+  return l->kind;
+}
+
+void lmp_open(cstr path, lmp* l) {
+  file_view_open(path, &l->view);
+  lmp_parse(l->view.data, l->view.size, path, l);
+}
+
+void lmp_close(lmp* l) {
+  file_view_close(&l->view);
+  l->pixels = NULL;
+}
+
+cstr lmp_kind_name(lmp_kind kind) {
+  switch (kind) {
+    case LMP_KIND_QPIC:
+      return "qpic";
+    case LMP_KIND_PALETTE:
+      return "palette";
+    case LMP_KIND_COLORMAP:
+      return "colormap";
+    default:
+      return "unknown";
+  }
+}
+
+lmperr lmp_info(arena* m, cstr* files, u32 count) {
+  arena_begin_estimate(m);
+  arena_estimate_add(m, count * sizeof(lmp), alignof(lmp));
+  arena_end_estimate(m);
+
+  lmp_job job = {.files = files};
+  job.items = (lmp*)arena_alloc(m, count * sizeof(lmp), alignof(lmp));
+  notnull(job.items);
+  thread_parallel_for(count, _lmp_info_one, &job);
+
+  printf("************** INFO **************\n");
+  printf("       (index | name | kind | size | dimensions)\n");
+  for (u32 i = 0; i < count; i++) {
+    lmp* l = &job.items[i];
+    printf("↬ [%u] %s : %s : %zu Bytes", i + 1, files[i],
+           lmp_kind_name(l->kind), l->size);
+    if (l->kind != LMP_KIND_UNKNOWN)
+      printf(" : %ux%u", l->width, l->height);
+    printf("\n");
+  }
+
+  return LMP_ERR_OK;
+}
+
+lmperr lmp_decode(arena* m, cstr* files, u32 count, cstr odir,
+                  const lmp_opts* o) {
+  _lmp_make_dir(odir);
+
+  lmp_job job = {.files = files, .dir = odir, .o = o};
+  if (o->palette) {
+    palette_load(&job.pal, o->palette);
+    job.has_pal = true;
+  }
+  thread_parallel_for(count, _lmp_decode_one, &job);
+  return LMP_ERR_OK;
+}
+
+lmperr lmp_encode(arena* m, cstr* files, u32 count, cstr odir,
+                  const lmp_opts* o) {
+  makesure(o->palette, "encoding needs a palette, pass --palette");
+  _lmp_make_dir(odir);
+
+  // qpics are drawn unlit, so every colour but the transparent one is usable
+  lmp_job job = {.files = files, .dir = odir, .o = o};
+  palette_load(&job.pal, o->palette);
+  palette_build_quant(&job.pal, 0, PALETTE_TRANSPARENT - 1);
+
+  thread_parallel_for(count, _lmp_encode_one, &job);
+  palette_free(&job.pal);
+  return LMP_ERR_OK;
+}
+
+lmperr lmp_colormap(arena* m, cstr pal, cstr path, const lmp_opts* o) {
+  makesure(strlen(pal) < LMP_MAX_PATH_LEN,
+           "palette path '%s' is longer than '%u' characters", pal,
+           LMP_MAX_PATH_LEN - 1);
+  u32 levels = o->levels ? o->levels : LMP_COLORMAP_LEVELS;
+
+  arena_begin_estimate(m);
+  arena_estimate_add(m, LMP_MAX_PATH_LEN, 1);
+  arena_estimate_add(m, sizeof(palette), alignof(palette));
+  arena_estimate_add(m, sizeof(u8*), alignof(u8*));
+  arena_estimate_add(m, (sz)levels * PALETTE_COLORS + 1, 1);
+  arena_end_estimate(m);
+
+  lmp_colormap_job job = {0};
+  job.palettes = (typeof(job.palettes))arena_alloc(m, LMP_MAX_PATH_LEN, 1);
+  job.pals = (palette*)arena_alloc(m, sizeof(palette), alignof(palette));
+  job.maps = (u8**)arena_alloc(m, sizeof(u8*), alignof(u8*));
+  notnull(job.palettes);
+  notnull(job.pals);
+  notnull(job.maps);
+  snprintf(job.palettes[0], LMP_MAX_PATH_LEN, "%s", pal);
+
+  _lmp_colormap_run(m, &job, 1, o);
+  sz size = (sz)job.levels * PALETTE_COLORS + 1;
+  _lmp_write(path, job.maps[0], size);
+
+  printf("************** COLORMAP **************\n");
+  printf("↬ file name:      '%s'\n", path);
+  printf("↬ file size:      '%zu Bytes'\n", size);
+  printf("↬ light levels:   '%u'\n", job.levels);
+  printf("↬ brights:        '%u'\n", job.brights);
+  return LMP_ERR_OK;
+}
+
+lmperr lmp_colormap_mod(arena* m, cstr dir, const lmp_opts* o) {
+  fs_file_info fi;
+  makesure(fs_info(NULL, dir, FS_READ, &fi) == FS_SUCCESS && fi.directory,
+           "the mod directory at '%s' does not exist", dir);
+  u32 levels = o->levels ? o->levels : LMP_COLORMAP_LEVELS;
+
+  u32 count = 0;
+  _lmp_collect_palettes(dir, NULL, &count);
+  makesure(count > 0, "no palette.lmp found under '%s'", dir);
+
+  arena_begin_estimate(m);
+  arena_estimate_add(m, count * LMP_MAX_PATH_LEN, 1);
+  arena_estimate_add(m, count * sizeof(palette), alignof(palette));
+  arena_estimate_add(m, count * sizeof(u8*), alignof(u8*));
+  for (u32 i = 0; i < count; i++)
+    arena_estimate_add(m, (sz)levels * PALETTE_COLORS + 1, 1);
+  arena_end_estimate(m);
+
+  lmp_colormap_job job = {0};
+  job.palettes =
+      (typeof(job.palettes))arena_alloc(m, count * LMP_MAX_PATH_LEN, 1);
+  job.pals =
+      (palette*)arena_alloc(m, count * sizeof(palette), alignof(palette));
+  job.maps = (u8**)arena_alloc(m, count * sizeof(u8*), alignof(u8*));
+  notnull(job.palettes);
+  notnull(job.pals);
+  notnull(job.maps);
+
+  u32 n = 0;
+  _lmp_collect_palettes(dir, &job, &n);
+  makesure(n == count, "the mod directory changed while scanning");
+
+  _lmp_colormap_run(m, &job, count, o);
+
+  printf("************** COLORMAP **************\n");
+  sz size = (sz)job.levels * PALETTE_COLORS + 1;
+  for (u32 i = 0; i < count; i++) {
+    char out[LMP_MAX_PATH_LEN * 2];
+    cstr slash = strrchr(job.palettes[i], '/');
+    snprintf(out, sizeof(out), "%.*s/colormap.lmp",
+             (int)(slash - job.palettes[i]), job.palettes[i]);
+    _lmp_write(out, job.maps[i], size);
+    printf("↬ [%u] %s\n", i + 1, out);
+  }
+  return LMP_ERR_OK;
+}
+
+#endif  // LMP_IMPLEMENTATION
+#endif  //_LMP_HEADER_
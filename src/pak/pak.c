@@ -1,6 +1,13 @@
 #define UTILS_IO_IMPLEMENTATION
 #define UTILS_ARENA_IMPLEMENTATION
 #define UTILS_ENDIAN_IMPLEMENTATION
+#define UTILS_HASH_IMPLEMENTATION
+#define UTILS_POOL_IMPLEMENTATION
+#define UTILS_INTERN_IMPLEMENTATION
+#define UTILS_THREAD_IMPLEMENTATION
 #define PAK_IMPLEMENTATION
+#define PAK_FS_IMPLEMENTATION
 
+#include "../utils/all.h"
 #include "pak.h"
+#include "pak_fs.h"
@@ -1,7 +1,17 @@
 #ifndef _PAK_HEADER_
 #define _PAK_HEADER_
 
+#include <ctype.h>
 #include <string.h>
+#include <strings.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <time.h>
+#if defined(__linux__)
+#include <limits.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#endif
 
 #include "../../deps/fs.h"
 #include "../utils/types.h"
@@ -9,6 +19,11 @@
 #include "../utils/macros.h"
 #include "../utils/arena.h"
 #include "../utils/endian.h"
+#include "../utils/hash.h"
+#include "../utils/thread.h"
+#include "../wad/wad.h"
+#include "../lmp/lmp.h"
+#include "../pk3/pk3.h"
 
 static constexpr u8 MAGIC_CODE[] = "PACK";
 static constexpr u8 MAGIC_CODE_LEN = 4;
@@ -16,15 +31,28 @@ static constexpr u32 HEADER_LEN = 12;
 static constexpr u32 ENTRY_NAME_LEN = 56;
 static constexpr u32 ENTRY_LEN = ENTRY_NAME_LEN + 4 + 4;
 static constexpr u32 MAX_PATH_LEN = 1024;
-static constexpr u32 MAX_FILE_SIZE = 25 * 1024 * 1024;
+static constexpr u32 READAHEAD_WINDOW = 16 * 1024 * 1024;
+static constexpr u32 EXPORT_QUEUE_LEN = 64;  // items between pipeline stages
+static constexpr u32 CONVERT_WINDOW = 64;    // entries in flight, convert
+static constexpr u32 ALIGN_MAX = 1024 * 1024;  // largest entry alignment
+static constexpr u32 ALIGN_PAD_LEN = 4096;     // zeros written per pad step
+static constexpr char MANIFEST_EXT[] = ".manifest";
+static constexpr u32 WATCH_SETTLE_MS = 20;  // quiet time that closes a batch
+static constexpr u32 WATCH_DEAD_PCT = 25;   // dead space that forces compact
+static constexpr u32 GREP_RANGE = 1024 * 1024;  // bytes per grep work item
+static constexpr u32 GREP_OPEN_PAKS = 64;       // paks mapped at once by grep
+static constexpr char MANIFEST_HEADER[] = "sqt-manifest 1 %lld\n";
+static constexpr i32 BSP_VERSION = 29;
+static constexpr u32 BSP_LUMPS = 15;
+static constexpr u32 BSP_LUMP_TEXTURES = 2;
 
 static u8 HEADER_BUF[HEADER_LEN] = {0};
 static u8 ENTRY_BUF[ENTRY_LEN] = {0};
 static char DIR_BUF[MAX_PATH_LEN + ENTRY_NAME_LEN] = {0};
 static char PATH_BUF[MAX_PATH_LEN + ENTRY_NAME_LEN] = {0};
-static char DATA_BUF[MAX_FILE_SIZE] = {0};
+static const u8 PAD_BUF[ALIGN_PAD_LEN] = {0};
 
-typedef FILE* pakf;
+typedef int pakf;  // file descriptor, read with file_read_at
 typedef enum pakerr { PAK_ERR_UNKNOWN = -1, PAK_ERR_OK = 0 } pakerr;
 
 typedef struct {
@@ -39,6 +67,8 @@ typedef struct {
   i32 size;                 // size of the entry file data
 } pak_entry;
 
+static_assert(sizeof(pak_entry) == ENTRY_LEN, "pak_entry must match disk");
+
 typedef struct {
   u32 entries_count;
   sz entries_size;
@@ -50,10 +80,158 @@ typedef struct pak_s {
   pak_entry* entries;
 } pak;
 
+typedef struct {
+  bool direct;   // write outputs with O_DIRECT, bypassing the page cache
+  bool png;      // export: convert image entries to PNG
+  cstr palette;  // export: palette.lmp, defaults to the pak's gfx/palette.lmp
+  u32 level;     // export/convert: deflate level, 0 stores uncompressed
+  cstr order;    // create/compact: load-order trace the data is laid out by
+  u32 align;     // create/compact: entry offset alignment, 0 packs tightly
+  bool update;   // extract: rewrite changed entries only, drop stale files
+} pak_opts;
+
+// One picture travelling through the export pipeline, its indices point
+// straight into the mapped pak
+typedef struct {
+  char path[MAX_PATH_LEN + ENTRY_NAME_LEN + WAD_LUMP_NAME_LEN + 8];
+  const u8* pixels;
+  u32 width;
+  u32 height;
+  bool transparent;  // index 255 becomes clear
+  palette* own;      // palette lumps are drawn with themselves
+  png_image img;     // filter stage output
+  u8* png;           // encode stage output
+  sz png_len;
+} pak_export_item;
+
+// read (caller) -> filter -> encode (many) -> write, with bounded queues
+typedef struct {
+  const pak_opts* o;
+  palette pal;
+  thread_queue to_filter;
+  thread_queue to_encode;
+  thread_queue to_write;
+  void* slots[3][EXPORT_QUEUE_LEN];
+  u8 swatch[PALETTE_COLORS];  // every index once, how palettes are drawn
+  u32 read;
+  u32 written;
+} pak_export_job;
+
+// One entry travelling through convert, 'e' describes the output record
+typedef struct {
+  pk3_entry e;
+  const u8* src;  // entry bytes as they sit in the input mapping
+  const u8* out;  // bytes to write, 'src' itself or into 'block'
+  u8* block;      // worker allocation, freed once written
+  bool ready;     // reached the writer, which may still be waiting on others
+} pak_convert_item;
+
+// read (caller) -> deflate/inflate (many) -> write, entries leave the writer
+// in directory order so the output does not depend on thread timing
+typedef struct {
+  const pak_opts* o;
+  pk3* zip;  // input when converting back to a pak
+  pak_convert_item* items;
+  u32 count;
+  bool to_pk3;
+  _Atomic u32 failed;  // entries that could not be read
+  file_writer w;
+  thread_queue to_work;
+  thread_queue to_write;
+  thread_queue credits;  // caps the items between reader and writer
+  void* slots[3][CONVERT_WINDOW];
+  pak_entry* dir;  // pak output directory, already in disk byte order
+} pak_convert_job;
+
+// Directory-driven readahead state, entries are visited in table order
+typedef struct {
+  file_view* view;
+  pak_entry* entries;
+  u32 count;
+  u32 ahead;   // next entry that has not been hinted yet
+  u64 queued;  // bytes hinted but not consumed yet
+} pak_prefetch;
+
+// What the last 'extract --update' wrote for one entry
+typedef struct {
+  u64 hash;   // hash_content of the entry bytes
+  i64 size;
+  i64 mtime;  // output file modification time once written
+  bool known;
+} pak_manifest_row;
+
+// Incremental extract state, 'rows' is indexed like the pak directory
+typedef struct {
+  u32* index;  // entry names, the last of a duplicated name wins like on disk
+  u32 mask;
+  pak_manifest_row* rows;
+  i64 since;  // when the manifest was saved, later mtimes are not trusted
+  u32 written;
+  u32 kept;
+  u32 removed;
+} pak_update;
+
+typedef struct {
+  int wd;     // inotify watch descriptor, -1 once the kernel dropped it
+  char* rel;  // directory relative to the watched root, "" for the root
+} pak_watch_dir;
+
+// 'create --watch' state. The directory lives in memory and every change is
+// appended after the current on-disk directory, so a reader always sees
+// either the previous or the next pak, never half of one
+typedef struct {
+  cstr dir;
+  cstr path;
+  const pak_opts* o;
+  pak p;  // malloc'd entries in name order
+  u32 count;
+  u32 cap;
+  u64 end;  // file size, the directory is always last
+  int notify;
+  pak_watch_dir* dirs;
+  u32 dirs_count;
+  u32 dirs_cap;
+  char** changed;  // relative paths touched since the last batch
+  u32 changed_count;
+  u32 changed_cap;
+  bool rescan;  // the kernel queue overflowed, events were lost
+} pak_watcher;
+
+// One slice of an entry for grep, a match may start anywhere in [from, to)
+// and run past 'to'
+typedef struct {
+  u32 pak;
+  u32 entry;
+  u64 from;
+  u64 to;
+  u64* hits;  // malloc'd offsets inside the entry
+  u32 hits_count;
+  u32 hits_cap;
+} pak_grep_item;
+
+typedef struct {
+  file_view* views;
+  pak* paks;
+  pak_grep_item* items;
+  const u8* pat;
+  sz len;
+} pak_grep_job;
+
 pakerr pak_info(arena*, cstr, pak*);
 pakerr pak_list(arena*, cstr, pak*);
-pakerr pak_extract(arena*, cstr, cstr, pak*);
-pakerr pak_create(arena*, cstr, pak*);
+pakerr pak_extract(arena*, cstr, cstr, const pak_opts*, pak*);
+pakerr pak_create(arena*, cstr, cstr, const pak_opts*, pak*);
+pakerr pak_export(arena*, cstr, cstr, const pak_opts*, pak*);
+// PAK to PK3 or back, whichever the input is not
+pakerr pak_convert(arena*, cstr, cstr, const pak_opts*, pak*);
+// Rewrites a pak with its data packed back to back, dropping dead space. The
+// data keeps its order unless --order gives a new trace
+pakerr pak_compact(arena*, cstr, cstr, const pak_opts*, pak*);
+// pak_create, then keeps the pak in step with the directory until killed
+pakerr pak_watch(arena*, cstr, cstr, const pak_opts*, pak*);
+// Prints pak, entry and offset of every occurrence of a byte pattern, like
+// grep it fails when there is none
+pakerr pak_grep(arena*, cstr*, u32, const u8*, sz);
 
 //  _                 _                           _        _   _
 // (_)               | |                         | |      | | (_)
@@ -66,13 +244,16 @@ pakerr pak_create(arena*, cstr, pak*);
 
 #ifdef PAK_IMPLEMENTATION
 
+// from stb_image_write, which keeps it out of its public header
+unsigned char* stbi_zlib_compress(unsigned char*, int, int*, int);
+
 /*****************************
  * HIDDEN FUNCTIONS
  *****************************/
 
 static void _read_header(pakf f, pak_header* h) {
   memset(HEADER_BUF, 0, HEADER_LEN);
-  makesure(fread(HEADER_BUF, 1, HEADER_LEN, f) == HEADER_LEN,
+  makesure(file_read_at(f, HEADER_BUF, HEADER_LEN, 0) == HEADER_LEN,
            "failed to read header data");
 
   pak_header* hp = (pak_header*)HEADER_BUF;
@@ -86,83 +267,1331 @@ static void _read_header(pakf f, pak_header* h) {
   makesure(h->size > 0, "invalud header size");
 }
 
+// The on-disk directory has the same layout as 'pak_entry', so it is read in
+// one positional read straight into the arena and fixed up in place
 static sz _read_entries(arena* m, pakf f, pak* p, pak_meta* pm) {
   sz ts = 0;
   i32 of = p->header.offset;
   u32 fc = pm->entries_count;
-  sz fs = pm->entries_size;
   sz ez = pm->entries_count * sizeof(pak_entry) /*FILE_ENTRY_LEN*/;
 
   p->entries = (pak_entry*)arena_alloc(m, ez, alignof(pak_entry));
   notnull(p->entries);
 
-  fseek(f, of, SEEK_SET);
-  for (u32 i = 0; i < fc; i++) {
-    memset(ENTRY_BUF, 0, ENTRY_LEN);
-    makesure(fread(ENTRY_BUF, 1, ENTRY_LEN, f) == ENTRY_LEN,
-             "failed to read entry data at index '%u'", i);
+  makesure(file_read_at(f, p->entries, ez, of) == ez,
+           "failed to read the entries table at offset '%d'", of);
 
-    pak_entry* ppe = (pak_entry*)ENTRY_BUF;
-    memcpy(p->entries[i].name, ppe->name, ENTRY_NAME_LEN);
-    p->entries[i].offset = endian_i32(ppe->offset);
-    p->entries[i].size = endian_i32(ppe->size);
-  }
-  return ts;
-}
-
-static sz _total_entries_size(pakf f, i32 ofs, u32 fc) {
-  sz ts = 0;
+  endian_i32_fields(p->entries, fc, sizeof(pak_entry),
+                    offsetof(pak_entry, offset), 2);
+  for (u32 i = 0; i < fc; i++)
+    ts += p->entries[i].size;
 
-  fseek(f, ofs, SEEK_SET);
-  for (u32 i = 0; i < fc; i++) {
-    memset(ENTRY_BUF, 0, ENTRY_LEN);
-    makesure(fread(ENTRY_BUF, 1, ENTRY_LEN, f) == ENTRY_LEN,
-             "failed to read entry data at index '%u'", i);
-    ts += endian_i32(((pak_entry*)ENTRY_BUF)->size);
-  }
+  pm->entries_size = ts;
   return ts;
 }
 
 static void _read_all(arena* m, pakf f, cstr fp, pak* p, pak_meta* pm) {
-  i32 ofc = p->header.offset;
-  u32 fc = pm->entries_count;
-  makesure(f != NULL, "faied to open file '%s'", f);
+  makesure(f >= 0, "faied to open file '%s'", fp);
 
   _read_header(f, &p->header);
   _read_entries(m, f, p, pm);
 }
 
-static void _estimate(arena* m, cstr fp, pak_meta* pm) {
+static void _estimate(arena* m, pakf f, pak_meta* pm) {
   arena_begin_estimate(m);
 
-  pakf f = fopen(fp, "rb");
-  makesure(f != NULL, "faied to open file '%s'", f);
-
   pak p = {0};
   _read_header(f, &p.header);
   pm->entries_count = p.header.size / ENTRY_LEN;
-  pm->entries_size = _total_entries_size(f, p.header.offset, pm->entries_count);
 
   sz ez = pm->entries_count * ENTRY_LEN;
   arena_estimate_add(m, ez, alignof(pak_entry));
 
-  fseek(f, 0, SEEK_END);
-  pm->pak_size = ftell(f);
-  fclose(f);
+  pm->pak_size = file_fd_size(f);
 
   /* arena_estimate_add(m, sizeof(), alignof(u32)); */
   arena_end_estimate(m);
 }
 
+// The whole directory is known before any data is touched, so upcoming
+// entries are hinted a window ahead and consumed ones are dropped again
+static void _prefetch_init(pak_prefetch* pf, file_view* v, pak* p, u32 fc) {
+  *pf = (pak_prefetch){.view = v, .entries = p->entries, .count = fc};
+}
+
+static void _prefetch_next(pak_prefetch* pf, u32 i) {
+  while (pf->ahead < pf->count &&
+         (pf->ahead <= i || pf->queued < READAHEAD_WINDOW)) {
+    pak_entry* e = &pf->entries[pf->ahead++];
+    file_view_advise(pf->view, e->offset, e->size, FILE_ADVICE_WILLNEED);
+    pf->queued += e->size;
+  }
+}
+
+static void _prefetch_done(pak_prefetch* pf, u32 i) {
+  pak_entry* e = &pf->entries[i];
+  file_view_advise(pf->view, e->offset, e->size, FILE_ADVICE_DONTNEED);
+  pf->queued -= pf->queued < (u64)e->size ? pf->queued : (u64)e->size;
+}
+
+static void _make_parent_dirs(cstr path) {
+  strcpy(DIR_BUF, path);
+  char* sl = strrchr(DIR_BUF, '/');
+  if (!sl)
+    return;
+  *sl = '\0';
+  makesure(fs_mkdir(NULL, DIR_BUF, 0) == FS_SUCCESS,
+           "failed to create directory '%s'", DIR_BUF);
+}
+
+/* ****************** Export Pipeline ****************** */
+
+// Pictures stay indexed, this stage only picks the row filters and builds
+// the PLTE/tRNS chunks from whichever palette draws the item
+static void _export_filter(void* ctx, u32 index, u32 worker) {
+  pak_export_job* job = (pak_export_job*)ctx;
+  void* it;
+  while (thread_queue_pop(&job->to_filter, &it)) {
+    pak_export_item* e = (pak_export_item*)it;
+    const palette* pal = e->own ? e->own : &job->pal;
+    png_prepare(&e->img, e->pixels, e->width, e->height, pal->rgba,
+                e->transparent ? PALETTE_TRANSPARENT : -1, job->o->level);
+    thread_queue_push(&job->to_encode, e);
+  }
+  thread_queue_done(&job->to_encode);
+}
+
+static void _export_encode(void* ctx, u32 index, u32 worker) {
+  pak_export_job* job = (pak_export_job*)ctx;
+  void* it;
+  while (thread_queue_pop(&job->to_encode, &it)) {
+    pak_export_item* e = (pak_export_item*)it;
+    e->png = png_encode(&e->img, &e->png_len);
+    thread_queue_push(&job->to_write, e);
+  }
+  thread_queue_done(&job->to_write);
+}
+
+// Single writer, so directory creation can keep using the shared DIR_BUF
+static void _export_write(void* ctx, u32 index, u32 worker) {
+  pak_export_job* job = (pak_export_job*)ctx;
+  void* it;
+  while (thread_queue_pop(&job->to_write, &it)) {
+    pak_export_item* e = (pak_export_item*)it;
+    _make_parent_dirs(e->path);
+
+    file_writer w;
+    file_writer_opts wo = {.flush_size = file_writer_flush_for(e->png_len),
+                           .prealloc = (u64)e->png_len,
+                           .direct = job->o->direct};
+    file_writer_open(e->path, &wo, &w);
+    file_writer_write(&w, e->png, e->png_len);
+    file_writer_close(&w);
+
+    free(e->png);
+    free(e->own);
+    free(e);
+    job->written++;
+  }
+}
+
+// Swaps the extension of a picture entry for .png, members of containers
+// go under the full entry name so they cannot collide with loose files
+static void _export_path(char* buf, cstr odir, const pak_entry* pe,
+                         const u8* member) {
+  i32 len = (i32)strnlen((cstr)pe->name, ENTRY_NAME_LEN);
+  sz n = sizeof(((pak_export_item*)0)->path);
+
+  if (member) {
+    char name[WAD_LUMP_NAME_LEN + 1] = {0};
+    memcpy(name, member, strnlen((cstr)member, WAD_LUMP_NAME_LEN));
+    for (char* c = name; *c; c++) {
+      if (*c == '/' || *c == '\\')
+        *c = '_';
+    }
+    snprintf(buf, n, "%s/%.*s/%s.png", odir, len, (cstr)pe->name, name);
+    return;
+  }
+
+  for (i32 i = len - 1; i > 0 && pe->name[i] != '/'; i--) {
+    if (pe->name[i] == '.') {
+      len = i;
+      break;
+    }
+  }
+  snprintf(buf, n, "%s/%.*s.png", odir, len, (cstr)pe->name);
+}
+
+static void _export_push(pak_export_job* job, pak_export_item* e,
+                         file_view* v) {
+  // the filter stage will touch these pages soon, start reading them now
+  if (e->pixels >= v->data && e->pixels < v->data + v->size)
+    file_view_advise(v, (u64)(e->pixels - v->data),
+                     (u64)e->width * e->height, FILE_ADVICE_WILLNEED);
+  job->read++;
+  thread_queue_push(&job->to_filter, e);
+}
+
+static pak_export_item* _export_item(const u8* pixels, u32 w, u32 h,
+                                     bool transparent) {
+  pak_export_item* e = (pak_export_item*)calloc(1, sizeof(*e));
+  makesure(e != NULL, "malloc failed");
+  e->pixels = pixels;
+  e->width = w;
+  e->height = h;
+  e->transparent = transparent;
+  return e;
+}
+
+static pak_export_item* _export_swatch(pak_export_job* job, const u8* rgb) {
+  pak_export_item* e = _export_item(job->swatch, 16, 16, false);
+  e->own = (palette*)malloc(sizeof(palette));
+  makesure(e->own != NULL, "malloc failed");
+  palette_from_rgb(e->own, rgb);
+  return e;
+}
+
+// Miptex level 0 out of a bounded buffer, NULL if it does not add up
+static pak_export_item* _export_miptex(const u8* data, sz size) {
+  if (size < WAD_MIPTEX_LEN)
+    return NULL;
+  wad_miptex mt;
+  memcpy(&mt, data, sizeof(mt));
+  endian_i32_fields(&mt, 1, sizeof(mt), offsetof(wad_miptex, width), 6);
+  if (!mt.width || !mt.height || mt.width > LMP_MAX_SIDE ||
+      mt.height > LMP_MAX_SIDE ||
+      (sz)mt.offsets[0] + (sz)mt.width * mt.height > size)
+    return NULL;
+  return _export_item(data + mt.offsets[0], mt.width, mt.height,
+                      mt.name[0] == '{');
+}
+
+static void _export_lmp(pak_export_job* job, file_view* v, pak_entry* pe,
+                        cstr odir) {
+  // a full 56 byte name has no terminator on disk
+  char name[ENTRY_NAME_LEN + 1] = {0};
+  memcpy(name, pe->name, ENTRY_NAME_LEN);
+
+  lmp l;
+  lmp_parse(v->data + pe->offset, pe->size, name, &l);
+
+  pak_export_item* e = NULL;
+  if (l.kind == LMP_KIND_QPIC || l.kind == LMP_KIND_COLORMAP)
+    e = _export_item(l.pixels, l.width, l.height, l.kind == LMP_KIND_QPIC);
+  else if (l.kind == LMP_KIND_PALETTE)
+    e = _export_swatch(job, l.pixels);
+
+  if (!e)
+    return;
+  _export_path(e->path, odir, pe, NULL);
+  _export_push(job, e, v);
+}
+
+static void _export_wad(pak_export_job* job, file_view* v, pak_entry* pe,
+                        cstr odir) {
+  const u8* data = v->data + pe->offset;
+  if (pe->size < (i32)WAD_HEADER_LEN ||
+      memcmp(data, WAD_MAGIC_CODE, WAD_MAGIC_CODE_LEN))
+    return;
+
+  // the directory only lives while items are queued, their pixels and
+  // paths never point into it
+  arena m = {0};
+  wad w = {0};
+  wad_open_mem(&m, data, pe->size, &w);
+  for (u32 i = 0; i < w.lumps_count; i++) {
+    wad_lump* l = &w.lumps[i];
+    const u8* ld = data + l->offset;
+    pak_export_item* e = NULL;
+
+    if (l->compression)
+      continue;
+    if (l->type == WAD_TYPE_MIPTEX) {
+      e = _export_miptex(ld, l->disk_size);
+    } else if (l->type == WAD_TYPE_QPIC) {
+      lmp q;
+      if (lmp_parse(ld, l->disk_size, NULL, &q) == LMP_KIND_QPIC)
+        e = _export_item(q.pixels, q.width, q.height, true);
+    } else if (l->type == WAD_TYPE_PALETTE &&
+               l->disk_size >= (i32)PALETTE_LEN) {
+      e = _export_swatch(job, ld);
+    }
+
+    if (!e)
+      continue;
+    _export_path(e->path, odir, pe, l->name);
+    _export_push(job, e, v);
+  }
+  wad_close(&w);
+  arena_destroy(&m);
+}
+
+// BSP29 keeps its wall textures as a miptex table in lump 2
+static void _export_bsp(pak_export_job* job, file_view* v, pak_entry* pe,
+                        cstr odir) {
+  const u8* data = v->data + pe->offset;
+  sz size = pe->size;
+  if (size < 4 + BSP_LUMPS * 8)
+    return;
+
+  i32 hdr[1 + BSP_LUMPS * 2];
+  memcpy(hdr, data, sizeof(hdr));
+  endian_i32_array(hdr, hdr, 1 + BSP_LUMPS * 2);
+  if (hdr[0] != BSP_VERSION)
+    return;
+
+  i32 tof = hdr[1 + BSP_LUMP_TEXTURES * 2];
+  i32 tlen = hdr[2 + BSP_LUMP_TEXTURES * 2];
+  if (tof < 0 || tlen < 4 || (sz)tof + (sz)tlen > size)
+    return;
+
+  const u8* tex = data + tof;
+  i32 count;
+  memcpy(&count, tex, 4);
+  count = endian_i32(count);
+  if (count < 0 || 4 + (sz)count * 4 > (sz)tlen)
+    return;
+
+  for (i32 i = 0; i < count; i++) {
+    i32 of;
+    memcpy(&of, tex + 4 + i * 4, 4);
+    of = endian_i32(of);
+    if (of < 0 || of >= tlen)
+      continue;  // -1 marks a texture the compiler could not find
+
+    pak_export_item* e = _export_miptex(tex + of, (sz)(tlen - of));
+    if (!e)
+      continue;
+    _export_path(e->path, odir, pe, tex + of);
+    _export_push(job, e, v);
+  }
+}
+
+static bool _export_ext(pak_entry* pe, cstr ext) {
+  sz len = strnlen((cstr)pe->name, ENTRY_NAME_LEN);
+  sz el = strlen(ext);
+  return len > el && !strncasecmp((cstr)pe->name + len - el, ext, el);
+}
+
+static void _export_palette(pak_export_job* job, file_view* v, pak* p, u32 fc,
+                            const pak_opts* o) {
+  if (o->palette) {
+    palette_load(&job->pal, o->palette);
+    return;
+  }
+  for (u32 i = 0; i < fc; i++) {
+    pak_entry* e = &p->entries[i];
+    if (!strncasecmp((cstr)e->name, "gfx/palette.lmp", ENTRY_NAME_LEN) &&
+        e->size >= (i32)PALETTE_LEN) {
+      palette_from_rgb(&job->pal, v->data + e->offset);
+      return;
+    }
+  }
+  makesure(false, "the pak has no gfx/palette.lmp, pass one with --palette");
+}
+
+/* ****************** Convert Pipeline ****************** */
+
+// Media that is compressed already, deflating it again only burns time
+static bool _convert_stored_ext(const pk3_entry* e) {
+  static const char* exts[] = {".ogg", ".mp3", ".flac", ".opus",
+                               ".png", ".jpg", ".jpeg", ".webp",
+                               ".pk3", ".zip", ".gz",   ".7z"};
+  for (u32 i = 0; i < sizeof(exts) / sizeof(*exts); i++) {
+    sz el = strlen(exts[i]);
+    if (e->name_len > el &&
+        !strncasecmp((cstr)e->name + e->name_len - el, exts[i], el))
+      return true;
+  }
+  return false;
+}
+
+// Keeps the deflated copy only when it is actually smaller
+static void _convert_deflate(pak_convert_job* job, pak_convert_item* it) {
+  pk3_entry* e = &it->e;
+  e->crc = png_crc32(0, it->src, e->usize);
+  e->method = PK3_METHOD_STORE;
+  e->csize = e->usize;
+  it->out = it->src;
+  if (job->o->level == 0 || e->usize == 0 || _convert_stored_ext(e))
+    return;
+
+  // stb wraps the raw stream in a 2 byte zlib header and an adler32 trailer
+  int zl = 0;
+  u8* z = stbi_zlib_compress((u8*)it->src, (int)e->usize, &zl,
+                             (int)job->o->level * 4);
+  makesure(z != NULL, "deflate failed");
+  if (zl > 6 && (u64)zl - 6 < e->usize) {
+    it->block = z;
+    it->out = z + 2;
+    e->csize = (u64)zl - 6;
+    e->method = PK3_METHOD_DEFLATE;
+  } else {
+    free(z);
+  }
+}
+
+static void _convert_inflate(pak_convert_job* job, pak_convert_item* it) {
+  const pk3_entry* e = &it->e;
+  if (e->method == PK3_METHOD_DEFLATE) {
+    it->block = (u8*)malloc(e->usize ? e->usize : 1);
+    makesure(it->block != NULL, "malloc failed");
+  }
+  it->out = it->block ? it->block : it->src;
+
+  // the bytes are still written so the layout holds, the output is thrown
+  // away once the run is over
+  if (!pk3_read(job->zip, e, it->block)) {
+    log_warn("entry '%.*s' is corrupt", (int)e->name_len, e->name);
+    job->failed++;
+  }
+}
+
+static void _convert_work(void* ctx, u32 index, u32 worker) {
+  pak_convert_job* job = (pak_convert_job*)ctx;
+  void* p;
+  while (thread_queue_pop(&job->to_work, &p)) {
+    pak_convert_item* it = (pak_convert_item*)p;
+    if (job->to_pk3)
+      _convert_deflate(job, it);
+    else
+      _convert_inflate(job, it);
+    thread_queue_push(&job->to_write, it);
+  }
+  thread_queue_done(&job->to_write);
+}
+
+static void _convert_write_item(pak_convert_job* job, u32 i) {
+  pak_convert_item* it = &job->items[i];
+  u64 at = file_writer_tell(&job->w);
+
+  if (job->to_pk3) {
+    makesure(at + PK3_LOCAL_LEN + it->e.name_len + it->e.csize <= UINT32_MAX,
+             "the pk3 would need zip64, which is not supported");
+    u8 lh[PK3_LOCAL_LEN + ENTRY_NAME_LEN];
+    it->e.header = at;
+    file_writer_write(&job->w, lh, pk3_put_local(lh, &it->e));
+    file_writer_write(&job->w, it->out, it->e.csize);
+  } else {
+    pak_entry* pe = &job->dir[i];
+    memcpy(pe->name, it->e.name, it->e.name_len);
+    pe->offset = endian_i32((i32)at);
+    pe->size = endian_i32((i32)it->e.usize);
+    file_writer_write(&job->w, it->out, it->e.usize);
+  }
+
+  free(it->block);
+  it->block = NULL;
+  it->out = NULL;
+}
+
+// Items arrive in whatever order the workers finish, each one is parked
+// until everything before it has been written
+static void _convert_write(void* ctx, u32 index, u32 worker) {
+  pak_convert_job* job = (pak_convert_job*)ctx;
+  u32 next = 0;
+  void* p;
+  while (thread_queue_pop(&job->to_write, &p)) {
+    ((pak_convert_item*)p)->ready = true;
+    for (; next < job->count && job->items[next].ready; next++) {
+      _convert_write_item(job, next);
+      thread_queue_push(&job->credits, job);
+    }
+  }
+}
+
+static void _convert_run(pak_convert_job* job, file_view* v) {
+  u32 workers = thread_count() > 1 ? thread_count() - 1 : 1;
+  thread_queue_init(&job->to_work, job->slots[0], CONVERT_WINDOW, 1);
+  thread_queue_init(&job->to_write, job->slots[1], CONVERT_WINDOW, workers);
+  thread_queue_init(&job->credits, job->slots[2], CONVERT_WINDOW, 1);
+  for (u32 i = 0; i < CONVERT_WINDOW; i++)
+    thread_queue_push(&job->credits, job);
+
+  thread_handle stages[THREAD_MAX_WORKERS + 1];
+  u32 ns = 0;
+  for (u32 i = 0; i < workers; i++)
+    thread_spawn(&stages[ns++], _convert_work, job, i);
+  thread_spawn(&stages[ns++], _convert_write, job, workers);
+
+  void* credit;
+  for (u32 i = 0; i < job->count; i++) {
+    pak_convert_item* it = &job->items[i];
+    thread_queue_pop(&job->credits, &credit);
+    if (it->src >= v->data && it->src < v->data + v->size)
+      file_view_advise(v, (u64)(it->src - v->data),
+                       job->to_pk3 ? it->e.usize : it->e.csize,
+                       FILE_ADVICE_WILLNEED);
+    thread_queue_push(&job->to_work, it);
+  }
+  thread_queue_done(&job->to_work);
+
+  for (u32 i = 0; i < ns; i++)
+    thread_join(&stages[i]);
+  thread_queue_destroy(&job->to_work);
+  thread_queue_destroy(&job->to_write);
+  thread_queue_destroy(&job->credits);
+}
+
+// Local headers and data stream out in directory order, the central
+// directory follows once every offset is known
+static void _convert_to_pk3(pak_convert_job* job, file_view* v, pak* p,
+                            cstr opath) {
+  makesure(job->count <= PK3_MAX_ENTRIES,
+           "the pk3 would need zip64, which is not supported");
+  for (u32 i = 0; i < job->count; i++) {
+    pak_entry* pe = &p->entries[i];
+    makesure(pe->offset >= 0 && (sz)pe->offset + pe->size <= v->size,
+             "entry '%.56s' is out of bounds", pe->name);
+    pak_convert_item* it = &job->items[i];
+    it->src = v->data + pe->offset;
+    it->e = (pk3_entry){
+        .name = pe->name,
+        .name_len = (u32)strnlen((cstr)pe->name, ENTRY_NAME_LEN),
+        .usize = (u64)pe->size};
+  }
+
+  job->to_pk3 = true;
+  file_writer_open(opath, &(file_writer_opts){.direct = job->o->direct},
+                   &job->w);
+  _convert_run(job, v);
+
+  u64 cdir = file_writer_tell(&job->w);
+  u8 rec[PK3_CDIR_LEN + ENTRY_NAME_LEN];
+  for (u32 i = 0; i < job->count; i++)
+    file_writer_write(&job->w, rec, pk3_put_cdir(rec, &job->items[i].e));
+  u64 end = file_writer_tell(&job->w);
+  makesure(end <= UINT32_MAX, "the pk3 would need zip64, which is not "
+                              "supported");
+  file_writer_write(&job->w, rec, pk3_put_eocd(rec, job->count, end - cdir,
+                                               cdir));
+  file_writer_close(&job->w);
+}
+
+// Every size is known from the central directory, so the header and the
+// final file size are written before any entry is inflated. Entries that
+// cannot be decoded are skipped like pk3 extract does, broken ones fail the
+// run before the output is opened
+static void _convert_to_pak(pak_convert_job* job, cstr opath) {
+  pk3* z = job->zip;
+  u64 of = HEADER_LEN;
+  u32 n = 0;
+  for (u32 i = 0; i < z->entries_count; i++) {
+    pk3_entry* e = &z->entries[i];
+    if (e->name_len && e->name[e->name_len - 1] == '/')
+      continue;
+    if (!pk3_supported(e)) {
+      log_warn("skipping '%.*s', %s entries are not supported",
+               (int)e->name_len, e->name,
+               e->flags & PK3_FLAG_ENCRYPTED ? "encrypted" : "compressed");
+      continue;
+    }
+    if (e->name_len >= ENTRY_NAME_LEN) {
+      log_error("'%.*s' is longer than the '%u' characters a pak entry can "
+                "hold",
+                (int)e->name_len, e->name, ENTRY_NAME_LEN - 1);
+      job->failed++;
+      continue;
+    }
+
+    const u8* src = pk3_entry_data(z, e);
+    if (!src) {
+      log_error("entry '%.*s' is corrupt", (int)e->name_len, e->name);
+      job->failed++;
+      continue;
+    }
+
+    job->items[n++] = (pak_convert_item){.e = *e, .src = src};
+    of += e->usize;
+    makesure(of <= INT32_MAX, "the pak would be larger than 2GB");
+  }
+  job->count = n;
+  if (job->failed)
+    return;
+
+  job->dir = (pak_entry*)calloc(job->count ? job->count : 1, ENTRY_LEN);
+  makesure(job->dir != NULL, "malloc failed");
+
+  file_writer_opts wo = {.prealloc = of + (u64)job->count * ENTRY_LEN,
+                         .direct = job->o->direct};
+  file_writer_open(opath, &wo, &job->w);
+  pak_header* hp = (pak_header*)HEADER_BUF;
+  memcpy(hp->magic_code, MAGIC_CODE, MAGIC_CODE_LEN);
+  hp->offset = endian_i32((i32)of);
+  hp->size = endian_i32((i32)(job->count * ENTRY_LEN));
+  file_writer_write(&job->w, HEADER_BUF, HEADER_LEN);
+
+  _convert_run(job, &z->view);
+
+  file_writer_write(&job->w, job->dir, (sz)job->count * ENTRY_LEN);
+  file_writer_close(&job->w);
+  free(job->dir);
+}
+
+/* ****************** Name Index ****************** */
+
+// Open addressing table over the entry names, a slot holds entry index + 1.
+// When two entries share a name the first or, with 'last', the final one of
+// them is kept
+static u32* _names_index(const pak* p, u32 fc, bool last, u32* mask) {
+  u32 n = 16;
+  while (n < fc * 2)
+    n <<= 1;
+  u32* index = (u32*)calloc(n, sizeof(u32));
+  makesure(index != NULL, "malloc failed");
+  *mask = n - 1;
+
+  for (u32 i = 0; i < fc; i++) {
+    cstr name = (cstr)p->entries[i].name;
+    sz len = strnlen(name, ENTRY_NAME_LEN);
+    for (u32 at = (u32)hash_bytes(name, len) & *mask;; at = (at + 1) & *mask) {
+      u32 slot = index[at];
+      cstr other = slot ? (cstr)p->entries[slot - 1].name : NULL;
+      if (!slot || (last && !strncmp(other, name, ENTRY_NAME_LEN))) {
+        index[at] = i + 1;
+        break;
+      }
+      if (!strncmp(other, name, ENTRY_NAME_LEN))
+        break;
+    }
+  }
+  return index;
+}
+
+static i32 _names_find(const pak* p, const u32* index, u32 mask, cstr name,
+                       sz len) {
+  for (u32 at = (u32)hash_bytes(name, len) & mask;; at = (at + 1) & mask) {
+    u32 slot = index[at];
+    if (!slot)
+      return -1;
+    cstr other = (cstr)p->entries[slot - 1].name;
+    if (strnlen(other, ENTRY_NAME_LEN) == len && !memcmp(other, name, len))
+      return (i32)(slot - 1);
+  }
+}
+
+/* ****************** Incremental Extract ****************** */
+
+// The manifest sits next to the output directory so it never shows up in,
+// or gets pruned from, the extracted tree
+static void _update_manifest_path(cstr odir, char* out) {
+  sz n = strlen(odir);
+  while (n > 1 && odir[n - 1] == '/')
+    n--;
+  sprintf(out, "%.*s%s", (int)n, odir, MANIFEST_EXT);
+}
+
+// Deletes a file an earlier run wrote that the pak no longer holds, then the
+// directories it leaves empty. Only a regular file goes and only when every
+// directory on the way is a real one, a symlink is never followed out of the
+// output and nothing sqt did not write is touched
+static bool _update_prune(cstr root, cstr name) {
+  char path[MAX_PATH_LEN + ENTRY_NAME_LEN];
+  sz rl = (sz)snprintf(path, sizeof(path), "%s/", root);
+  if (rl >= MAX_PATH_LEN)
+    return false;
+
+  struct stat st;
+  for (cstr at = name;;) {
+    cstr sl = strchr(at, '/');
+    sz n = sl ? (sz)(sl - at) : strlen(at);
+    if (!n || (at[0] == '.' && (n == 1 || (n == 2 && at[1] == '.'))))
+      return false;
+    snprintf(path + rl, sizeof(path) - rl, "%.*s", (int)(at - name + n),
+             name);
+    if (lstat(path, &st) != 0)
+      return false;
+    if (!sl)
+      break;
+    if (!S_ISDIR(st.st_mode))
+      return false;
+    at = sl + 1;
+  }
+  if (!S_ISREG(st.st_mode))
+    return false;
+  makesure(remove(path) == 0, "failed to remove '%s'", path);
+
+  // rmdir fails, harmlessly, on the first parent that still holds anything
+  for (char* sl = strrchr(path + rl, '/'); sl; sl = strrchr(path + rl, '/')) {
+    *sl = '\0';
+    if (rmdir(path) != 0)
+      break;
+  }
+  return true;
+}
+
+// One "hash size mtime name" line per entry under the header; a missing or
+// unreadable manifest leaves every row unknown, which only costs comparing
+// the files on disk. A name the pak no longer holds was written by the last
+// run and is pruned from 'odir' when given; without a manifest nothing is
+static void _update_load(pak_update* u, const pak* p, cstr mpath,
+                         cstr odir) {
+  fs_file_info fi;
+  if (fs_info(NULL, mpath, FS_READ, &fi) != FS_SUCCESS || fi.directory)
+    return;
+
+  file_view v;
+  file_view_open(mpath, &v);
+  cstr text = (cstr)v.data;
+  char line[MAX_PATH_LEN];
+  bool head = true;
+  for (sz at = 0; at < v.size;) {
+    sz b = at;
+    while (b < v.size && text[b] != '\n')
+      b++;
+    sz n = b - at < sizeof(line) - 1 ? b - at : sizeof(line) - 1;
+    memcpy(line, text + at, n);
+    line[n] = '\0';
+    at = b + 1;
+
+    if (head) {
+      long long since = 0;
+      if (sscanf(line, MANIFEST_HEADER, &since) != 1)
+        break;
+      u->since = since;
+      head = false;
+      continue;
+    }
+
+    unsigned long long hash = 0;
+    long long size = 0;
+    long long mtime = 0;
+    int name = 0;
+    if (sscanf(line, "%llx %lld %lld %n", &hash, &size, &mtime, &name) != 3 ||
+        !name)
+      continue;
+    i32 i = _names_find(p, u->index, u->mask, line + name,
+                        strlen(line + name));
+    if (i >= 0)
+      u->rows[i] = (pak_manifest_row){hash, size, mtime, true};
+    else if (odir && _update_prune(odir, line + name))
+      u->removed++;
+  }
+  file_view_close(&v);
+}
+
+static void _update_save(pak_update* u, const pak* p, u32 fc, cstr mpath) {
+  char tmp[MAX_PATH_LEN + 32];
+  char line[MAX_PATH_LEN];
+  sprintf(tmp, "%s.tmp", mpath);
+
+  file_writer w;
+  file_writer_open(tmp, NULL, &w);
+  sz n = (sz)snprintf(line, sizeof(line), MANIFEST_HEADER,
+                      (long long)time(NULL));
+  file_writer_write(&w, line, n);
+  for (u32 i = 0; i < fc; i++) {
+    pak_manifest_row* r = &u->rows[i];
+    if (!r->known)
+      continue;
+    n = (sz)snprintf(line, sizeof(line), "%016llx %lld %lld %.*s\n",
+                     (unsigned long long)r->hash, (long long)r->size,
+                     (long long)r->mtime, (int)ENTRY_NAME_LEN,
+                     (cstr)p->entries[i].name);
+    file_writer_write(&w, line, n);
+  }
+  file_writer_close(&w);
+
+  // swapped in whole, an interrupted run keeps the previous manifest
+  makesure(rename(tmp, mpath) == 0,
+           "failed to write the manifest '%s'", mpath);
+}
+
+// True when the file at 'path' already holds the entry. A stat settles it
+// while size and mtime still match what the manifest recorded and that mtime
+// predates the manifest, a file touched within the same second is never
+// trusted. Anything else is compared byte for byte, a read instead of a write
+static bool _update_fresh(pak_update* u, u32 i, cstr path, const u8* data,
+                          sz len, u64 hash) {
+  fs_file_info fi;
+  if (fs_info(NULL, path, FS_READ, &fi) != FS_SUCCESS)
+    return false;
+  makesure(!fi.directory, "'%s' is a directory but a file in the pak", path);
+  if ((sz)fi.size != len)
+    return false;
+
+  pak_manifest_row* r = &u->rows[i];
+  if (r->known && r->hash == hash && r->size == (i64)len &&
+      r->mtime == (i64)fi.lastModifiedTime && r->mtime < u->since)
+    return true;
+
+  file_view v;
+  file_view_open(path, &v);
+  bool same = v.size == len && (!len || !memcmp(v.data, data, len));
+  file_view_close(&v);
+  return same;
+}
+
+static void _update_record(pak_update* u, u32 i, cstr path, sz len,
+                           u64 hash) {
+  fs_file_info fi;
+  makesure(fs_info(NULL, path, FS_READ, &fi) == FS_SUCCESS,
+           "failed to stat '%s'", path);
+  u->rows[i] = (pak_manifest_row){hash, (i64)len, (i64)fi.lastModifiedTime,
+                                  true};
+}
+
+/* ****************** Grep ****************** */
+
+// Next occurrence of 'pat' starting in [p, end - n], or NULL. The vector
+// loops test the first and the last pattern byte at a whole register of
+// candidate starts at once and only confirm the survivors with memcmp, the
+// tail falls back to memchr on the first byte
+static const u8* _grep_find(const u8* p, const u8* end, const u8* pat,
+                            sz n) {
+  if ((sz)(end - p) < n)
+    return NULL;
+  const u8* last = end - n;
+
+#if defined(__AVX2__)
+  const __m256i first = _mm256_set1_epi8((char)pat[0]);
+  const __m256i final = _mm256_set1_epi8((char)pat[n - 1]);
+  for (; last - p >= 31; p += 32) {
+    __m256i a = _mm256_loadu_si256((const __m256i*)p);
+    __m256i b = _mm256_loadu_si256((const __m256i*)(p + n - 1));
+    u32 mask = (u32)_mm256_movemask_epi8(_mm256_and_si256(
+        _mm256_cmpeq_epi8(a, first), _mm256_cmpeq_epi8(b, final)));
+    for (; mask; mask &= mask - 1) {
+      const u8* at = p + __builtin_ctz(mask);
+      if (!memcmp(at, pat, n))
+        return at;
+    }
+  }
+#elif defined(__SSE2__)
+  const __m128i first = _mm_set1_epi8((char)pat[0]);
+  const __m128i final = _mm_set1_epi8((char)pat[n - 1]);
+  for (; last - p >= 15; p += 16) {
+    __m128i a = _mm_loadu_si128((const __m128i*)p);
+    __m128i b = _mm_loadu_si128((const __m128i*)(p + n - 1));
+    u32 mask = (u32)_mm_movemask_epi8(
+        _mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, final)));
+    for (; mask; mask &= mask - 1) {
+      const u8* at = p + __builtin_ctz(mask);
+      if (!memcmp(at, pat, n))
+        return at;
+    }
+  }
+#elif defined(__ARM_NEON)
+  const uint8x16_t first = vdupq_n_u8(pat[0]);
+  const uint8x16_t final = vdupq_n_u8(pat[n - 1]);
+  for (; last - p >= 15; p += 16) {
+    uint8x16_t eq = vandq_u8(vceqq_u8(vld1q_u8(p), first),
+                             vceqq_u8(vld1q_u8(p + n - 1), final));
+    // no movemask on NEON, narrowing leaves four bits per byte instead
+    u64 mask = vget_lane_u64(
+        vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(eq), 4)), 0);
+    while (mask) {
+      u32 bit = (u32)__builtin_ctzll(mask) & ~3u;
+      if (!memcmp(p + bit / 4, pat, n))
+        return p + bit / 4;
+      mask &= ~((u64)0xF << bit);
+    }
+  }
+#endif
+
+  while (p <= last) {
+    p = (const u8*)memchr(p, pat[0], (sz)(last - p) + 1);
+    if (!p)
+      return NULL;
+    if (!memcmp(p, pat, n))
+      return p;
+    p++;
+  }
+  return NULL;
+}
+
+static void _grep_scan(void* ctx, u32 index, u32 worker) {
+  pak_grep_job* job = (pak_grep_job*)ctx;
+  pak_grep_item* it = &job->items[index];
+  pak_entry* e = &job->paks[it->pak].entries[it->entry];
+  const u8* data = job->views[it->pak % GREP_OPEN_PAKS].data + e->offset;
+
+  // the slice reads on into the next one so matches straddling it are seen
+  u64 stop = it->to + job->len - 1;
+  const u8* end = data + (stop < (u64)e->size ? stop : (u64)e->size);
+  for (const u8* p = data + it->from;
+       (p = _grep_find(p, end, job->pat, job->len)); p++) {
+    if ((u64)(p - data) >= it->to)
+      break;
+    if (it->hits_count == it->hits_cap) {
+      it->hits_cap = it->hits_cap ? it->hits_cap * 2 : 16;
+      it->hits = (u64*)realloc(it->hits, it->hits_cap * sizeof(u64));
+      makesure(it->hits != NULL, "malloc failed");
+    }
+    it->hits[it->hits_count++] = (u64)(p - data);
+  }
+}
+
+/* ****************** Data Layout ****************** */
+
+// Data order for the entries: every name of the trace the pak holds, in the
+// order the engine first opened it, then the rest in directory order. The
+// trace is one entry name per line, blank lines and '#' comments are skipped
+// and names the pak does not have are ignored. Returns how many entries the
+// trace placed
+static u32 _layout_order(pak* p, u32 fc, cstr trace, u32* order) {
+  bool* placed = (bool*)calloc(fc ? fc : 1, sizeof(bool));
+  makesure(placed != NULL, "malloc failed");
+  u32 n = 0;
+
+  if (trace) {
+    // the first of two entries with one name is the one the engine opens
+    u32 mask;
+    u32* index = _names_index(p, fc, false, &mask);
+
+    file_view t;
+    file_view_open(trace, &t);
+    cstr text = (cstr)t.data;
+    for (sz at = 0; at < t.size;) {
+      sz a = at;
+      sz b = at;
+      while (b < t.size && text[b] != '\n')
+        b++;
+      at = b + 1;
+
+      while (a < b && isspace((u8)text[a]))
+        a++;
+      while (b > a && isspace((u8)text[b - 1]))
+        b--;
+      if (a == b || text[a] == '#' || b - a >= ENTRY_NAME_LEN)
+        continue;
+
+      i32 i = _names_find(p, index, mask, text + a, b - a);
+      if (i < 0 || placed[i])
+        continue;
+      placed[i] = true;
+      order[n++] = (u32)i;
+    }
+    file_view_close(&t);
+    free(index);
+  }
+
+  u32 traced = n;
+  for (u32 i = 0; i < fc; i++) {
+    if (!placed[i])
+      order[n++] = i;
+  }
+  free(placed);
+  return traced;
+}
+
+static int _layout_offset_cmp(const void* a, const void* b) {
+  i32 x = ((const pak_entry*)a)->offset;
+  i32 y = ((const pak_entry*)b)->offset;
+  return (x > y) - (x < y);
+}
+
+// Alignment the options ask for, 1 when entries are packed tightly
+static int _layout_key_cmp(const void* a, const void* b) {
+  u64 x = *(const u64*)a;
+  u64 y = *(const u64*)b;
+  return (x > y) - (x < y);
+}
+
+// Entries the trace did not place keep the order their data already has, so
+// compacting a laid out pak without a trace leaves its layout alone. Offsets
+// must not be negative
+static void _layout_keep_order(const pak* p, u32* order, u32 from, u32 fc) {
+  u32 n = fc - from;
+  u64* keys = (u64*)malloc((n ? n : 1) * sizeof(u64));
+  makesure(keys != NULL, "malloc failed");
+  for (u32 k = 0; k < n; k++) {
+    u32 i = order[from + k];
+    keys[k] = (u64)(u32)p->entries[i].offset << 32 | i;
+  }
+  qsort(keys, n, sizeof(u64), _layout_key_cmp);
+  for (u32 k = 0; k < n; k++)
+    order[from + k] = (u32)keys[k];
+  free(keys);
+}
+
+static u32 _layout_align(const pak_opts* o) {
+  u32 a = o && o->align ? o->align : 1;
+  makesure((a & (a - 1)) == 0 && a <= ALIGN_MAX,
+           "alignment '%u' is not a power of two up to '%u'", a, ALIGN_MAX);
+  return a;
+}
+
+static i64 _layout_align_up(i64 of, u32 align) {
+  return (of + align - 1) & ~(i64)(align - 1);
+}
+
+// Zero fills the output up to 'offset', where the next entry starts
+static void _layout_pad(file_writer* w, u64 offset) {
+  for (u64 at = file_writer_tell(w); at < offset;) {
+    u64 n = offset - at < ALIGN_PAD_LEN ? offset - at : ALIGN_PAD_LEN;
+    file_writer_write(w, PAD_BUF, n);
+    at += n;
+  }
+}
+
+// Bytes of the file no entry, header or directory covers, overlapping entries
+// are counted once. 'align' gets the largest power of two, up to ALIGN_MAX,
+// every non-empty entry offset is a multiple of
+static sz _layout_padding(const pak* p, u32 fc, sz size, u32* align) {
+  pak_entry* sorted = (pak_entry*)malloc((fc ? fc : 1) * sizeof(pak_entry));
+  makesure(sorted != NULL, "malloc failed");
+  memcpy(sorted, p->entries, fc * sizeof(pak_entry));
+  qsort(sorted, fc, sizeof(pak_entry), _layout_offset_cmp);
+
+  u32 a = ALIGN_MAX;
+  sz covered = HEADER_LEN + (sz)p->header.size;
+  i64 end = HEADER_LEN;
+  for (u32 i = 0; i < fc; i++) {
+    pak_entry* e = &sorted[i];
+    if (e->size <= 0)
+      continue;
+    while (e->offset & (a - 1))
+      a >>= 1;
+    i64 from = e->offset > end ? e->offset : end;
+    i64 to = (i64)e->offset + e->size;
+    if (to > from) {
+      covered += to - from;
+      end = to;
+    }
+  }
+  free(sorted);
+
+  *align = a;
+  return size > covered ? size - covered : 0;
+}
+
+// Walks 'root' recursively in name order; only counts files while p is NULL,
+// otherwise fills p->entries with names relative to 'root' and their sizes
+static void _collect(cstr root, cstr rel, pak* p, u32* n) {
+  char dir[MAX_PATH_LEN + ENTRY_NAME_LEN];
+  snprintf(dir, sizeof(dir), rel[0] ? "%s/%s" : "%s", root, rel);
+
+  fs_iterator* it = fs_first(NULL, dir, FS_READ);
+  for (; it; it = fs_next(it)) {
+    char sub[MAX_PATH_LEN];
+    snprintf(sub, sizeof(sub), rel[0] ? "%s/%s" : "%s%s", rel, it->pName);
+
+    if (it->info.directory) {
+      _collect(root, sub, p, n);
+      continue;
+    }
+
+    makesure(strlen(sub) < ENTRY_NAME_LEN,
+             "'%s' is longer than the '%u' characters a pak entry can hold",
+             sub, ENTRY_NAME_LEN - 1);
+    makesure(it->info.size <= INT32_MAX, "'%s' is too large for a pak", sub);
+
+    if (p) {
+      memcpy(p->entries[*n].name, sub, strlen(sub));
+      p->entries[*n].size = (i32)it->info.size;
+    }
+    (*n)++;
+  }
+}
+
+/* ****************** Watch ****************** */
+
+#if defined(__linux__)
+
+static void _watch_grow(void** items, u32* cap, u32 count, sz item) {
+  if (count < *cap)
+    return;
+  *cap = *cap ? *cap * 2 : 64;
+  *items = realloc(*items, *cap * item);
+  makesure(*items != NULL, "malloc failed");
+}
+
+static void _watch_changed(pak_watcher* w, cstr rel) {
+  _watch_grow((void**)&w->changed, &w->changed_cap, w->changed_count,
+              sizeof(char*));
+  w->changed[w->changed_count] = strdup(rel);
+  makesure(w->changed[w->changed_count] != NULL, "malloc failed");
+  w->changed_count++;
+}
+
+// Watches 'rel' and everything below it. A directory that appeared while
+// running may already hold files, 'scan' queues those as changed
+static void _watch_add(pak_watcher* w, cstr rel, bool scan) {
+  char dir[MAX_PATH_LEN + ENTRY_NAME_LEN];
+  snprintf(dir, sizeof(dir), rel[0] ? "%s/%s" : "%s", w->dir, rel);
+
+  u32 mask = IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_CREATE |
+             IN_DELETE | IN_ONLYDIR;
+  int wd = inotify_add_watch(w->notify, dir, mask);
+  if (wd < 0)
+    return;  // gone again before it could be watched
+
+  pak_watch_dir* d = NULL;
+  for (u32 i = 0; i < w->dirs_count && !d; i++) {
+    if (w->dirs[i].wd == wd)
+      d = &w->dirs[i];
+  }
+  if (!d) {
+    _watch_grow((void**)&w->dirs, &w->dirs_cap, w->dirs_count,
+                sizeof(pak_watch_dir));
+    d = &w->dirs[w->dirs_count++];
+  } else {
+    free(d->rel);
+  }
+  d->wd = wd;
+  d->rel = strdup(rel);
+  makesure(d->rel != NULL, "malloc failed");
+
+  fs_iterator* it = fs_first(NULL, dir, FS_READ);
+  for (; it; it = fs_next(it)) {
+    char sub[MAX_PATH_LEN];
+    snprintf(sub, sizeof(sub), rel[0] ? "%s/%s" : "%s%s", rel, it->pName);
+    if (it->info.directory)
+      _watch_add(w, sub, scan);
+    else if (scan)
+      _watch_changed(w, sub);
+  }
+}
+
+// Drains the inotify queue into the changed list. Files count once written
+// and closed or moved, a bare IN_CREATE would catch them half written
+static void _watch_read(pak_watcher* w) {
+  alignas(struct inotify_event) char buf[16 * 1024];
+  for (;;) {
+    ssize_t n = read(w->notify, buf, sizeof(buf));
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return;
+
+    for (char* at = buf; at < buf + n;) {
+      struct inotify_event* ev = (struct inotify_event*)at;
+      at += sizeof(struct inotify_event) + ev->len;
+
+      if (ev->mask & IN_Q_OVERFLOW) {
+        w->rescan = true;
+        continue;
+      }
+      pak_watch_dir* d = NULL;
+      for (u32 i = 0; i < w->dirs_count && !d; i++) {
+        if (w->dirs[i].wd == ev->wd)
+          d = &w->dirs[i];
+      }
+      if (!d)
+        continue;
+      if (ev->mask & IN_IGNORED) {
+        d->wd = -1;
+        continue;
+      }
+      if (!ev->len)
+        continue;
+
+      char rel[MAX_PATH_LEN];
+      snprintf(rel, sizeof(rel), d->rel[0] ? "%s/%s" : "%s%s", d->rel,
+               ev->name);
+      if (ev->mask & IN_ISDIR) {
+        if (ev->mask & (IN_CREATE | IN_MOVED_TO))
+          _watch_add(w, rel, true);
+        else
+          _watch_changed(w, rel);
+      } else if (!(ev->mask & IN_CREATE)) {
+        _watch_changed(w, rel);
+      }
+    }
+  }
+}
+
+// Rereads the directory of the pak on disk into the watch state
+static void _watch_load(pak_watcher* w) {
+  arena m = {0};
+  pak p = {0};
+  pak_meta pm = {0};
+  pakf f = file_open_read(w->path);
+  _estimate(&m, f, &pm);
+  _read_all(&m, f, w->path, &p, &pm);
+
+  if (w->cap < pm.entries_count) {
+    w->cap = pm.entries_count * 2;
+    w->p.entries =
+        (pak_entry*)realloc(w->p.entries, w->cap * sizeof(pak_entry));
+    makesure(w->p.entries != NULL, "malloc failed");
+  }
+  memcpy(w->p.entries, p.entries, pm.entries_count * sizeof(pak_entry));
+  w->count = pm.entries_count;
+  w->p.header = p.header;
+  w->end = (u64)file_fd_size(f);
+
+  file_close(f);
+  arena_destroy(&m);
+}
+
+static int _watch_name_cmp(const void* a, const void* b) {
+  return strncmp((cstr)((const pak_entry*)a)->name,
+                 (cstr)((const pak_entry*)b)->name, ENTRY_NAME_LEN);
+}
+
+static int _watch_path_cmp(const void* a, const void* b) {
+  return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+// Size of the pak once compacted, the padding alignment asks for is not
+// dead space
+static u64 _watch_packed(pak_watcher* w) {
+  u32 align = _layout_align(w->o);
+  i64 of = HEADER_LEN;
+  for (u32 i = 0; i < w->count; i++)
+    of = _layout_align_up(of, align) + w->p.entries[i].size;
+  return (u64)of + (u64)w->count * ENTRY_LEN;
+}
+
+// Appends the data of every changed file, drops entries whose files went
+// away, then writes the new directory after all of it. The header flips to
+// that directory last
+static void _watch_apply(pak_watcher* w) {
+  if (w->rescan) {
+    // events were lost, so every file and every entry is suspect
+    for (u32 i = 0; i < w->count; i++)
+      _watch_changed(w, (cstr)w->p.entries[i].name);
+    _watch_add(w, "", true);
+    w->rescan = false;
+  }
+  if (!w->changed_count)
+    return;
+
+  struct timespec t0;
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+
+  qsort(w->changed, w->changed_count, sizeof(char*), _watch_path_cmp);
+  u32 align = _layout_align(w->o);
+  u32 mask;
+  u32* index = _names_index(&w->p, w->count, true, &mask);
+  u32 indexed = w->count;
+  int fd = file_open_update(w->path);
+  i64 at = (i64)w->end;
+  u32 updated = 0;
+  u32 removed = 0;
+
+  for (u32 c = 0; c < w->changed_count; c++) {
+    cstr rel = w->changed[c];
+    if (c && !strcmp(rel, w->changed[c - 1]))
+      continue;
+    sz len = strlen(rel);
+    i32 i = len < ENTRY_NAME_LEN ? _names_find(&w->p, index, mask, rel, len)
+                                 : -1;
+
+    char path[MAX_PATH_LEN + ENTRY_NAME_LEN];
+    snprintf(path, sizeof(path), "%s/%s", w->dir, rel);
+    fs_file_info fi;
+    if (fs_info(NULL, path, FS_READ, &fi) == FS_SUCCESS && !fi.directory) {
+      if (len >= ENTRY_NAME_LEN || fi.size > INT32_MAX) {
+        printf("↬ skipped:        '%s' does not fit a pak entry\n", rel);
+        continue;
+      }
+      if (i < 0) {
+        _watch_grow((void**)&w->p.entries, &w->cap, w->count,
+                    sizeof(pak_entry));
+        i = (i32)w->count++;
+        memset(&w->p.entries[i], 0, sizeof(pak_entry));
+        memcpy(w->p.entries[i].name, rel, len);
+      }
+
+      file_view v;
+      file_view_open(path, &v);
+      at = _layout_align_up(at, align);
+      makesure(at + (i64)v.size <= INT32_MAX, "the pak grew past 2GB");
+      file_write_at(fd, v.data, v.size, (u64)at);
+      w->p.entries[i].offset = (i32)at;
+      w->p.entries[i].size = (i32)v.size;
+      at += (i64)v.size;
+      file_view_close(&v);
+      updated++;
+      continue;
+    }
+
+    // a file or a whole directory went away, entries are only tombstoned
+    // here since the index still points at them
+    if (i >= 0) {
+      removed += w->p.entries[i].size >= 0;
+      w->p.entries[i].size = -1;
+      continue;
+    }
+    for (u32 k = 0; k < indexed; k++) {
+      cstr name = (cstr)w->p.entries[k].name;
+      if (w->p.entries[k].size >= 0 && !strncmp(name, rel, len) &&
+          name[len] == '/') {
+        w->p.entries[k].size = -1;
+        removed++;
+      }
+    }
+  }
+  free(index);
+
+  for (u32 c = 0; c < w->changed_count; c++)
+    free(w->changed[c]);
+  w->changed_count = 0;
+
+  if (updated || removed) {
+    u32 n = 0;
+    for (u32 i = 0; i < w->count; i++) {
+      if (w->p.entries[i].size >= 0)
+        w->p.entries[n++] = w->p.entries[i];
+    }
+    w->count = n;
+    qsort(w->p.entries, n, sizeof(pak_entry), _watch_name_cmp);
+
+    u8* dir = (u8*)malloc((n ? n : 1) * ENTRY_LEN);
+    makesure(dir != NULL, "malloc failed");
+    for (u32 i = 0; i < n; i++) {
+      pak_entry* ep = (pak_entry*)(dir + (sz)i * ENTRY_LEN);
+      memcpy(ep->name, w->p.entries[i].name, ENTRY_NAME_LEN);
+      ep->offset = endian_i32(w->p.entries[i].offset);
+      ep->size = endian_i32(w->p.entries[i].size);
+    }
+    makesure(at + (i64)n * ENTRY_LEN <= INT32_MAX, "the pak grew past 2GB");
+    file_write_at(fd, dir, (sz)n * ENTRY_LEN, (u64)at);
+    free(dir);
+
+    w->p.header.offset = (i32)at;
+    w->p.header.size = (i32)(n * ENTRY_LEN);
+    pak_header* hp = (pak_header*)HEADER_BUF;
+    memcpy(hp->magic_code, MAGIC_CODE, MAGIC_CODE_LEN);
+    hp->offset = endian_i32(w->p.header.offset);
+    hp->size = endian_i32(w->p.header.size);
+    file_write_at(fd, HEADER_BUF, HEADER_LEN, 0);
+    w->end = (u64)at + (u64)n * ENTRY_LEN;
+  }
+  file_close(fd);
+
+  if (!updated && !removed)
+    return;
+
+  // with every file gone the directory is empty and compact cannot read the
+  // pak back, its dead space goes with the first compaction once files return
+  u64 packed = _watch_packed(w);
+  u64 dead = w->end - packed;
+  bool compact = w->count && dead * 100 > w->end * WATCH_DEAD_PCT;
+  if (compact) {
+    arena m = {0};
+    pak cp = {0};
+    pak_compact(&m, w->path, w->path, w->o, &cp);
+    arena_destroy(&m);
+    _watch_load(w);
+    dead = w->end - _watch_packed(w);
+  }
+
+  struct timespec t1;
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+  f64 ms = (f64)(t1.tv_sec - t0.tv_sec) * 1000 +
+           (f64)(t1.tv_nsec - t0.tv_nsec) / 1000000;
+  printf("↬ refreshed:      '%u updated, %u removed, %llu dead Bytes%s, "
+         "%.1f ms'\n",
+         updated, removed, (unsigned long long)dead,
+         compact ? ", compacted" : "", ms);
+  fflush(stdout);
+}
+
+#endif  // __linux__
+
 /*****************************
  * EXPORTED FUNCTIONS
  *****************************/
 
 pakerr pak_info(arena* m, cstr path, pak* ppak) {
   pak_meta pm = {0};
-  pakf f = fopen(path, "rb");
+  pakf f = file_open_read(path);
 
-  _estimate(m, path, &pm);
+  _estimate(m, f, &pm);
   _read_all(m, f, path, ppak, &pm);
 
   printf("************** INFO **************\n");
@@ -171,15 +1600,21 @@ pakerr pak_info(arena* m, cstr path, pak* ppak) {
          pm.pak_size);
   printf("↬ entries counts: '%u'\n", pm.entries_count);
 
-  fclose(f);
+  u32 align = 1;
+  sz pad = _layout_padding(ppak, pm.entries_count, pm.pak_size, &align);
+  printf("↬ alignment:      '%u Bytes'\n", align);
+  printf("↬ padding:        '%zu Bytes (%.2f%%)'\n", pad,
+         pm.pak_size ? (f64)pad * 100 / pm.pak_size : 0.0);
+
+  file_close(f);
   return PAK_ERR_OK;
 }
 
 pakerr pak_list(arena* m, cstr path, pak* ppak) {
   pak_meta pm = {0};
-  pakf f = fopen(path, "rb");
+  pakf f = file_open_read(path);
 
-  _estimate(m, path, &pm);
+  _estimate(m, f, &pm);
   _read_all(m, f, path, ppak, &pm);
 
   printf("************** ENTRIES **************\n");
@@ -189,11 +1624,15 @@ pakerr pak_list(arena* m, cstr path, pak* ppak) {
            (f32)ppak->entries[i].size / 1000000, ppak->entries[i].size);
   }
 
-  fclose(f);
+  file_close(f);
   return PAK_ERR_OK;
 }
 
-pakerr pak_extract(arena* m, cstr path, cstr odir, pak* ppak) {
+pakerr pak_extract(arena* m,
+                   cstr path,
+                   cstr odir,
+                   const pak_opts* o,
+                   pak* ppak) {
   makesure(
       strlen(odir) < MAX_PATH_LEN,
       "output director '%s' path length is larger than supported max of '%d'",
@@ -206,49 +1645,594 @@ pakerr pak_extract(arena* m, cstr path, cstr odir, pak* ppak) {
            "failed to get information about input pak file at '%s'", path);
   makesure(fi.directory != 1, "the input pak is not a file");
 
+  bool update = o && o->update;
   fs_file_info od;
   fr = fs_info(pfs, odir, FS_READ, &od);
-  makesure(fr != FS_SUCCESS, "the output directory at '%s' already exists",
-           odir);
+  if (update) {
+    makesure(fr != FS_SUCCESS || od.directory,
+             "the output at '%s' is not a directory", odir);
+  } else {
+    makesure(fr != FS_SUCCESS, "the output directory at '%s' already exists",
+             odir);
+  }
 
   pak_meta pm = {0};
-  pakf f = fopen(path, "rb");
+  file_view v;
+  file_view_open(path, &v);
 
-  _estimate(m, path, &pm);
-  _read_all(m, f, path, ppak, &pm);
+  _estimate(m, v.fd, &pm);
+  _read_all(m, v.fd, path, ppak, &pm);
+
+  // stale files go first so a directory can make way for a file and back
+  pak_update u = {0};
+  char mpath[MAX_PATH_LEN + 16];
+  if (update) {
+    u.index = _names_index(ppak, pm.entries_count, true, &u.mask);
+    u.rows = (pak_manifest_row*)calloc(
+        pm.entries_count ? pm.entries_count : 1, sizeof(pak_manifest_row));
+    makesure(u.rows != NULL, "malloc failed");
+    _update_manifest_path(odir, mpath);
+    _update_load(&u, ppak, mpath, fr == FS_SUCCESS ? odir : NULL);
+  }
+
+  pak_prefetch pf;
+  _prefetch_init(&pf, &v, ppak, pm.entries_count);
 
   for (u32 i = 0; i < pm.entries_count; i++) {
+    _prefetch_next(&pf, i);
+
+    pak_entry* e = &ppak->entries[i];
+    i32 of = e->offset;
+    sz is = e->size;
+    makesure(of >= 0 && (sz)of + is <= v.size, "entry '%s' is out of bounds",
+             e->name);
+
     memset(PATH_BUF, 0, MAX_PATH_LEN + ENTRY_NAME_LEN);
-    memset(DATA_BUF, 0, MAX_FILE_SIZE);
+    sprintf(PATH_BUF, "%s/%.*s", odir, (int)ENTRY_NAME_LEN,
+            (const char*)e->name);
+
+    u64 hash = 0;
+    if (update) {
+      // a later entry of the same name overwrites this one anyway
+      cstr name = (cstr)e->name;
+      if (_names_find(ppak, u.index, u.mask, name,
+                      strnlen(name, ENTRY_NAME_LEN)) != (i32)i) {
+        _prefetch_done(&pf, i);
+        continue;
+      }
+      hash = hash_content(v.data + of, is);
+      if (_update_fresh(&u, i, PATH_BUF, v.data + of, is, hash)) {
+        _update_record(&u, i, PATH_BUF, is, hash);
+        u.kept++;
+        _prefetch_done(&pf, i);
+        continue;
+      }
+    }
+    _make_parent_dirs(PATH_BUF);
+
+    // small entries get a buffer that just fits, big ones stream through
+    file_writer w;
+    file_writer_opts wo = {.flush_size = file_writer_flush_for(is),
+                           .prealloc = is,
+                           .direct = o && o->direct};
+    file_writer_open(PATH_BUF, &wo, &w);
+    file_writer_write(&w, v.data + of, is);
+    file_writer_close(&w);
+
+    if (update) {
+      _update_record(&u, i, PATH_BUF, is, hash);
+      u.written++;
+    }
+    _prefetch_done(&pf, i);
+  }
+
+  if (update) {
+    _update_save(&u, ppak, pm.entries_count, mpath);
+
+    printf("************** UPDATE **************\n");
+    printf("↬ output:         '%s'\n", odir);
+    printf("↬ manifest:       '%s'\n", mpath);
+    printf("↬ written:        '%u'\n", u.written);
+    printf("↬ unchanged:      '%u'\n", u.kept);
+    printf("↬ removed:        '%u'\n", u.removed);
+    free(u.rows);
+    free(u.index);
+  }
 
-    sprintf(PATH_BUF, "%s/%s", odir, (const char*)ppak->entries[i].name);
+  file_view_close(&v);
+  return PAK_ERR_OK;
+}
+
+pakerr pak_create(arena* m,
+                  cstr dir,
+                  cstr path,
+                  const pak_opts* o,
+                  pak* ppak) {
+  makesure(strlen(dir) < MAX_PATH_LEN,
+           "input director '%s' path length is larger than supported max of "
+           "'%d'",
+           dir, MAX_PATH_LEN);
+
+  fs_file_info fi;
+  makesure(fs_info(NULL, dir, FS_READ, &fi) == FS_SUCCESS && fi.directory,
+           "the input directory at '%s' does not exist", dir);
+
+  // count first so the arena can be sized exactly, then fill the entries
+  u32 fc = 0;
+  arena_begin_estimate(m);
+  _collect(dir, "", NULL, &fc);
+  makesure(fc > 0, "no files found under '%s'", dir);
+  arena_estimate_add(m, fc * sizeof(pak_entry), alignof(pak_entry));
+  arena_end_estimate(m);
+
+  ppak->entries =
+      (pak_entry*)arena_alloc(m, fc * sizeof(pak_entry), alignof(pak_entry));
+  notnull(ppak->entries);
+  memset(ppak->entries, 0, fc * sizeof(pak_entry));
+
+  u32 n = 0;
+  _collect(dir, "", ppak, &n);
+  makesure(n == fc, "the input directory changed while packing");
+
+  // the directory stays in name order, only the data follows the trace
+  u32* order = (u32*)malloc((fc ? fc : 1) * sizeof(u32));
+  makesure(order != NULL, "malloc failed");
+  u32 traced = _layout_order(ppak, fc, o ? o->order : NULL, order);
+  u32 align = _layout_align(o);
+
+  i64 of = HEADER_LEN;
+  for (u32 k = 0; k < fc; k++) {
+    pak_entry* e = &ppak->entries[order[k]];
+    of = _layout_align_up(of, align);
+    e->offset = (i32)of;
+    of += e->size;
+    makesure(of <= INT32_MAX, "the pak would be larger than 2GB");
+  }
+
+  memcpy(ppak->header.magic_code, MAGIC_CODE, MAGIC_CODE_LEN);
+  ppak->header.offset = (i32)of;
+  ppak->header.size = (i32)(fc * ENTRY_LEN);
+
+  // the final size is known up front so the writer can preallocate it
+  file_writer w;
+  file_writer_opts wo = {.prealloc = (u64)of + fc * ENTRY_LEN,
+                         .direct = o && o->direct};
+  file_writer_open(path, &wo, &w);
+
+  pak_header* hp = (pak_header*)HEADER_BUF;
+  memcpy(hp->magic_code, MAGIC_CODE, MAGIC_CODE_LEN);
+  hp->offset = endian_i32(ppak->header.offset);
+  hp->size = endian_i32(ppak->header.size);
+  file_writer_write(&w, HEADER_BUF, HEADER_LEN);
+
+  for (u32 k = 0; k < fc; k++) {
+    pak_entry* e = &ppak->entries[order[k]];
+    sprintf(PATH_BUF, "%s/%s", dir, (const char*)e->name);
+
+    file_view v;
+    file_view_open(PATH_BUF, &v);
+    makesure(v.size == (sz)e->size, "'%s' changed while packing", PATH_BUF);
+    _layout_pad(&w, (u64)e->offset);
+    file_writer_write(&w, v.data, v.size);
+    file_view_close(&v);
+  }
+
+  for (u32 i = 0; i < fc; i++) {
+    pak_entry* ep = (pak_entry*)ENTRY_BUF;
+    memcpy(ep->name, ppak->entries[i].name, ENTRY_NAME_LEN);
+    ep->offset = endian_i32(ppak->entries[i].offset);
+    ep->size = endian_i32(ppak->entries[i].size);
+    file_writer_write(&w, ENTRY_BUF, ENTRY_LEN);
+  }
+  file_writer_close(&w);
+  free(order);
+
+  printf("************** CREATE **************\n");
+  printf("↬ file name:      '%s'\n", path);
+  printf("↬ file size:      '%zu MB (%zu Bytes)'\n",
+         (sz)(of + fc * ENTRY_LEN) / 1000000, (sz)(of + fc * ENTRY_LEN));
+  printf("↬ entries counts: '%u'\n", fc);
+  if (o && o->order)
+    printf("↬ trace ordered:  '%u'\n", traced);
+  if (align > 1)
+    printf("↬ alignment:      '%u Bytes'\n", align);
+
+  return PAK_ERR_OK;
+}
+
+pakerr pak_export(arena* m,
+                  cstr path,
+                  cstr odir,
+                  const pak_opts* o,
+                  pak* ppak) {
+  makesure(o && o->png, "nothing to export to, pass --png");
+  makesure(
+      strlen(odir) < MAX_PATH_LEN,
+      "output director '%s' path length is larger than supported max of '%d'",
+      odir, MAX_PATH_LEN);
+
+  fs_file_info od;
+  makesure(fs_info(NULL, odir, FS_READ, &od) != FS_SUCCESS,
+           "the output directory at '%s' already exists", odir);
+
+  pak_meta pm = {0};
+  file_view v;
+  file_view_open(path, &v);
+  _estimate(m, v.fd, &pm);
+  _read_all(m, v.fd, path, ppak, &pm);
+
+  u32 fc = pm.entries_count;
+  for (u32 i = 0; i < fc; i++) {
+    pak_entry* e = &ppak->entries[i];
+    makesure(e->offset >= 0 && (sz)e->offset + e->size <= v.size,
+             "entry '%.56s' is out of bounds", e->name);
+  }
+
+  pak_export_job job = {.o = o};
+  _export_palette(&job, &v, ppak, fc, o);
+  for (u32 i = 0; i < PALETTE_COLORS; i++)
+    job.swatch[i] = (u8)i;
+  makesure(fs_mkdir(NULL, odir, 0) == FS_SUCCESS,
+           "failed to create directory '%s'", odir);
+
+  // one filter thread keeps up with several encoders, deflate is the slow part
+  u32 encoders = thread_count() > 2 ? thread_count() - 2 : 1;
+  thread_queue_init(&job.to_filter, job.slots[0], EXPORT_QUEUE_LEN, 1);
+  thread_queue_init(&job.to_encode, job.slots[1], EXPORT_QUEUE_LEN, 1);
+  thread_queue_init(&job.to_write, job.slots[2], EXPORT_QUEUE_LEN, encoders);
+
+  thread_handle stages[THREAD_MAX_WORKERS + 2];
+  u32 ns = 0;
+  thread_spawn(&stages[ns++], _export_filter, &job, 0);
+  for (u32 i = 0; i < encoders; i++)
+    thread_spawn(&stages[ns++], _export_encode, &job, 1 + i);
+  thread_spawn(&stages[ns++], _export_write, &job, 1 + encoders);
+
+  for (u32 i = 0; i < fc; i++) {
+    pak_entry* e = &ppak->entries[i];
+    if (_export_ext(e, ".lmp"))
+      _export_lmp(&job, &v, e, odir);
+    else if (_export_ext(e, ".wad"))
+      _export_wad(&job, &v, e, odir);
+    else if (_export_ext(e, ".bsp"))
+      _export_bsp(&job, &v, e, odir);
+  }
+  thread_queue_done(&job.to_filter);
+
+  for (u32 i = 0; i < ns; i++)
+    thread_join(&stages[i]);
+  thread_queue_destroy(&job.to_filter);
+  thread_queue_destroy(&job.to_encode);
+  thread_queue_destroy(&job.to_write);
+  file_view_close(&v);
+
+  printf("************** EXPORT **************\n");
+  printf("↬ file name:      '%s'\n", path);
+  printf("↬ entries counts: '%u'\n", fc);
+  printf("↬ images written: '%u'\n", job.written);
+
+  return PAK_ERR_OK;
+}
+
+pakerr pak_convert(arena* m,
+                   cstr path,
+                   cstr opath,
+                   const pak_opts* o,
+                   pak* ppak) {
+  u8 magic[MAGIC_CODE_LEN];
+  pakf f = file_open_read(path);
+  makesure(f >= 0, "faied to open file '%s'", path);
+  bool from_pak = file_read_at(f, magic, MAGIC_CODE_LEN, 0) == MAGIC_CODE_LEN &&
+                  !memcmp(magic, MAGIC_CODE, MAGIC_CODE_LEN);
+  file_close(f);
+
+  pak_convert_job job = {.o = o};
+  pk3 z = {0};
+  file_view v = {.fd = -1};
+  u32 files = 0;
+
+  if (from_pak) {
+    pak_meta pm = {0};
+    file_view_open(path, &v);
+    _estimate(m, v.fd, &pm);
+    _read_all(m, v.fd, path, ppak, &pm);
+    files = pm.entries_count;
+  } else {
+    pk3_open(m, path, &z);
+    for (u32 i = 0; i < z.entries_count; i++) {
+      pk3_entry* e = &z.entries[i];
+      files += !(e->name_len && e->name[e->name_len - 1] == '/');
+    }
+    job.zip = &z;
+  }
+
+  job.count = files;
+  job.items = (pak_convert_item*)calloc(files ? files : 1,
+                                        sizeof(pak_convert_item));
+  makesure(job.items != NULL, "malloc failed");
+
+  // built next to the output and renamed over it only once every entry
+  // made it, a failed run leaves no truncated archive behind
+  char tmp[MAX_PATH_LEN + 32];
+  makesure(strlen(opath) < MAX_PATH_LEN,
+           "output path '%s' is longer than supported max of '%d'", opath,
+           MAX_PATH_LEN);
+  sprintf(tmp, "%s.tmp", opath);
+
+  if (from_pak)
+    _convert_to_pk3(&job, &v, ppak, tmp);
+  else
+    _convert_to_pak(&job, tmp);
+  files = job.count;
+
+  u32 deflated = 0;
+  for (u32 i = 0; from_pak && i < files; i++)
+    deflated += job.items[i].e.method == PK3_METHOD_DEFLATE;
+  u64 osize = job.w.written;
+  free(job.items);
+  if (from_pak)
+    file_view_close(&v);
+  else
+    pk3_close(&z);
+
+  if (job.failed) {
+    remove(tmp);
+    log_error("'%s' was not converted, '%u' entries could not be read", path,
+              (u32)job.failed);
+    return PAK_ERR_UNKNOWN;
+  }
+  makesure(rename(tmp, opath) == 0, "failed to write '%s'", opath);
+
+  printf("************** CONVERT **************\n");
+  printf("↬ file name:      '%s'\n", path);
+  printf("↬ output:         '%s' (%s)\n", opath, from_pak ? "pk3" : "pak");
+  printf("↬ file size:      '%llu MB (%llu Bytes)'\n",
+         (unsigned long long)(osize / 1000000), (unsigned long long)osize);
+  printf("↬ entries counts: '%u'\n", files);
+  if (from_pak)
+    printf("↬ deflated:       '%u'\n", deflated);
+
+  return PAK_ERR_OK;
+}
+
+pakerr pak_compact(arena* m,
+                   cstr path,
+                   cstr opath,
+                   const pak_opts* o,
+                   pak* ppak) {
+  // the input stays mapped while the new layout is written, so the output
+  // goes to a temporary and replaces opath at the end, which also makes
+  // compacting a pak onto itself safe however the two paths are spelled
+  char tmp[MAX_PATH_LEN + 32];
+  makesure(strlen(opath) < MAX_PATH_LEN,
+           "output path '%s' is longer than supported max of '%d'", opath,
+           MAX_PATH_LEN);
+  sprintf(tmp, "%s.tmp", opath);
+
+  pak_meta pm = {0};
+  file_view v;
+  file_view_open(path, &v);
+  _estimate(m, v.fd, &pm);
+  _read_all(m, v.fd, path, ppak, &pm);
+
+  u32 fc = pm.entries_count;
+  for (u32 i = 0; i < fc; i++) {
+    pak_entry* e = &ppak->entries[i];
+    makesure(e->offset >= 0 && e->size >= 0 &&
+                 (sz)e->offset + e->size <= v.size,
+             "entry '%.56s' is out of bounds", e->name);
+  }
+
+  u32* order = (u32*)malloc((fc ? fc : 1) * sizeof(u32));
+  i32* offsets = (i32*)malloc((fc ? fc : 1) * sizeof(i32));
+  makesure(order != NULL && offsets != NULL, "malloc failed");
+  u32 traced = _layout_order(ppak, fc, o ? o->order : NULL, order);
+  _layout_keep_order(ppak, order, traced, fc);
+  u32 align = _layout_align(o);
+
+  // what no entry covers in the input is dropped, alignment pads the output
+  // again, both are reported on their own as pak info does
+  u32 ialign = 1;
+  sz dead = _layout_padding(ppak, fc, v.size, &ialign);
+  i64 of = HEADER_LEN;
+  u64 pad = 0;
+  for (u32 k = 0; k < fc; k++) {
+    i64 at = _layout_align_up(of, align);
+    pad += (u64)(at - of);
+    offsets[order[k]] = (i32)at;
+    of = at + ppak->entries[order[k]].size;
+    makesure(of <= INT32_MAX, "the pak would be larger than 2GB");
+  }
+  u64 osize = (u64)of + (u64)fc * ENTRY_LEN;
 
-    fs_file* pf;
-    fs_result r = fs_file_open(pfs, PATH_BUF, FS_OVERWRITE, &pf);
-    makesure(r != FS_SUCCESS, "failed to create file '%s'",
-             ppak->entries[i].name);
-    fs_file_close(pf);
+  file_writer w;
+  file_writer_opts wo = {.prealloc = osize, .direct = o && o->direct};
+  file_writer_open(tmp, &wo, &w);
 
-    i32 of = ppak->entries[i].offset;
-    sz is = ppak->entries[i].size;
-    sz os = 0;
+  pak_header* hp = (pak_header*)HEADER_BUF;
+  memcpy(hp->magic_code, MAGIC_CODE, MAGIC_CODE_LEN);
+  hp->offset = endian_i32((i32)of);
+  hp->size = endian_i32((i32)(fc * ENTRY_LEN));
+  file_writer_write(&w, HEADER_BUF, HEADER_LEN);
 
-    fseek(f, of, SEEK_SET);
-    makesure(is == fread(DATA_BUF, 1, is, f), "failed to read enough data");
+  // reads jump around the old layout, so the next entry is always in flight
+  for (u32 k = 0; k < fc; k++) {
+    if (k + 1 < fc) {
+      pak_entry* n = &ppak->entries[order[k + 1]];
+      file_view_advise(&v, n->offset, n->size, FILE_ADVICE_WILLNEED);
+    }
+    pak_entry* e = &ppak->entries[order[k]];
+    _layout_pad(&w, (u64)offsets[order[k]]);
+    file_writer_write(&w, v.data + e->offset, e->size);
+    file_view_advise(&v, e->offset, e->size, FILE_ADVICE_DONTNEED);
+  }
 
-    FILE* ff = fopen(PATH_BUF, "wb");
-    makesure(is == fwrite(DATA_BUF, 1, is, ff), "failed to write enough data");
-    fclose(ff);
+  for (u32 i = 0; i < fc; i++) {
+    pak_entry* ep = (pak_entry*)ENTRY_BUF;
+    memcpy(ep->name, ppak->entries[i].name, ENTRY_NAME_LEN);
+    ep->offset = endian_i32(offsets[i]);
+    ep->size = endian_i32(ppak->entries[i].size);
+    file_writer_write(&w, ENTRY_BUF, ENTRY_LEN);
+  }
+  file_writer_close(&w);
+  makesure(rename(tmp, opath) == 0, "failed to write '%s'", opath);
+
+  printf("************** COMPACT **************\n");
+  printf("↬ file name:      '%s'\n", path);
+  printf("↬ output:         '%s'\n", opath);
+  printf("↬ file size:      '%zu MB (%zu Bytes)'\n", (sz)osize / 1000000,
+         (sz)osize);
+  printf("↬ reclaimed:      '%zu Bytes'\n", dead);
+  printf("↬ entries counts: '%u'\n", fc);
+  if (o && o->order)
+    printf("↬ trace ordered:  '%u'\n", traced);
+  if (align > 1) {
+    printf("↬ alignment:      '%u Bytes'\n", align);
+    printf("↬ padding:        '%llu Bytes (%.2f%%)'\n", (unsigned long long)pad,
+           osize ? (f64)pad * 100 / (f64)osize : 0.0);
   }
 
-  fclose(f);
+  free(offsets);
+  free(order);
+  file_view_close(&v);
   return PAK_ERR_OK;
 }
 
-pakerr pak_create(arena* m, cstr path, pak*) {
-  mustdie("THIS FEATURE IS NOT IMPLEMENTED YET!");
+pakerr pak_watch(arena* m,
+                 cstr dir,
+                 cstr path,
+                 const pak_opts* o,
+                 pak* ppak) {
+#if defined(__linux__)
+  // the pak must not be part of what it mirrors
+  char rdir[PATH_MAX];
+  char rout[PATH_MAX];
+  snprintf(DIR_BUF, sizeof(DIR_BUF), "%s", path);
+  char* sl = strrchr(DIR_BUF, '/');
+  if (sl)
+    *sl = '\0';
+  makesure(realpath(dir, rdir) && realpath(sl ? DIR_BUF : ".", rout),
+           "failed to resolve '%s' or '%s'", dir, path);
+  sz rl = strlen(rdir);
+  makesure(strncmp(rout, rdir, rl) || (rout[rl] != '/' && rout[rl] != '\0'),
+           "the output '%s' must live outside the watched '%s'", path, dir);
+
+  pak_create(m, dir, path, o, ppak);
+
+  pak_watcher w = {.dir = dir, .path = path, .o = o};
+  w.notify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  makesure(w.notify >= 0, "failed to start watching '%s'", dir);
+  _watch_load(&w);
+  _watch_add(&w, "", false);
+
+  printf("************** WATCH **************\n");
+  printf("↬ watching:       '%s'\n", dir);
+  printf("↬ directories:    '%u'\n", w.dirs_count);
+  fflush(stdout);
+
+  // events arrive in bursts, a save is often several, so a batch only
+  // closes after a short quiet spell
+  struct pollfd pfd = {.fd = w.notify, .events = POLLIN};
+  for (;;) {
+    if (poll(&pfd, 1, -1) < 0) {
+      makesure(errno == EINTR, "failed to wait for changes in '%s'", dir);
+      continue;
+    }
+    _watch_read(&w);
+    while (poll(&pfd, 1, WATCH_SETTLE_MS) > 0)
+      _watch_read(&w);
+    _watch_apply(&w);
+  }
+#else
+  mustdie("watching '%s' needs inotify, which only linux has", dir);
+#endif
   return PAK_ERR_OK;
 }
 
+pakerr pak_grep(arena* m, cstr* paths, u32 count, const u8* pat, sz len) {
+  makesure(len > 0, "the pattern is empty");
+
+  // every directory lands in the one arena, sized from the headers first
+  pak* paks = (pak*)calloc(count ? count : 1, sizeof(pak));
+  u32* counts = (u32*)calloc(count ? count : 1, sizeof(u32));
+  makesure(paks != NULL && counts != NULL, "malloc failed");
+  arena_begin_estimate(m);
+  for (u32 i = 0; i < count; i++) {
+    pakf f = file_open_read(paths[i]);
+    _read_header(f, &paks[i].header);
+    counts[i] = (u32)paks[i].header.size / ENTRY_LEN;
+    arena_estimate_add(m, counts[i] * sizeof(pak_entry), alignof(pak_entry));
+    file_close(f);
+  }
+  arena_end_estimate(m);
+  for (u32 i = 0; i < count; i++) {
+    pak_meta pm = {.entries_count = counts[i]};
+    pakf f = file_open_read(paths[i]);
+    _read_all(m, f, paths[i], &paks[i], &pm);
+    file_close(f);
+  }
+
+  // a few paks are mapped at a time so thousands of them stay within the
+  // descriptor limit, their entries are cut into ranges the workers share
+  file_view views[GREP_OPEN_PAKS];
+  u64 found = 0;
+  for (u32 g = 0; g < count; g += GREP_OPEN_PAKS) {
+    u32 ge = g + GREP_OPEN_PAKS < count ? g + GREP_OPEN_PAKS : count;
+    u32 n = 0;
+    for (u32 i = g; i < ge; i++) {
+      file_view_open(paths[i], &views[i - g]);
+      for (u32 k = 0; k < counts[i]; k++) {
+        pak_entry* e = &paks[i].entries[k];
+        makesure(e->offset >= 0 && e->size >= 0 &&
+                     (sz)e->offset + e->size <= views[i - g].size,
+                 "entry '%.56s' of '%s' is out of bounds", e->name, paths[i]);
+        n += (u32)(((u64)e->size + GREP_RANGE - 1) / GREP_RANGE);
+      }
+    }
+
+    pak_grep_item* items =
+        (pak_grep_item*)calloc(n ? n : 1, sizeof(pak_grep_item));
+    makesure(items != NULL, "malloc failed");
+    u32 at = 0;
+    for (u32 i = g; i < ge; i++) {
+      for (u32 k = 0; k < counts[i]; k++) {
+        u64 size = (u64)paks[i].entries[k].size;
+        for (u64 from = 0; from < size; from += GREP_RANGE) {
+          u64 to = from + GREP_RANGE < size ? from + GREP_RANGE : size;
+          items[at++] = (pak_grep_item){
+              .pak = i, .entry = k, .from = from, .to = to};
+        }
+      }
+    }
+
+    // g is a multiple of GREP_OPEN_PAKS, so a pak's view is at its index
+    // modulo that
+    pak_grep_job job = {.views = views,
+                        .paks = paks,
+                        .items = items,
+                        .pat = pat,
+                        .len = len};
+    thread_parallel_for(n, _grep_scan, &job);
+
+    // items are in pak, directory and offset order, and so is the output
+    for (u32 k = 0; k < n; k++) {
+      pak_grep_item* it = &items[k];
+      cstr name = (cstr)paks[it->pak].entries[it->entry].name;
+      for (u32 h = 0; h < it->hits_count; h++)
+        printf("%s:%.*s:%llu\n", paths[it->pak], (int)ENTRY_NAME_LEN, name,
+               (unsigned long long)it->hits[h]);
+      found += it->hits_count;
+      free(it->hits);
+    }
+    free(items);
+    for (u32 i = g; i < ge; i++)
+      file_view_close(&views[i - g]);
+  }
+
+  free(counts);
+  free(paks);
+  return found ? PAK_ERR_OK : PAK_ERR_UNKNOWN;
+}
+
 #endif  // PAK_IMPLEMENTATION
 #endif  //_PAK_HEADER_
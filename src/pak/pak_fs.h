@@ -0,0 +1,499 @@
+#ifndef _PAK_FS_HEADER_
+#define _PAK_FS_HEADER_
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "../../deps/fs.h"
+#include "../utils/types.h"
+#include "../utils/io.h"
+#include "../utils/macros.h"
+#include "../utils/endian.h"
+#include "pak.h"
+
+// PAK archive backend for deps/fs. Register it as an archive type,
+//
+//   fs_archive_type types[] = {{PAK_FS, "pak"}};
+//
+// and fs_mount/fs_file_open see pak entries as ordinary files, read through
+// the archive stream. pak_fs_mount maps the pak instead and serves every read
+// straight from the mapping, pak_fs_file_data hands out the bytes themselves.
+extern const fs_backend* PAK_FS;
+
+// Optional backend config, a pak that is already in memory
+typedef struct {
+  const u8* data;
+  sz size;
+} pak_fs_config;
+
+// A pak mounted through its mapping, see pak_fs_mount
+typedef struct {
+  file_view view;
+  pak_fs_config config;
+  fs* archive;
+} pak_fs_mapped;
+
+/* ****************** pak_fs API ****************** */
+
+// Maps 'path' and mounts it on 'vpath' of pFS, reads never touch the stream
+fs_result pak_fs_mount(fs*, cstr, cstr, pak_fs_mapped*);
+void pak_fs_unmount(fs*, pak_fs_mapped*);
+
+// Entry bytes inside the mapping, NULL unless the pak was mounted mapped
+const u8* pak_fs_file_data(fs_file*, sz*);
+
+/* ****************** pak_fs API ****************** */
+
+//  _                 _                           _        _   _
+// (_)               | |                         | |      | | (_)
+//  _ _ __ ___  _ __ | | ___ _ __ ___   ___ _ __ | |_ __ _| |_ _  ___  _ __
+// | | '_ ` _ \| '_ \| |/ _ \ '_ ` _ \ / _ \ '_ \| __/ _` | __| |/ _ \| '_ \
+// | | | | | | | |_) | |  __/ | | | | |  __/ | | | || (_| | |_| | (_) | | | |
+// |_|_| |_| |_| .__/|_|\___|_| |_| |_|\___|_| |_|\__\__,_|\__|_|\___/|_| |_|
+//             | |
+//             |_|
+
+#ifdef PAK_FS_IMPLEMENTATION
+
+/*****************************
+ * HIDDEN FUNCTIONS
+ *****************************/
+
+typedef struct {
+  char name[ENTRY_NAME_LEN + 1];  // always terminated, unlike the disk copy
+  u32 order;                      // position in the pak, first one wins
+  i32 offset;
+  i32 size;
+} pak_fs_entry;
+
+// Backend data of an archive fs object
+typedef struct {
+  const u8* data;          // mapping from pak_fs_config, NULL for streams
+  sz size;
+  pak_fs_entry* entries;   // sorted by name so lookups and listings bisect
+  u32 count;
+} pak_fs_data;
+
+static constexpr u32 PAK_FS_FILE_TAG = 0x464B4150;  // "PAKF"
+
+// Backend data of one opened entry, the tag tells pak_fs_file_data that a
+// file really came from this backend
+typedef struct {
+  u32 tag;
+  fs_stream* stream;
+  const u8* data;  // entry bytes when mapped
+  i64 offset;
+  i64 size;
+  i64 cursor;
+} pak_fs_file;
+
+typedef struct {
+  fs_iterator base;
+  const pak_fs_data* pak;
+  u32 next;
+  u32 prefix_len;
+  char prefix[ENTRY_NAME_LEN + 1];  // directory being listed, with its '/'
+  char name[ENTRY_NAME_LEN + 1];
+} pak_fs_iterator;
+
+static int _pak_fs_cmp(const void* a, const void* b) {
+  const pak_fs_entry* x = (const pak_fs_entry*)a;
+  const pak_fs_entry* y = (const pak_fs_entry*)b;
+  int c = strcmp(x->name, y->name);
+  return c ? c : (x->order > y->order) - (x->order < y->order);
+}
+
+// Strips the "./", "/" and trailing separators fs hands down, returns the
+// length of what is left
+static sz _pak_fs_path(const char* path, sz len, const char** out) {
+  if (len == FS_NULL_TERMINATED)
+    len = strlen(path);
+  while (len && (path[0] == '/' || path[0] == '\\' ||
+                 (path[0] == '.' && (len == 1 || path[1] == '/')))) {
+    path++;
+    len--;
+  }
+  while (len && (path[len - 1] == '/' || path[len - 1] == '\\'))
+    len--;
+  *out = path;
+  return len;
+}
+
+// First entry whose name is not below 'key[0..len)'
+static u32 _pak_fs_lower(const pak_fs_data* d, const char* key, sz len) {
+  u32 lo = 0;
+  u32 hi = d->count;
+  while (lo < hi) {
+    u32 mid = lo + (hi - lo) / 2;
+    const char* name = d->entries[mid].name;
+    int c = strncmp(name, key, len);
+    if (c < 0 || (c == 0 && strlen(name) < len))
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+static const pak_fs_entry* _pak_fs_find(const pak_fs_data* d,
+                                        const char* path,
+                                        sz len) {
+  u32 i = _pak_fs_lower(d, path, len);
+  if (i < d->count && strlen(d->entries[i].name) == len &&
+      !strncmp(d->entries[i].name, path, len))
+    return &d->entries[i];
+  return NULL;
+}
+
+// Directories only exist as prefixes of entry names
+static bool _pak_fs_is_dir(const pak_fs_data* d, const char* path, sz len) {
+  if (!len)
+    return true;
+  if (len >= ENTRY_NAME_LEN)
+    return false;
+
+  char prefix[ENTRY_NAME_LEN + 1];
+  memcpy(prefix, path, len);
+  prefix[len] = '/';
+  u32 i = _pak_fs_lower(d, prefix, len + 1);
+  return i < d->count && !strncmp(d->entries[i].name, prefix, len + 1);
+}
+
+static fs_result _pak_fs_read_at(fs_stream* s, void* dst, sz len, i64 at) {
+  fs_result r = fs_stream_seek(s, at, FS_SEEK_SET);
+  if (r != FS_SUCCESS)
+    return r;
+  sz got = 0;
+  r = fs_stream_read(s, dst, len, &got);
+  return r == FS_SUCCESS && got == len ? FS_SUCCESS : FS_INVALID_FILE;
+}
+
+static size_t _pak_fs_alloc_size(const void* config) {
+  (void)config;
+  return sizeof(pak_fs_data);
+}
+
+static fs_result _pak_fs_init(fs* pfs, const void* config, fs_stream* stream) {
+  pak_fs_data* d = (pak_fs_data*)fs_get_backend_data(pfs);
+  const pak_fs_config* c = (const pak_fs_config*)config;
+  *d = (pak_fs_data){0};
+  if (c) {
+    d->data = c->data;
+    d->size = c->size;
+  } else if (!stream) {
+    return FS_INVALID_ARGS;
+  }
+
+  pak_header h;
+  if (d->data) {
+    if (d->size < HEADER_LEN)
+      return FS_INVALID_FILE;
+    memcpy(&h, d->data, sizeof(h));
+  } else {
+    fs_int64 end = 0;
+    if (fs_stream_seek(stream, 0, FS_SEEK_END) != FS_SUCCESS ||
+        fs_stream_tell(stream, &end) != FS_SUCCESS)
+      return FS_INVALID_FILE;
+    d->size = (sz)end;
+    fs_result r = _pak_fs_read_at(stream, &h, sizeof(h), 0);
+    if (r != FS_SUCCESS)
+      return r;
+  }
+
+  h.offset = endian_i32(h.offset);
+  h.size = endian_i32(h.size);
+  if (memcmp(h.magic_code, MAGIC_CODE, MAGIC_CODE_LEN) || h.offset < 0 ||
+      h.size < 0 || (sz)h.offset + h.size > d->size)
+    return FS_INVALID_FILE;
+
+  d->count = (u32)h.size / ENTRY_LEN;
+  if (!d->count)
+    return FS_SUCCESS;
+
+  const fs_allocation_callbacks* cb = fs_get_allocation_callbacks(pfs);
+  sz tz = (sz)d->count * ENTRY_LEN;
+  pak_entry* table = (pak_entry*)(d->data ? NULL : fs_malloc(tz, cb));
+  d->entries = (pak_fs_entry*)fs_malloc(d->count * sizeof(pak_fs_entry), cb);
+  if (!d->entries || (!d->data && !table)) {
+    fs_free(table, cb);
+    fs_free(d->entries, cb);
+    return FS_OUT_OF_MEMORY;
+  }
+  if (table) {
+    fs_result r = _pak_fs_read_at(stream, table, tz, h.offset);
+    if (r != FS_SUCCESS) {
+      fs_free(table, cb);
+      fs_free(d->entries, cb);
+      return r;
+    }
+  }
+
+  const u8* src = table ? (const u8*)table : d->data + h.offset;
+  for (u32 i = 0; i < d->count; i++) {
+    pak_entry pe;
+    memcpy(&pe, src + (sz)i * ENTRY_LEN, sizeof(pe));
+    pak_fs_entry* e = &d->entries[i];
+    memcpy(e->name, pe.name, ENTRY_NAME_LEN);
+    e->name[ENTRY_NAME_LEN] = '\0';
+    e->order = i;
+    e->offset = endian_i32(pe.offset);
+    e->size = endian_i32(pe.size);
+    if (e->offset < 0 || e->size < 0 || (sz)e->offset + e->size > d->size) {
+      fs_free(table, cb);
+      fs_free(d->entries, cb);
+      return FS_INVALID_FILE;
+    }
+  }
+  fs_free(table, cb);
+
+  qsort(d->entries, d->count, sizeof(pak_fs_entry), _pak_fs_cmp);
+  return FS_SUCCESS;
+}
+
+static void _pak_fs_uninit(fs* pfs) {
+  pak_fs_data* d = (pak_fs_data*)fs_get_backend_data(pfs);
+  fs_free(d->entries, fs_get_allocation_callbacks(pfs));
+  d->entries = NULL;
+  d->count = 0;
+}
+
+static fs_result _pak_fs_info(fs* pfs, const char* path, int mode,
+                              fs_file_info* info) {
+  (void)mode;
+  const pak_fs_data* d = (const pak_fs_data*)fs_get_backend_data(pfs);
+  const char* p;
+  sz len = _pak_fs_path(path, FS_NULL_TERMINATED, &p);
+
+  *info = (fs_file_info){0};
+  const pak_fs_entry* e = _pak_fs_find(d, p, len);
+  if (e) {
+    info->size = (fs_uint64)e->size;
+    return FS_SUCCESS;
+  }
+  if (_pak_fs_is_dir(d, p, len)) {
+    info->directory = 1;
+    return FS_SUCCESS;
+  }
+  return FS_DOES_NOT_EXIST;
+}
+
+static size_t _pak_fs_file_alloc_size(fs* pfs) {
+  (void)pfs;
+  return sizeof(pak_fs_file);
+}
+
+static fs_result _pak_fs_file_open(fs* pfs, fs_stream* stream,
+                                   const char* path, int mode,
+                                   fs_file* file) {
+  if (mode & FS_WRITE)
+    return FS_INVALID_OPERATION;
+
+  const pak_fs_data* d = (const pak_fs_data*)fs_get_backend_data(pfs);
+  const char* p;
+  sz len = _pak_fs_path(path, FS_NULL_TERMINATED, &p);
+
+  const pak_fs_entry* e = _pak_fs_find(d, p, len);
+  if (!e)
+    return _pak_fs_is_dir(d, p, len) ? FS_IS_DIRECTORY : FS_DOES_NOT_EXIST;
+  if (!d->data && !stream)
+    return FS_INVALID_ARGS;
+
+  pak_fs_file* f = (pak_fs_file*)fs_file_get_backend_data(file);
+  *f = (pak_fs_file){.tag = PAK_FS_FILE_TAG,
+                     .stream = stream,
+                     .data = d->data ? d->data + e->offset : NULL,
+                     .offset = e->offset,
+                     .size = e->size};
+  return FS_SUCCESS;
+}
+
+static void _pak_fs_file_close(fs_file* file) { (void)file; }
+
+static fs_result _pak_fs_file_read(fs_file* file, void* dst, size_t len,
+                                   size_t* read) {
+  pak_fs_file* f = (pak_fs_file*)fs_file_get_backend_data(file);
+  i64 left = f->size - f->cursor;
+  sz n = left <= 0 ? 0 : (u64)left < len ? (sz)left : len;
+  *read = 0;
+  if (!n)
+    return FS_AT_END;
+
+  if (f->data) {
+    memcpy(dst, f->data + f->cursor, n);
+  } else {
+    fs_result r = _pak_fs_read_at(f->stream, dst, n, f->offset + f->cursor);
+    if (r != FS_SUCCESS)
+      return r;
+  }
+  f->cursor += (i64)n;
+  *read = n;
+  return FS_SUCCESS;
+}
+
+static fs_result _pak_fs_file_seek(fs_file* file, fs_int64 offset,
+                                   fs_seek_origin origin) {
+  pak_fs_file* f = (pak_fs_file*)fs_file_get_backend_data(file);
+  i64 at = offset;
+  if (origin == FS_SEEK_CUR)
+    at += f->cursor;
+  else if (origin == FS_SEEK_END)
+    at += f->size;
+  if (at < 0 || at > f->size)
+    return FS_BAD_SEEK;
+  f->cursor = at;
+  return FS_SUCCESS;
+}
+
+static fs_result _pak_fs_file_tell(fs_file* file, fs_int64* cursor) {
+  *cursor = ((pak_fs_file*)fs_file_get_backend_data(file))->cursor;
+  return FS_SUCCESS;
+}
+
+static fs_result _pak_fs_file_info(fs_file* file, fs_file_info* info) {
+  *info = (fs_file_info){0};
+  info->size = (fs_uint64)((pak_fs_file*)fs_file_get_backend_data(file))->size;
+  return FS_SUCCESS;
+}
+
+static fs_result _pak_fs_file_duplicate(fs_file* file, fs_file* dup) {
+  pak_fs_file* f = (pak_fs_file*)fs_file_get_backend_data(file);
+  pak_fs_file* g = (pak_fs_file*)fs_file_get_backend_data(dup);
+  // the archive stream belongs to the original handle, only mapped entries
+  // can be shared
+  if (!f->data)
+    return FS_NOT_IMPLEMENTED;
+  *g = *f;
+  g->stream = NULL;
+  return FS_SUCCESS;
+}
+
+// Yields each name directly below the prefix once. Entries of a deeper
+// directory collapse into that directory, the sorted table keeps them next
+// to each other
+static fs_iterator* _pak_fs_step(pak_fs_iterator* it) {
+  const pak_fs_data* d = it->pak;
+  for (; it->next < d->count; it->next++) {
+    const pak_fs_entry* e = &d->entries[it->next];
+    if (strncmp(e->name, it->prefix, it->prefix_len))
+      break;
+
+    const char* rest = e->name + it->prefix_len;
+    const char* sl = strchr(rest, '/');
+    sz n = sl ? (sz)(sl - rest) : strlen(rest);
+    bool dir = sl != NULL;
+    if (!n || (it->base.pName && it->base.info.directory == dir &&
+               strlen(it->name) == n && !strncmp(it->name, rest, n)))
+      continue;
+
+    memcpy(it->name, rest, n);
+    it->name[n] = '\0';
+    it->base.pName = it->name;
+    it->base.nameLen = n;
+    it->base.info = (fs_file_info){0};
+    it->base.info.directory = dir;
+    it->base.info.size = dir ? 0 : (fs_uint64)e->size;
+    it->next++;
+    return &it->base;
+  }
+
+  fs_free(it, fs_get_allocation_callbacks(it->base.pFS));
+  return NULL;
+}
+
+static fs_iterator* _pak_fs_first(fs* pfs, const char* path, size_t len) {
+  const pak_fs_data* d = (const pak_fs_data*)fs_get_backend_data(pfs);
+  const char* p;
+  len = _pak_fs_path(path, len, &p);
+  if (len >= ENTRY_NAME_LEN || !_pak_fs_is_dir(d, p, len))
+    return NULL;
+
+  pak_fs_iterator* it = (pak_fs_iterator*)fs_calloc(
+      sizeof(pak_fs_iterator), fs_get_allocation_callbacks(pfs));
+  if (!it)
+    return NULL;
+
+  it->base.pFS = pfs;
+  it->pak = d;
+  memcpy(it->prefix, p, len);
+  if (len)
+    it->prefix[len++] = '/';
+  it->prefix_len = (u32)len;
+  it->next = _pak_fs_lower(d, it->prefix, len);
+  return _pak_fs_step(it);
+}
+
+static fs_iterator* _pak_fs_next(fs_iterator* it) {
+  return _pak_fs_step((pak_fs_iterator*)it);
+}
+
+static void _pak_fs_free_iterator(fs_iterator* it) {
+  fs_free(it, fs_get_allocation_callbacks(it->pFS));
+}
+
+static const fs_backend _pak_fs_backend = {
+    .alloc_size = _pak_fs_alloc_size,
+    .init = _pak_fs_init,
+    .uninit = _pak_fs_uninit,
+    .info = _pak_fs_info,
+    .file_alloc_size = _pak_fs_file_alloc_size,
+    .file_open = _pak_fs_file_open,
+    .file_close = _pak_fs_file_close,
+    .file_read = _pak_fs_file_read,
+    .file_seek = _pak_fs_file_seek,
+    .file_tell = _pak_fs_file_tell,
+    .file_info = _pak_fs_file_info,
+    .file_duplicate = _pak_fs_file_duplicate,
+    .first = _pak_fs_first,
+    .next = _pak_fs_next,
+    .free_iterator = _pak_fs_free_iterator,
+};
+
+/*****************************
+ * EXPORTED FUNCTIONS
+ *****************************/
+
+const fs_backend* PAK_FS = &_pak_fs_backend;
+
+fs_result pak_fs_mount(fs* pfs, cstr path, cstr vpath, pak_fs_mapped* m) {
+  file_view_open(path, &m->view);
+  m->config = (pak_fs_config){.data = m->view.data, .size = m->view.size};
+
+  fs_result r = fs_open_archive_ex(pfs, PAK_FS, &m->config, path,
+                                   FS_NULL_TERMINATED, FS_READ | FS_VERBOSE,
+                                   &m->archive);
+  if (r == FS_SUCCESS)
+    r = fs_mount_fs(pfs, m->archive, vpath, FS_READ);
+  if (r != FS_SUCCESS) {
+    if (m->archive)
+      fs_close_archive(m->archive);
+    m->archive = NULL;
+    file_view_close(&m->view);
+  }
+  return r;
+}
+
+void pak_fs_unmount(fs* pfs, pak_fs_mapped* m) {
+  if (!m->archive)
+    return;
+  fs_unmount_fs(pfs, m->archive, FS_READ);
+  fs_close_archive(m->archive);
+  m->archive = NULL;
+  file_view_close(&m->view);
+}
+
+const u8* pak_fs_file_data(fs_file* file, sz* size) {
+  // archives are wrapped in a proxy that appends its own data, ours still
+  // comes first
+  if (fs_file_get_backend_data_size(file) < sizeof(pak_fs_file))
+    return NULL;
+  pak_fs_file* f = (pak_fs_file*)fs_file_get_backend_data(file);
+  if (f->tag != PAK_FS_FILE_TAG)
+    return NULL;
+
+  if (size)
+    *size = (sz)f->size;
+  return f->data;
+}
+
+#endif  // PAK_FS_IMPLEMENTATION
+#endif  //_PAK_FS_HEADER_
@@ -0,0 +1,3 @@
+#define PAKZ_IMPLEMENTATION
+
+#include "pakz.h"
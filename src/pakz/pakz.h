@@ -0,0 +1,504 @@
+#ifndef _PAKZ_HEADER_
+#define _PAKZ_HEADER_
+
+#include <string.h>
+#include <stddef.h>
+
+#include "../../deps/fs.h"
+#include "../utils/types.h"
+#include "../utils/io.h"
+#include "../utils/macros.h"
+#include "../utils/arena.h"
+#include "../utils/endian.h"
+#include "../utils/thread.h"
+#include "../img/png.h"
+#include "../pak/pak.h"
+
+// A pak kept compressed at rest. The pak's bytes are cut into fixed chunks
+// that are deflated independently, so any range of the pak can be read back
+// by inflating only the chunks it overlaps:
+//
+//   "PAKZ" version | chunk data... | chunk table | pak directory | trailer
+//
+// The chunk table holds chunk_count + 1 file offsets followed by one crc32
+// per chunk, a chunk whose stored length equals its raw length is stored.
+// The directory is a verbatim copy of the pak's own, its offsets address
+// the uncompressed pak, so entries are found without inflating anything.
+static constexpr u8 PAKZ_MAGIC[] = "PAKZ";
+static constexpr u32 PAKZ_MAGIC_LEN = 4;
+static constexpr i32 PAKZ_VERSION = 1;
+static constexpr u32 PAKZ_PREFIX_LEN = 8;
+static constexpr u32 PAKZ_TRAILER_LEN = 40;
+static constexpr u32 PAKZ_CHUNK_MIN = 64 * 1024;
+static constexpr u32 PAKZ_CHUNK_MAX = 256 * 1024;
+static constexpr u32 PAKZ_CHUNK_DEFAULT = 128 * 1024;
+static constexpr u32 PAKZ_BATCH = 64;  // chunks compressed between writes
+
+typedef enum pakzerr { PAKZ_ERR_UNKNOWN = -1, PAKZ_ERR_OK = 0 } pakzerr;
+
+typedef struct {
+  i64 raw_size;      // size of the pak the chunks inflate to
+  i64 table_offset;  // chunk offsets, then chunk crcs
+  i64 dir_offset;    // copy of the pak directory
+  i32 chunk_size;
+  i32 chunk_count;
+  i32 dir_size;
+  u8 magic[PAKZ_MAGIC_LEN];
+} pakz_trailer;
+
+static_assert(sizeof(pakz_trailer) == PAKZ_TRAILER_LEN,
+              "pakz_trailer must match disk");
+
+typedef struct pakz_s {
+  file_view view;
+  pakz_trailer trailer;
+  i64* offsets;  // chunk_count + 1 file offsets (arena)
+  u32* crcs;     // chunk_count crc32 of the raw chunks (arena)
+  pak_entry* entries;
+  u32 entries_count;
+} pakz;
+
+typedef struct {
+  u32 chunk;    // deflate: chunk size in bytes
+  u32 level;    // deflate: 0 stores every chunk
+  bool direct;  // write outputs with O_DIRECT, bypassing the page cache
+} pakz_opts;
+
+/* ****************** pakz API ****************** */
+
+void pakz_open(arena*, cstr, pakz*);
+void pakz_close(pakz*);
+i32 pakz_find(pakz*, cstr);
+
+// Copies 'len' bytes at 'offset' of the packed pak into 'dst', inflating
+// only the chunks that overlap the range, spread over the workers
+void pakz_read(pakz*, u64, u64, u8*);
+
+pakzerr pakz_deflate(arena*, cstr, cstr, const pakz_opts*, pakz*);
+pakzerr pakz_inflate(arena*, cstr, cstr, const pakz_opts*, pakz*);
+// Writes the named entries back to back to 'out', stdout when NULL
+pakzerr pakz_cat(arena*, cstr, cstr*, u32, cstr, pakz*);
+
+/* ****************** pakz API ****************** */
+
+//  _                 _                           _        _   _
+// (_)               | |                         | |      | | (_)
+//  _ _ __ ___  _ __ | | ___ _ __ ___   ___ _ __ | |_ __ _| |_ _  ___  _ __
+// | | '_ ` _ \| '_ \| |/ _ \ '_ ` _ \ / _ \ '_ \| __/ _` | __| |/ _ \| '_ \
+// | | | | | | | |_) | |  __/ | | | | |  __/ | | | || (_| | |_| | (_) | | | |
+// |_|_| |_| |_| .__/|_|\___|_| |_| |_|\___|_| |_|\__\__,_|\__|_|\___/|_| |_|
+//             | |
+//             |_|
+
+#ifdef PAKZ_IMPLEMENTATION
+
+// both live in deps/stb.c, stb keeps them out of its public headers
+unsigned char* stbi_zlib_compress(unsigned char*, int, int*, int);
+int stbi_zlib_decode_noheader_buffer(char*, int, const char*, int);
+
+/*****************************
+ * HIDDEN FUNCTIONS
+ *****************************/
+
+static u64 _pakz_chunk_len(const pakz_trailer* t, u32 c) {
+  u64 lo = (u64)c * (u64)t->chunk_size;
+  u64 hi = lo + (u64)t->chunk_size;
+  return (hi < (u64)t->raw_size ? hi : (u64)t->raw_size) - lo;
+}
+
+static void _pakz_read_trailer(pakz* z) {
+  file_view* v = &z->view;
+  makesure(v->size >= PAKZ_PREFIX_LEN + PAKZ_TRAILER_LEN &&
+               !memcmp(v->data, PAKZ_MAGIC, PAKZ_MAGIC_LEN),
+           "not a pakz archive");
+  i32 version;
+  memcpy(&version, v->data + PAKZ_MAGIC_LEN, 4);
+  makesure(endian_i32(version) == PAKZ_VERSION,
+           "unsupported pakz version '%d'", endian_i32(version));
+
+  pakz_trailer* t = &z->trailer;
+  memcpy(t, v->data + v->size - PAKZ_TRAILER_LEN, PAKZ_TRAILER_LEN);
+  makesure(!memcmp(t->magic, PAKZ_MAGIC, PAKZ_MAGIC_LEN),
+           "the pakz trailer is missing, the archive is truncated");
+  t->raw_size = endian_i64(t->raw_size);
+  t->table_offset = endian_i64(t->table_offset);
+  t->dir_offset = endian_i64(t->dir_offset);
+  endian_i32_fields(t, 1, sizeof(*t), offsetof(pakz_trailer, chunk_size), 3);
+
+  i64 end = (i64)(v->size - PAKZ_TRAILER_LEN);
+  makesure(t->chunk_size >= (i32)PAKZ_CHUNK_MIN &&
+               t->chunk_size <= (i32)PAKZ_CHUNK_MAX,
+           "invalid chunk size '%d'", t->chunk_size);
+  makesure(t->raw_size >= 0 &&
+               t->chunk_count ==
+                   (t->raw_size + t->chunk_size - 1) / t->chunk_size,
+           "the chunk count does not cover the packed pak");
+  makesure(t->table_offset >= (i64)PAKZ_PREFIX_LEN &&
+               t->table_offset + (i64)t->chunk_count * 12 + 8 <=
+                   t->dir_offset &&
+               t->dir_size >= 0 && t->dir_offset + t->dir_size <= end,
+           "invalid chunk table or directory offset");
+}
+
+static void _pakz_estimate(arena* m, pakz* z) {
+  u32 cc = (u32)z->trailer.chunk_count;
+  arena_begin_estimate(m);
+  arena_estimate_add(m, (cc + 1) * sizeof(i64), alignof(i64));
+  arena_estimate_add(m, cc * sizeof(u32) + 1, alignof(u32));
+  arena_estimate_add(m, (sz)z->trailer.dir_size + 1, alignof(pak_entry));
+  arena_end_estimate(m);
+}
+
+static void _pakz_read_tables(arena* m, pakz* z) {
+  pakz_trailer* t = &z->trailer;
+  u32 cc = (u32)t->chunk_count;
+  const u8* table = z->view.data + t->table_offset;
+
+  z->offsets = (i64*)arena_alloc(m, (cc + 1) * sizeof(i64), alignof(i64));
+  z->crcs = (u32*)arena_alloc(m, cc * sizeof(u32) + 1, alignof(u32));
+  notnull(z->offsets);
+  notnull(z->crcs);
+
+  memcpy(z->offsets, table, (cc + 1) * sizeof(i64));
+  memcpy(z->crcs, table + (cc + 1) * sizeof(i64), cc * sizeof(u32));
+  i64 prev = PAKZ_PREFIX_LEN;
+  for (u32 c = 0; c <= cc; c++) {
+    z->offsets[c] = endian_i64(z->offsets[c]);
+    makesure(z->offsets[c] >= prev && z->offsets[c] <= t->table_offset,
+             "chunk '%u' is out of bounds", c);
+    prev = z->offsets[c];
+  }
+  endian_i32_array((i32*)z->crcs, z->crcs, cc);
+
+  z->entries_count = (u32)t->dir_size / ENTRY_LEN;
+  z->entries = (pak_entry*)arena_alloc(m, (sz)t->dir_size + 1,
+                                       alignof(pak_entry));
+  notnull(z->entries);
+  memcpy(z->entries, z->view.data + t->dir_offset,
+         (sz)z->entries_count * ENTRY_LEN);
+  endian_i32_fields(z->entries, z->entries_count, sizeof(pak_entry),
+                    offsetof(pak_entry, offset), 2);
+}
+
+static void _pakz_inflate_chunk(pakz* z, u32 c, u8* out) {
+  u64 rlen = _pakz_chunk_len(&z->trailer, c);
+  u64 clen = (u64)(z->offsets[c + 1] - z->offsets[c]);
+  const u8* src = z->view.data + z->offsets[c];
+
+  if (clen == rlen) {
+    memcpy(out, src, rlen);
+  } else {
+    int n = stbi_zlib_decode_noheader_buffer((char*)out, (int)rlen,
+                                             (const char*)src, (int)clen);
+    makesure(n >= 0 && (u64)n == rlen, "chunk '%u' does not inflate", c);
+  }
+  makesure(png_crc32(0, out, rlen) == z->crcs[c], "chunk '%u' is corrupt", c);
+}
+
+typedef struct {
+  pakz* z;
+  u64 offset;
+  u64 len;
+  u8* dst;
+  u32 first;
+} pakz_read_job;
+
+// Chunks fully inside the range inflate straight into place, the two ends
+// go through a scratch buffer and only their overlap is copied
+static void _pakz_read_chunk(void* ctx, u32 i, u32 worker) {
+  pakz_read_job* job = (pakz_read_job*)ctx;
+  u32 c = job->first + i;
+  u64 lo = (u64)c * (u64)job->z->trailer.chunk_size;
+  u64 hi = lo + _pakz_chunk_len(&job->z->trailer, c);
+  u64 a = lo > job->offset ? lo : job->offset;
+  u64 b = hi < job->offset + job->len ? hi : job->offset + job->len;
+
+  if (a == lo && b == hi) {
+    _pakz_inflate_chunk(job->z, c, job->dst + (lo - job->offset));
+    return;
+  }
+
+  u8* tmp = (u8*)malloc(hi - lo);
+  makesure(tmp != NULL, "malloc failed");
+  _pakz_inflate_chunk(job->z, c, tmp);
+  memcpy(job->dst + (a - job->offset), tmp + (a - lo), b - a);
+  free(tmp);
+}
+
+typedef struct {
+  const u8* raw;
+  u64 raw_size;
+  u32 chunk;
+  u32 first;
+  u32 level;
+  u8* out[PAKZ_BATCH];  // NULL when the chunk is stored
+  u64 out_len[PAKZ_BATCH];
+  u32 crc[PAKZ_BATCH];
+} pakz_deflate_job;
+
+static void _pakz_deflate_chunk(void* ctx, u32 i, u32 worker) {
+  pakz_deflate_job* job = (pakz_deflate_job*)ctx;
+  u64 lo = (u64)(job->first + i) * job->chunk;
+  u64 rlen = job->raw_size - lo < job->chunk ? job->raw_size - lo : job->chunk;
+  const u8* src = job->raw + lo;
+
+  job->crc[i] = png_crc32(0, src, rlen);
+  job->out[i] = NULL;
+  job->out_len[i] = rlen;
+  if (job->level == 0)
+    return;
+
+  // stb frames the stream as zlib, the container wants raw deflate
+  int zl = 0;
+  u8* zb = stbi_zlib_compress((u8*)src, (int)rlen, &zl, (int)job->level * 4);
+  makesure(zb != NULL, "deflate failed");
+  if (zl > 6 && (u64)zl - 6 < rlen) {
+    job->out[i] = zb;
+    job->out_len[i] = (u64)zl - 6;
+  } else {
+    free(zb);
+  }
+}
+
+// Just enough of pak_open to find the directory, the pak is packed as is
+static void _pakz_pak_dir(const file_view* v, cstr path, i32* of, i32* size) {
+  makesure(
+      v->size >= HEADER_LEN && !memcmp(v->data, MAGIC_CODE, MAGIC_CODE_LEN),
+      "'%s' is not a pak", path);
+  pak_header h;
+  memcpy(&h, v->data, HEADER_LEN);
+  *of = endian_i32(h.offset);
+  *size = endian_i32(h.size);
+  makesure(*of >= (i32)HEADER_LEN && *size >= 0 &&
+               (sz)*of + (sz)*size <= v->size && *size % ENTRY_LEN == 0,
+           "invalid directory in '%s'", path);
+}
+
+/*****************************
+ * EXPORTED FUNCTIONS
+ *****************************/
+
+void pakz_open(arena* m, cstr path, pakz* z) {
+  file_view_open(path, &z->view);
+  _pakz_read_trailer(z);
+  _pakz_estimate(m, z);
+  _pakz_read_tables(m, z);
+}
+
+void pakz_close(pakz* z) {
+  if (z->view.fd >= 0)
+    file_view_close(&z->view);
+  z->view = (file_view){.fd = -1};
+  z->offsets = NULL;
+  z->crcs = NULL;
+  z->entries = NULL;
+  z->entries_count = 0;
+}
+
+i32 pakz_find(pakz* z, cstr name) {
+  // the first entry with a name wins, the engine searches a pak directory
+  // front to back
+  for (u32 i = 0; i < z->entries_count; i++) {
+    if (!strncmp((cstr)z->entries[i].name, name, ENTRY_NAME_LEN))
+      return (i32)i;
+  }
+  return -1;
+}
+
+void pakz_read(pakz* z, u64 offset, u64 len, u8* dst) {
+  makesure(offset + len <= (u64)z->trailer.raw_size,
+           "read past the end of the packed pak");
+  if (len == 0)
+    return;
+
+  u64 cs = (u64)z->trailer.chunk_size;
+  u32 first = (u32)(offset / cs);
+  u32 last = (u32)((offset + len - 1) / cs);
+  for (u32 c = first; c <= last; c++)
+    file_view_advise(&z->view, (u64)z->offsets[c],
+                     (u64)(z->offsets[c + 1] - z->offsets[c]),
+                     FILE_ADVICE_WILLNEED);
+
+  pakz_read_job job = {
+      .z = z, .offset = offset, .len = len, .dst = dst, .first = first};
+  thread_parallel_for(last - first + 1, _pakz_read_chunk, &job);
+}
+
+pakzerr pakz_deflate(arena* m,
+                     cstr path,
+                     cstr opath,
+                     const pakz_opts* o,
+                     pakz* z) {
+  u32 cs = o->chunk ? o->chunk : PAKZ_CHUNK_DEFAULT;
+  makesure(cs >= PAKZ_CHUNK_MIN && cs <= PAKZ_CHUNK_MAX,
+           "the chunk size must be between '%u' and '%u' KB",
+           PAKZ_CHUNK_MIN / 1024, PAKZ_CHUNK_MAX / 1024);
+
+  file_view v;
+  file_view_open(path, &v);
+  i32 dof, dsize;
+  _pakz_pak_dir(&v, path, &dof, &dsize);
+  file_view_advise(&v, 0, v.size, FILE_ADVICE_SEQUENTIAL);
+
+  u64 cc = ((u64)v.size + cs - 1) / cs;
+  makesure(cc <= INT32_MAX, "the pak has too many chunks");
+
+  // the table is small, it is collected in the arena and written at the end
+  arena_begin_estimate(m);
+  arena_estimate_add(m, (cc + 1) * sizeof(i64), alignof(i64));
+  arena_estimate_add(m, cc * sizeof(u32) + 1, alignof(u32));
+  arena_end_estimate(m);
+  z->offsets = (i64*)arena_alloc(m, (cc + 1) * sizeof(i64), alignof(i64));
+  z->crcs = (u32*)arena_alloc(m, cc * sizeof(u32) + 1, alignof(u32));
+  notnull(z->offsets);
+  notnull(z->crcs);
+
+  file_writer w;
+  file_writer_open(opath, &(file_writer_opts){.direct = o->direct}, &w);
+  u8 prefix[PAKZ_PREFIX_LEN];
+  memcpy(prefix, PAKZ_MAGIC, PAKZ_MAGIC_LEN);
+  i32 version = endian_i32(PAKZ_VERSION);
+  memcpy(prefix + PAKZ_MAGIC_LEN, &version, 4);
+  file_writer_write(&w, prefix, PAKZ_PREFIX_LEN);
+
+  // batches keep memory bounded and the chunks in order whatever -j is
+  pakz_deflate_job job = {
+      .raw = v.data, .raw_size = v.size, .chunk = cs, .level = o->level};
+  for (u64 c = 0; c < cc; c += PAKZ_BATCH) {
+    u32 n = cc - c < PAKZ_BATCH ? (u32)(cc - c) : PAKZ_BATCH;
+    job.first = (u32)c;
+    thread_parallel_for(n, _pakz_deflate_chunk, &job);
+
+    for (u32 i = 0; i < n; i++) {
+      z->offsets[c + i] = (i64)file_writer_tell(&w);
+      z->crcs[c + i] = job.crc[i];
+      if (job.out[i]) {
+        file_writer_write(&w, job.out[i] + 2, job.out_len[i]);
+        free(job.out[i]);
+      } else {
+        file_writer_write(&w, v.data + (c + i) * cs, job.out_len[i]);
+      }
+    }
+    file_view_advise(&v, c * cs, (u64)n * cs, FILE_ADVICE_DONTNEED);
+  }
+  z->offsets[cc] = (i64)file_writer_tell(&w);
+
+  pakz_trailer t = {.raw_size = endian_i64((i64)v.size),
+                    .table_offset = endian_i64(z->offsets[cc]),
+                    .chunk_size = endian_i32((i32)cs),
+                    .chunk_count = endian_i32((i32)cc),
+                    .dir_size = endian_i32(dsize)};
+  memcpy(t.magic, PAKZ_MAGIC, PAKZ_MAGIC_LEN);
+
+  for (u64 c = 0; c <= cc; c++) {
+    i64 of = endian_i64(z->offsets[c]);
+    file_writer_write(&w, &of, sizeof(of));
+  }
+  for (u64 c = 0; c < cc; c++) {
+    i32 crc = endian_i32((i32)z->crcs[c]);
+    file_writer_write(&w, &crc, sizeof(crc));
+  }
+  t.dir_offset = endian_i64((i64)file_writer_tell(&w));
+  file_writer_write(&w, v.data + dof, dsize);
+  file_writer_write(&w, &t, PAKZ_TRAILER_LEN);
+  u64 osize = file_writer_tell(&w);
+  file_writer_close(&w);
+
+  printf("************** DEFLATE **************\n");
+  printf("↬ file name:      '%s'\n", path);
+  printf("↬ output:         '%s'\n", opath);
+  printf("↬ chunks:         '%llu' of %u KB\n", (unsigned long long)cc,
+         cs / 1024);
+  printf("↬ file size:      '%llu MB (%llu Bytes)'\n",
+         (unsigned long long)(osize / 1000000), (unsigned long long)osize);
+  if (v.size)
+    printf("↬ ratio:          '%.1f%%'\n", 100.0 * (f64)osize / (f64)v.size);
+
+  file_view_close(&v);
+  return PAKZ_ERR_OK;
+}
+
+pakzerr pakz_inflate(arena* m,
+                     cstr path,
+                     cstr opath,
+                     const pakz_opts* o,
+                     pakz* z) {
+  pakz_open(m, path, z);
+
+  u64 raw = (u64)z->trailer.raw_size;
+  u64 step = (u64)PAKZ_BATCH * (u64)z->trailer.chunk_size;
+  u8* buf = (u8*)malloc(step);
+  makesure(buf != NULL, "malloc failed");
+
+  file_writer w;
+  file_writer_opts wo = {.prealloc = raw, .direct = o && o->direct};
+  file_writer_open(opath, &wo, &w);
+  for (u64 at = 0; at < raw; at += step) {
+    u64 n = raw - at < step ? raw - at : step;
+    pakz_read(z, at, n, buf);
+    file_writer_write(&w, buf, n);
+  }
+  file_writer_close(&w);
+  free(buf);
+
+  printf("************** INFLATE **************\n");
+  printf("↬ file name:      '%s'\n", path);
+  printf("↬ output:         '%s'\n", opath);
+  printf("↬ file size:      '%llu MB (%llu Bytes)'\n",
+         (unsigned long long)(raw / 1000000), (unsigned long long)raw);
+  printf("↬ entries counts: '%u'\n", z->entries_count);
+
+  pakz_close(z);
+  return PAKZ_ERR_OK;
+}
+
+pakzerr pakz_cat(arena* m,
+                 cstr path,
+                 cstr* names,
+                 u32 count,
+                 cstr out,
+                 pakz* z) {
+  pakz_open(m, path, z);
+
+  i32* found = (i32*)malloc((count ? count : 1) * sizeof(i32));
+  makesure(found != NULL, "malloc failed");
+  u64 most = 0;
+  for (u32 i = 0; i < count; i++) {
+    found[i] = pakz_find(z, names[i]);
+    makesure(found[i] >= 0, "no entry named '%s' in '%s'", names[i], path);
+    pak_entry* e = &z->entries[found[i]];
+    makesure(e->offset >= 0 && e->size >= 0 &&
+                 (u64)e->offset + (u64)e->size <= (u64)z->trailer.raw_size,
+             "entry '%.56s' is out of bounds", e->name);
+    most = (u64)e->size > most ? (u64)e->size : most;
+  }
+
+  u8* buf = (u8*)malloc(most ? most : 1);
+  makesure(buf != NULL, "malloc failed");
+
+  file_writer w;
+  FILE* so = stdout;
+  if (out)
+    file_writer_open(out, &(file_writer_opts){0}, &w);
+  for (u32 i = 0; i < count; i++) {
+    pak_entry* e = &z->entries[found[i]];
+    pakz_read(z, (u64)e->offset, (u64)e->size, buf);
+    if (out)
+      file_writer_write(&w, buf, e->size);
+    else
+      makesure(fwrite(buf, 1, e->size, so) == (sz)e->size,
+               "failed to write '%.56s' to stdout", e->name);
+  }
+  if (out)
+    file_writer_close(&w);
+  else
+    fflush(so);
+
+  free(buf);
+  free(found);
+  pakz_close(z);
+  return PAKZ_ERR_OK;
+}
+
+#endif  // PAKZ_IMPLEMENTATION
+#endif  //_PAKZ_HEADER_
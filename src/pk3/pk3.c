@@ -0,0 +1,3 @@
+#define PK3_IMPLEMENTATION
+
+#include "pk3.h"
@@ -0,0 +1,567 @@
+#ifndef _PK3_HEADER_
+#define _PK3_HEADER_
+
+#include <string.h>
+#include <stddef.h>
+
+#include "../../deps/fs.h"
+#include "../utils/types.h"
+#include "../utils/io.h"
+#include "../utils/macros.h"
+#include "../utils/arena.h"
+#include "../utils/hash.h"
+#include "../utils/thread.h"
+#include "../img/png.h"
+
+static constexpr u32 PK3_EOCD_SIG = 0x06054b50;   // end of central directory
+static constexpr u32 PK3_CDIR_SIG = 0x02014b50;   // central directory record
+static constexpr u32 PK3_LOCAL_SIG = 0x04034b50;  // local file header
+static constexpr u32 PK3_EOCD_LEN = 22;
+static constexpr u32 PK3_CDIR_LEN = 46;
+static constexpr u32 PK3_LOCAL_LEN = 30;
+static constexpr u32 PK3_MAX_COMMENT = 65535;
+static constexpr u32 PK3_MAX_PATH_LEN = 1024;
+static constexpr u16 PK3_METHOD_STORE = 0;
+static constexpr u16 PK3_METHOD_DEFLATE = 8;
+static constexpr u16 PK3_FLAG_ENCRYPTED = 1;
+static constexpr u16 PK3_VERSION = 20;      // 2.0, deflate and directories
+static constexpr u16 PK3_DOS_DATE = 0x21;   // 1980-01-01, keeps output stable
+static constexpr u32 PK3_MAX_ENTRIES = 65534;
+
+typedef enum pk3err { PK3_ERR_UNKNOWN = -1, PK3_ERR_OK = 0 } pk3err;
+
+// One central directory record, names point into the mapped archive and are
+// not NUL terminated
+typedef struct {
+  const u8* name;
+  u32 name_len;
+  u16 method;
+  u16 flags;
+  u32 crc;
+  u64 csize;   // bytes stored in the archive
+  u64 usize;   // bytes once inflated
+  u64 header;  // offset of the local header, the data follows it
+} pk3_entry;
+
+typedef struct pk3_s {
+  file_view view;      // whole archive, entries are inflated straight from it
+  pk3_entry* entries;  // decoded central directory (arena)
+  u32 entries_count;
+  u64 cdir_offset;
+  u64 cdir_size;
+} pk3;
+
+typedef struct {
+  bool direct;  // write outputs with O_DIRECT, bypassing the page cache
+} pk3_opts;
+
+/* ****************** pk3 API ****************** */
+
+// Opening maps the file and decodes the central directory, which sits in one
+// contiguous run at the end of the archive
+void pk3_open(arena*, cstr, pk3*);
+void pk3_close(pk3*);
+
+// Stored or deflated bytes of an entry inside the mapping, NULL if its local
+// header does not add up
+const u8* pk3_entry_data(pk3*, const pk3_entry*);
+// Inflates (or copies) an entry into 'dst' of usize bytes and checks its crc
+bool pk3_read(pk3*, const pk3_entry*, u8*);
+// False for entries pk3_read cannot decode: encrypted, or neither stored nor
+// deflated
+bool pk3_supported(const pk3_entry*);
+cstr pk3_method_name(u16);
+
+// Record writers, the inverse of what pk3_open reads, each fills 'buf' and
+// returns the bytes used; the local header needs as much room as the
+// name plus PK3_LOCAL_LEN, the directory record plus PK3_CDIR_LEN
+u32 pk3_put_local(u8*, const pk3_entry*);
+u32 pk3_put_cdir(u8*, const pk3_entry*);
+u32 pk3_put_eocd(u8*, u32, u64, u64);
+
+pk3err pk3_info(arena*, cstr, pk3*);
+pk3err pk3_list(arena*, cstr, pk3*);
+pk3err pk3_extract(arena*, cstr, cstr, const pk3_opts*, pk3*);
+
+/* ****************** pk3 API ****************** */
+
+//  _                 _                           _        _   _
+// (_)               | |                         | |      | | (_)
+//  _ _ __ ___  _ __ | | ___ _ __ ___   ___ _ __ | |_ __ _| |_ _  ___  _ __
+// | | '_ ` _ \| '_ \| |/ _ \ '_ ` _ \ / _ \ '_ \| __/ _` | __| |/ _ \| '_ \
+// | | | | | | | |_) | |  __/ | | | | |  __/ | | | || (_| | |_| | (_) | | | |
+// |_|_| |_| |_| .__/|_|\___|_| |_| |_|\___|_| |_|\__\__,_|\__|_|\___/|_| |_|
+//             | |
+//             |_|
+
+#ifdef PK3_IMPLEMENTATION
+
+// stb_image implements inflate for PNG and exposes the raw stream decoder
+int stbi_zlib_decode_noheader_buffer(char*, int, const char*, int);
+
+/*****************************
+ * HIDDEN FUNCTIONS
+ *****************************/
+
+// zip is little endian and its records are packed, so fields are assembled
+// byte by byte instead of cast
+static u16 _pk3_u16(const u8* p) {
+  return (u16)(p[0] | p[1] << 8);
+}
+
+static u32 _pk3_u32(const u8* p) {
+  return (u32)p[0] | (u32)p[1] << 8 | (u32)p[2] << 16 | (u32)p[3] << 24;
+}
+
+// The end record is the last 22 bytes unless the archive carries a comment,
+// so the search walks back from there over at most one comment's length
+static const u8* _pk3_find_eocd(pk3* z) {
+  const u8* data = z->view.data;
+  sz size = z->view.size;
+  makesure(size >= PK3_EOCD_LEN, "file is too small to be a pk3");
+
+  sz stop = size - PK3_EOCD_LEN > PK3_MAX_COMMENT
+                ? size - PK3_EOCD_LEN - PK3_MAX_COMMENT
+                : 0;
+  for (sz at = size - PK3_EOCD_LEN + 1; at-- > stop;) {
+    const u8* p = data + at;
+    if (_pk3_u32(p) == PK3_EOCD_SIG &&
+        at + PK3_EOCD_LEN + _pk3_u16(p + 20) == size)
+      return p;
+  }
+  mustdie("no end of central directory record, not a pk3");
+  return NULL;
+}
+
+static void _pk3_read_eocd(pk3* z) {
+  const u8* e = _pk3_find_eocd(z);
+  makesure(_pk3_u16(e + 4) == 0 && _pk3_u16(e + 6) == 0,
+           "multi-disk archives are not supported");
+
+  u16 count = _pk3_u16(e + 10);
+  u32 size = _pk3_u32(e + 12);
+  u32 offset = _pk3_u32(e + 16);
+  makesure(count != 0xFFFF && size != 0xFFFFFFFF && offset != 0xFFFFFFFF,
+           "zip64 archives are not supported");
+  makesure((sz)offset + size <= (sz)(e - z->view.data),
+           "invalid central directory offset");
+
+  z->entries_count = count;
+  z->cdir_offset = offset;
+  z->cdir_size = size;
+}
+
+static void _pk3_estimate(arena* m, pk3* z) {
+  arena_begin_estimate(m);
+  arena_estimate_add(m, z->entries_count * sizeof(pk3_entry),
+                     alignof(pk3_entry));
+  arena_end_estimate(m);
+}
+
+// One pass over the central directory, nothing else in the archive is read
+static void _pk3_read_entries(arena* m, pk3* z) {
+  z->entries = (pk3_entry*)arena_alloc(
+      m, z->entries_count * sizeof(pk3_entry), alignof(pk3_entry));
+  notnull(z->entries);
+
+  const u8* p = z->view.data + z->cdir_offset;
+  const u8* end = p + z->cdir_size;
+  for (u32 i = 0; i < z->entries_count; i++) {
+    makesure(p + PK3_CDIR_LEN <= end && _pk3_u32(p) == PK3_CDIR_SIG,
+             "central directory record '%u' is corrupt", i);
+
+    u16 nl = _pk3_u16(p + 28);
+    u16 xl = _pk3_u16(p + 30);
+    u16 cl = _pk3_u16(p + 32);
+    makesure(p + PK3_CDIR_LEN + nl + xl + cl <= end,
+             "central directory record '%u' is truncated", i);
+
+    pk3_entry* e = &z->entries[i];
+    *e = (pk3_entry){.name = p + PK3_CDIR_LEN,
+                     .name_len = nl,
+                     .flags = _pk3_u16(p + 8),
+                     .method = _pk3_u16(p + 10),
+                     .crc = _pk3_u32(p + 16),
+                     .csize = _pk3_u32(p + 20),
+                     .usize = _pk3_u32(p + 24),
+                     .header = _pk3_u32(p + 42)};
+    makesure(e->csize != 0xFFFFFFFF && e->usize != 0xFFFFFFFF &&
+                 e->header != 0xFFFFFFFF,
+             "entry '%.*s' needs zip64, which is not supported", (int)nl,
+             e->name);
+
+    p += PK3_CDIR_LEN + nl + xl + cl;
+  }
+}
+
+static void _pk3_put16(u8* p, u16 v) {
+  p[0] = (u8)v;
+  p[1] = (u8)(v >> 8);
+}
+
+static void _pk3_put32(u8* p, u32 v) {
+  _pk3_put16(p, (u16)v);
+  _pk3_put16(p + 2, (u16)(v >> 16));
+}
+
+// The fields local headers and directory records share, from the version
+// needed to the name length
+static void _pk3_put_common(u8* p, const pk3_entry* e) {
+  _pk3_put16(p, PK3_VERSION);
+  _pk3_put16(p + 2, e->flags);
+  _pk3_put16(p + 4, e->method);
+  _pk3_put16(p + 6, 0);
+  _pk3_put16(p + 8, PK3_DOS_DATE);
+  _pk3_put32(p + 10, e->crc);
+  _pk3_put32(p + 14, (u32)e->csize);
+  _pk3_put32(p + 18, (u32)e->usize);
+  _pk3_put16(p + 22, (u16)e->name_len);
+}
+
+static bool _pk3_is_dir(const pk3_entry* e) {
+  return e->name_len && e->name[e->name_len - 1] == '/';
+}
+
+// Names come from the archive, so anything that could land outside the
+// output directory is refused rather than rewritten
+static bool _pk3_safe_name(const pk3_entry* e) {
+  if (!e->name_len || e->name[0] == '/' || e->name[0] == '\\')
+    return false;
+  for (u32 i = 0; i < e->name_len; i++) {
+    if (e->name[i] == '\\' || e->name[i] == ':' || !e->name[i])
+      return false;
+    bool start = i == 0 || e->name[i - 1] == '/';
+    if (start && i + 1 < e->name_len && e->name[i] == '.' &&
+        e->name[i + 1] == '.' &&
+        (i + 2 == e->name_len || e->name[i + 2] == '/'))
+      return false;
+  }
+  return true;
+}
+
+static void _pk3_entry_path(char* buf, cstr dir, const pk3_entry* e) {
+  i32 n = snprintf(buf, PK3_MAX_PATH_LEN * 2, "%s/%.*s", dir,
+                   (int)e->name_len, (cstr)e->name);
+  makesure(n > 0 && n < (i32)PK3_MAX_PATH_LEN * 2,
+           "entry '%.*s' path is too long", (int)e->name_len, e->name);
+}
+
+static void _pk3_make_parent_dirs(char* path) {
+  char* sl = strrchr(path, '/');
+  if (!sl)
+    return;
+  *sl = '\0';
+  makesure(fs_mkdir(NULL, path, 0) == FS_SUCCESS,
+           "failed to create directory '%s'", path);
+  *sl = '/';
+}
+
+typedef struct {
+  pk3* z;
+  cstr dir;
+  const pk3_opts* o;
+  bool* skip;  // entries the serial pass refused, indexed like z->entries
+  _Atomic u32 written;
+  _Atomic u32 failed;
+} pk3_extract_job;
+
+// Open addressing set over entry names, a slot holds entry index + 1. True
+// when an earlier entry already claimed the name of entry 'i'
+static bool _pk3_name_seen(const pk3* z, u32* set, u32 mask, u32 i) {
+  const pk3_entry* e = &z->entries[i];
+  for (u32 at = (u32)hash_bytes(e->name, e->name_len) & mask;;
+       at = (at + 1) & mask) {
+    u32 slot = set[at];
+    if (!slot) {
+      set[at] = i + 1;
+      return false;
+    }
+    const pk3_entry* o = &z->entries[slot - 1];
+    if (o->name_len == e->name_len && !memcmp(o->name, e->name, e->name_len))
+      return true;
+  }
+}
+
+// Workers only inflate and write, every directory already exists
+static void _pk3_extract_entry(void* ctx, u32 i, u32 worker) {
+  pk3_extract_job* job = (pk3_extract_job*)ctx;
+  const pk3_entry* e = &job->z->entries[i];
+  if (job->skip[i])
+    return;
+
+  // stored entries are checked and written straight out of the mapping
+  u8* buf = NULL;
+  const u8* out = pk3_entry_data(job->z, e);
+  if (out && e->method == PK3_METHOD_DEFLATE) {
+    buf = (u8*)malloc(e->usize ? e->usize : 1);
+    makesure(buf != NULL, "malloc failed");
+    out = buf;
+  }
+  if (!out || !pk3_read(job->z, e, buf)) {
+    log_warn("entry '%.*s' is corrupt, skipping it", (int)e->name_len,
+             e->name);
+    job->failed++;
+    free(buf);
+    return;
+  }
+
+  char path[PK3_MAX_PATH_LEN * 2];
+  _pk3_entry_path(path, job->dir, e);
+
+  sz is = (sz)e->usize;
+  file_writer fw;
+  file_writer_opts wo = {.flush_size = file_writer_flush_for(is),
+                         .prealloc = is,
+                         .direct = job->o && job->o->direct};
+  file_writer_open(path, &wo, &fw);
+  file_writer_write(&fw, out, is);
+  file_writer_close(&fw);
+
+  free(buf);
+  job->written++;
+}
+
+/*****************************
+ * EXPORTED FUNCTIONS
+ *****************************/
+
+void pk3_open(arena* m, cstr path, pk3* z) {
+  file_view_open(path, &z->view);
+  _pk3_read_eocd(z);
+  file_view_advise(&z->view, z->cdir_offset, z->cdir_size,
+                   FILE_ADVICE_WILLNEED);
+
+  _pk3_estimate(m, z);
+  _pk3_read_entries(m, z);
+}
+
+void pk3_close(pk3* z) {
+  if (z->view.fd >= 0)
+    file_view_close(&z->view);
+  z->view = (file_view){.fd = -1};
+  z->entries = NULL;
+  z->entries_count = 0;
+}
+
+const u8* pk3_entry_data(pk3* z, const pk3_entry* e) {
+  const u8* base = z->view.data;
+  sz size = z->view.size;
+  if (e->header + PK3_LOCAL_LEN > size)
+    return NULL;
+
+  // the local header repeats the name but may carry a different extra field
+  const u8* lh = base + e->header;
+  if (_pk3_u32(lh) != PK3_LOCAL_SIG)
+    return NULL;
+  u64 at = e->header + PK3_LOCAL_LEN + _pk3_u16(lh + 26) + _pk3_u16(lh + 28);
+  if (at + e->csize > size)
+    return NULL;
+  return base + at;
+}
+
+bool pk3_supported(const pk3_entry* e) {
+  return !(e->flags & PK3_FLAG_ENCRYPTED) &&
+         (e->method == PK3_METHOD_STORE || e->method == PK3_METHOD_DEFLATE);
+}
+
+bool pk3_read(pk3* z, const pk3_entry* e, u8* dst) {
+  const u8* src = pk3_entry_data(z, e);
+  if (!src || e->flags & PK3_FLAG_ENCRYPTED)
+    return false;
+
+  const u8* out = dst;
+  if (e->method == PK3_METHOD_STORE) {
+    if (e->csize != e->usize)
+      return false;
+    if (dst)
+      memcpy(dst, src, e->usize);
+    else
+      out = src;
+  } else if (e->method == PK3_METHOD_DEFLATE) {
+    if (!dst || e->usize > INT32_MAX || e->csize > INT32_MAX)
+      return false;
+    int n = stbi_zlib_decode_noheader_buffer((char*)dst, (int)e->usize,
+                                             (const char*)src, (int)e->csize);
+    if (n < 0 || (u64)n != e->usize)
+      return false;
+  } else {
+    return false;
+  }
+  return png_crc32(0, out, e->usize) == e->crc;
+}
+
+cstr pk3_method_name(u16 method) {
+  switch (method) {
+    case PK3_METHOD_STORE:
+      return "store";
+    case PK3_METHOD_DEFLATE:
+      return "deflate";
+    default:
+      return "unknown";
+  }
+}
+
+u32 pk3_put_local(u8* buf, const pk3_entry* e) {
+  _pk3_put32(buf, PK3_LOCAL_SIG);
+  _pk3_put_common(buf + 4, e);
+  _pk3_put16(buf + 28, 0);
+  memcpy(buf + PK3_LOCAL_LEN, e->name, e->name_len);
+  return PK3_LOCAL_LEN + e->name_len;
+}
+
+u32 pk3_put_cdir(u8* buf, const pk3_entry* e) {
+  _pk3_put32(buf, PK3_CDIR_SIG);
+  _pk3_put16(buf + 4, PK3_VERSION);
+  _pk3_put_common(buf + 6, e);
+  memset(buf + 30, 0, 12);  // extra, comment, disk, attributes
+  _pk3_put32(buf + 42, (u32)e->header);
+  memcpy(buf + PK3_CDIR_LEN, e->name, e->name_len);
+  return PK3_CDIR_LEN + e->name_len;
+}
+
+u32 pk3_put_eocd(u8* buf, u32 count, u64 cdir_size, u64 cdir_offset) {
+  _pk3_put32(buf, PK3_EOCD_SIG);
+  _pk3_put32(buf + 4, 0);  // this disk and the directory's disk
+  _pk3_put16(buf + 8, (u16)count);
+  _pk3_put16(buf + 10, (u16)count);
+  _pk3_put32(buf + 12, (u32)cdir_size);
+  _pk3_put32(buf + 16, (u32)cdir_offset);
+  _pk3_put16(buf + 20, 0);
+  return PK3_EOCD_LEN;
+}
+
+pk3err pk3_info(arena* m, cstr path, pk3* z) {
+  pk3_open(m, path, z);
+
+  u32 files = 0, dirs = 0, stored = 0, deflated = 0, other = 0;
+  u64 csize = 0, usize = 0;
+  for (u32 i = 0; i < z->entries_count; i++) {
+    pk3_entry* e = &z->entries[i];
+    if (_pk3_is_dir(e)) {
+      dirs++;
+      continue;
+    }
+    files++;
+    csize += e->csize;
+    usize += e->usize;
+    if (e->method == PK3_METHOD_STORE)
+      stored++;
+    else if (e->method == PK3_METHOD_DEFLATE)
+      deflated++;
+    else
+      other++;
+  }
+
+  printf("************** INFO **************\n");
+  printf("↬ file name:      '%s'\n", path);
+  printf("↬ file size:      '%zu MB (%zu Bytes)'\n", z->view.size / 1000000,
+         z->view.size);
+  printf("↬ entries counts: '%u' (%u files, %u directories)\n",
+         z->entries_count, files, dirs);
+  printf("↬   stored        '%u'\n", stored);
+  printf("↬   deflated      '%u'\n", deflated);
+  if (other)
+    printf("↬   unsupported   '%u'\n", other);
+  printf("↬ unpacked size:  '%llu MB (%llu Bytes)'\n",
+         (unsigned long long)(usize / 1000000), (unsigned long long)usize);
+  if (usize)
+    printf("↬ ratio:          '%.1f%%'\n", 100.0 * (f64)csize / (f64)usize);
+
+  pk3_close(z);
+  return PK3_ERR_OK;
+}
+
+pk3err pk3_list(arena* m, cstr path, pk3* z) {
+  pk3_open(m, path, z);
+
+  printf("************** ENTRIES **************\n");
+  printf("       (index | name | method | size)\n");
+  for (u32 i = 0; i < z->entries_count; i++) {
+    pk3_entry* e = &z->entries[i];
+    printf("↬ [%u] %.*s : %s : %.2f MB (%llu Bytes, %llu packed)\n", i + 1,
+           (int)e->name_len, (cstr)e->name, pk3_method_name(e->method),
+           (f32)e->usize / 1000000, (unsigned long long)e->usize,
+           (unsigned long long)e->csize);
+  }
+
+  pk3_close(z);
+  return PK3_ERR_OK;
+}
+
+pk3err pk3_extract(arena* m, cstr path, cstr odir, const pk3_opts* o, pk3* z) {
+  makesure(
+      strlen(odir) < PK3_MAX_PATH_LEN,
+      "output director '%s' path length is larger than supported max of '%d'",
+      odir, PK3_MAX_PATH_LEN);
+
+  fs_file_info od;
+  makesure(fs_info(NULL, odir, FS_READ, &od) != FS_SUCCESS,
+           "the output directory at '%s' already exists", odir);
+  makesure(fs_mkdir(NULL, odir, 0) == FS_SUCCESS,
+           "failed to create directory '%s'", odir);
+
+  pk3_open(m, path, z);
+  file_view_advise(&z->view, 0, z->view.size, FILE_ADVICE_SEQUENTIAL);
+
+  bool* skip = (bool*)calloc(z->entries_count ? z->entries_count : 1, 1);
+  makesure(skip != NULL, "malloc failed");
+  u32 sn = 16;
+  while (sn < z->entries_count * 2)
+    sn <<= 1;
+  u32* seen = (u32*)calloc(sn, sizeof(u32));
+  makesure(seen != NULL, "malloc failed");
+
+  // directories are created up front on one thread, so workers never race
+  // on a shared parent
+  char path_buf[PK3_MAX_PATH_LEN * 2];
+  for (u32 i = 0; i < z->entries_count; i++) {
+    pk3_entry* e = &z->entries[i];
+    if (!_pk3_safe_name(e)) {
+      log_warn("skipping unsafe entry name '%.*s'", (int)e->name_len,
+               e->name);
+      skip[i] = true;
+      continue;
+    }
+    // a repeated name would have two workers writing one file, keep the
+    // first entry and drop the rest
+    if (_pk3_name_seen(z, seen, sn - 1, i)) {
+      log_warn("skipping duplicate entry '%.*s'", (int)e->name_len, e->name);
+      skip[i] = true;
+      continue;
+    }
+    if (!pk3_supported(e)) {
+      log_warn("skipping '%.*s', %s entries are not supported",
+               (int)e->name_len, e->name,
+               e->flags & PK3_FLAG_ENCRYPTED ? "encrypted" : "compressed");
+      skip[i] = true;
+      continue;
+    }
+    _pk3_entry_path(path_buf, odir, e);
+    if (_pk3_is_dir(e)) {
+      path_buf[strlen(path_buf) - 1] = '\0';
+      makesure(fs_mkdir(NULL, path_buf, 0) == FS_SUCCESS,
+               "failed to create directory '%s'", path_buf);
+      skip[i] = true;
+      continue;
+    }
+    _pk3_make_parent_dirs(path_buf);
+  }
+
+  pk3_extract_job job = {.z = z, .dir = odir, .o = o, .skip = skip};
+  thread_parallel_for(z->entries_count, _pk3_extract_entry, &job);
+  free(seen);
+  free(skip);
+
+  printf("************** EXTRACT **************\n");
+  printf("↬ file name:      '%s'\n", path);
+  printf("↬ entries counts: '%u'\n", z->entries_count);
+  printf("↬ files written:  '%u'\n", (u32)job.written);
+  if (job.failed)
+    printf("↬ corrupt:        '%u'\n", (u32)job.failed);
+
+  pk3_close(z);
+  return job.failed ? PK3_ERR_UNKNOWN : PK3_ERR_OK;
+}
+
+#endif  // PK3_IMPLEMENTATION
+#endif  //_PK3_HEADER_
@@ -6,5 +6,9 @@
 #include "endian.h"
 #include "macros.h"
 #include "io.h"
+#include "hash.h"
+#include "pool.h"
+#include "intern.h"
+#include "thread.h"
 
 #endif  // UTILS_HEADER_
@@ -6,18 +6,40 @@
 #include <stdint.h>
 #include <stddef.h>
 #include <assert.h>
+#include <stdbool.h>
+#include <string.h>
 
 #include "types.h"
 #include "macros.h"
 
 #define ARENA_DEFAULT_SIZE (1024 * 1024)  // 1MB default size
 #define ALIGNMENT 16                      // Default alignment
+#define ARENA_STATS_MAX_SITES 64          // Tracked call sites per arena
+
+typedef struct {
+  cstr file;   // __FILE__ of the call site
+  i32 line;    // __LINE__ of the call site
+  sz count;    // Allocations made from this site
+  sz bytes;    // Bytes requested from this site
+  sz padding;  // Bytes lost to alignment at this site
+} arena_site;
+
+typedef struct {
+  sz high_water;  // Largest offset ever reached (survives arena_reset)
+  sz count;       // Successful allocations
+  sz failed;      // Allocations that did not fit
+  sz requested;   // Bytes requested by callers
+  sz padding;     // Bytes lost to alignment padding
+  u32 sites_count;
+  arena_site sites[ARENA_STATS_MAX_SITES];
+} arena_stats;
 
 typedef struct {
   u8* base;     // Start of allocated memory (NULL during estimation phase)
   sz offset;    // Current offset in arena
   sz size;      // Total size of the arena
   sz estimate;  // Memory estimate during pre-allocation phase
+  arena_stats* stats;  // Instrumentation, NULL unless stats are enabled
 } arena;
 
 /* ****************** utils::arena API ****************** */
@@ -27,16 +49,24 @@ void arena_create(arena* a, sz size);
 void arena_destroy(arena* a);
 
 // Arena allocation
-void* arena_alloc(arena* a, sz size, sz alignment);
+void* arena_alloc_at(arena* a, sz size, sz alignment, cstr file, i32 line);
 void arena_reset(arena* a);
 
+#define arena_alloc(a, size, alignment) \
+  arena_alloc_at((a), (size), (alignment), __FILE__, __LINE__)
+
 // Memory estimation API
 void arena_begin_estimate(arena* a);
 void arena_estimate_add(arena* a, sz size, sz alignment);
 sz arena_end_estimate(arena* a);
 
 // Debug API
+void arena_stats_enable(bool on);
+bool arena_stats_enabled(void);
 void arena_print(arena* a);
+// Prints the stats when they are enabled, then destroys the arena; how every
+// command releases its arena
+void arena_finish(arena* a);
 
 /* ****************** utils::arena API ****************** */
 
@@ -57,6 +87,53 @@ static inline sz align_up(sz ptr, sz alignment) {
   return align;
 }
 
+static bool arena_stats_on = false;
+
+// Attaches a zeroed stats block when instrumentation has been switched on
+static void arena_stats_attach(arena* a) {
+  if (!arena_stats_on || a->stats)
+    return;
+  a->stats = (arena_stats*)calloc(1, sizeof(arena_stats));
+  makesure(a->stats != NULL, "arena_stats_attach failed");
+}
+
+static void arena_stats_record(arena_stats* st,
+                               sz size,
+                               sz padding,
+                               cstr file,
+                               i32 line) {
+  st->count++;
+  st->requested += size;
+  st->padding += padding;
+
+  arena_site* site = NULL;
+  for (u32 i = 0; i < st->sites_count; i++) {
+    arena_site* s = &st->sites[i];
+    if (s->line == line && (s->file == file || !strcmp(s->file, file))) {
+      site = s;
+      break;
+    }
+  }
+
+  if (!site) {
+    // once the table is full the last slot collects everything else
+    u32 i = st->sites_count < ARENA_STATS_MAX_SITES ? st->sites_count++
+                                                    : ARENA_STATS_MAX_SITES - 1;
+    site = &st->sites[i];
+    if (site->count == 0) {
+      site->file = file;
+      site->line = line;
+    } else if (site->line != line || strcmp(site->file, file)) {
+      site->file = "(other sites)";
+      site->line = 0;
+    }
+  }
+
+  site->count++;
+  site->bytes += size;
+  site->padding += padding;
+}
+
 /* ****************** Arena Initialization & Destruction ****************** */
 
 void arena_create(arena* a, sz size) {
@@ -67,29 +144,41 @@ void arena_create(arena* a, sz size) {
   a->offset = 0;
   a->size = aligned_size;
   a->estimate = 0;  // Not used after allocation phase
+  arena_stats_attach(a);
 }
 
 void arena_destroy(arena* a) {
   if (a->base)
     free(a->base);
+  if (a->stats)
+    free(a->stats);
   a->base = NULL;
   a->offset = 0;
   a->size = 0;
   a->estimate = 0;
+  a->stats = NULL;
 }
 
 /* ****************** Arena Allocation API ****************** */
 
-void* arena_alloc(arena* a, sz size, sz alignment) {
+void* arena_alloc_at(arena* a, sz size, sz alignment, cstr file, i32 line) {
   sz aligned_offset = align_up((sz)(a->base + a->offset), alignment);
   sz padding = aligned_offset - (sz)(a->base + a->offset);
 
   if (a->offset + padding + size > a->size) {
+    if (a->stats)
+      a->stats->failed++;
     return NULL;
   }
 
   void* ptr = a->base + a->offset + padding;
   a->offset += padding + size;
+
+  if (a->stats) {
+    arena_stats_record(a->stats, size, padding, file, line);
+    if (a->offset > a->stats->high_water)
+      a->stats->high_water = a->offset;
+  }
   return ptr;
 }
 
@@ -117,17 +206,48 @@ sz arena_end_estimate(arena* a) {
 
   a->offset = 0;
   a->size = final_size;
+  arena_stats_attach(a);
   return final_size;
 }
 
 /* ****************** Debug API ****************** */
 
+void arena_stats_enable(bool on) {
+  arena_stats_on = on;
+}
+
+bool arena_stats_enabled(void) {
+  return arena_stats_on;
+}
+
+// stderr, so the report never mixes with what a command writes to stdout
 void arena_print(arena* a) {
-  printf("==========================\n");
-  printf("== size:     %zu \n", a->size);
-  printf("== estimate: %zu \n", a->estimate);
-  printf("== offset:   %zu \n", a->offset);
-  printf("==========================\n");
+  fprintf(stderr, "==========================\n");
+  fprintf(stderr, "== size:     %zu \n", a->size);
+  fprintf(stderr, "== estimate: %zu \n", a->estimate);
+  fprintf(stderr, "== offset:   %zu \n", a->offset);
+
+  arena_stats* st = a->stats;
+  if (st) {
+    fprintf(stderr, "== high:     %zu \n", st->high_water);
+    fprintf(stderr, "== allocs:   %zu (%zu failed) \n", st->count,
+            st->failed);
+    fprintf(stderr, "== request:  %zu \n", st->requested);
+    fprintf(stderr, "== padding:  %zu \n", st->padding);
+    fprintf(stderr, "== sites:    (count | bytes | padding)\n");
+    for (u32 i = 0; i < st->sites_count; i++) {
+      arena_site* s = &st->sites[i];
+      fprintf(stderr, "==   %s:%d  %zu | %zu | %zu\n", s->file, s->line,
+              s->count, s->bytes, s->padding);
+    }
+  }
+  fprintf(stderr, "==========================\n");
+}
+
+void arena_finish(arena* a) {
+  if (arena_stats_on)
+    arena_print(a);
+  arena_destroy(a);
 }
 
 #endif  // UTILS_ARENA_IMPLEMENTATION
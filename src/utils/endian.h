@@ -3,14 +3,70 @@
 
 #include <stdlib.h>
 #include <stdbool.h>
+#include <string.h>
 
 #include "types.h"
 
+// Host byte order is fixed at compile time, every on-disk format sqt reads
+// is little-endian so on little-endian hosts all conversions vanish
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define ENDIAN_HOST_BIG 1
+#else
+#define ENDIAN_HOST_BIG 0
+#endif
+
+// x86 is always little-endian, big-endian ARM is the only host where a
+// vector swap kernel can actually run
+#if ENDIAN_HOST_BIG && defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
 /* ****************** utils::endian API ****************** */
-i16 endian_i16(i16 num);
-i32 endian_i32(i32 num);
-i64 endian_i64(i64 num);
-f32 endian_f32(f32 num);
+
+// Single values, little-endian to host (and back, the swap is symmetric)
+static inline i16 endian_i16(i16 num) {
+#if ENDIAN_HOST_BIG
+  return (i16)__builtin_bswap16((u16)num);
+#else
+  return num;
+#endif
+}
+
+static inline i32 endian_i32(i32 num) {
+#if ENDIAN_HOST_BIG
+  return (i32)__builtin_bswap32((u32)num);
+#else
+  return num;
+#endif
+}
+
+static inline i64 endian_i64(i64 num) {
+#if ENDIAN_HOST_BIG
+  return (i64)__builtin_bswap64((u64)num);
+#else
+  return num;
+#endif
+}
+
+static inline f32 endian_f32(f32 num) {
+#if ENDIAN_HOST_BIG
+  u32 u;
+  memcpy(&u, &num, sizeof(u));
+  u = __builtin_bswap32(u);
+  memcpy(&num, &u, sizeof(u));
+#endif
+  return num;
+}
+
+// Bulk arrays of little-endian values, 'dst' may be the same as 'src'
+void endian_i16_array(i16* dst, const void* src, sz n);
+void endian_i32_array(i32* dst, const void* src, sz n);
+void endian_f32_array(f32* dst, const void* src, sz n);
+
+// Record tables, converts 'fields' consecutive i32 values that start 'first'
+// bytes into each of 'count' records laid out 'stride' bytes apart, in place
+void endian_i32_fields(void* base, sz count, sz stride, sz first, sz fields);
+
 /* ****************** utils::endian API ****************** */
 
 #ifdef UTILS_ENDIAN_IMPLEMENTATION
@@ -24,42 +80,73 @@ f32 endian_f32(f32 num);
 //             | |
 //             |_|
 
-static inline bool isle() {
-  u16 num = 0x1;
-  return (*(u8*)&num == 1);
+/* ****************** Swap Kernels ****************** */
+
+#if ENDIAN_HOST_BIG
+static void _bswap16_array(u16* dst, const u16* src, sz n) {
+  sz i = 0;
+#if defined(__ARM_NEON)
+  for (; i + 8 <= n; i += 8) {
+    uint8x16_t v = vld1q_u8((const u8*)(src + i));
+    vst1q_u8((u8*)(dst + i), vrev16q_u8(v));
+  }
+#endif
+  for (; i < n; i++)
+    dst[i] = __builtin_bswap16(src[i]);
+}
+
+static void _bswap32_array(u32* dst, const u32* src, sz n) {
+  sz i = 0;
+#if defined(__ARM_NEON)
+  for (; i + 4 <= n; i += 4) {
+    uint8x16_t v = vld1q_u8((const u8*)(src + i));
+    vst1q_u8((u8*)(dst + i), vrev32q_u8(v));
+  }
+#endif
+  for (; i < n; i++)
+    dst[i] = __builtin_bswap32(src[i]);
 }
+#endif
+
+/* ****************** Bulk Converters ****************** */
 
-i16 endian_i16(i16 num) {
-  return isle() ? num : (i16)((num >> 8) | (num << 8));
+void endian_i16_array(i16* dst, const void* src, sz n) {
+#if ENDIAN_HOST_BIG
+  _bswap16_array((u16*)dst, (const u16*)src, n);
+#else
+  if ((const void*)dst != src)
+    memmove(dst, src, n * sizeof(i16));
+#endif
 }
 
-i32 endian_i32(i32 num) {
-  return isle() ? num
-                : (i32)((num >> 24) | ((num >> 8) & 0x0000FF00) |
-                        ((num << 8) & 0x00FF0000) | (num << 24));
+void endian_i32_array(i32* dst, const void* src, sz n) {
+#if ENDIAN_HOST_BIG
+  _bswap32_array((u32*)dst, (const u32*)src, n);
+#else
+  if ((const void*)dst != src)
+    memmove(dst, src, n * sizeof(i32));
+#endif
 }
 
-i64 endian_i64(i64 num) {
-  return isle() ? num
-                : (i64)((num >> 56) | ((num >> 40) & 0x000000000000FF00LL) |
-                        ((num >> 24) & 0x0000000000FF0000LL) |
-                        ((num >> 8) & 0x00000000FF000000LL) |
-                        ((num << 8) & 0x000000FF00000000LL) |
-                        ((num << 24) & 0x0000FF0000000000LL) |
-                        ((num << 40) & 0x00FF000000000000LL) | (num << 56));
+void endian_f32_array(f32* dst, const void* src, sz n) {
+  endian_i32_array((i32*)dst, src, n);
 }
 
-f32 endian_f32(f32 num) {
-  if (isle())
-    return num;
-  f32 result;
-  char* src = (char*)&num;
-  char* dst = (char*)&result;
-  dst[0] = src[3];
-  dst[1] = src[2];
-  dst[2] = src[1];
-  dst[3] = src[0];
-  return result;
+void endian_i32_fields(void* base, sz count, sz stride, sz first, sz fields) {
+#if ENDIAN_HOST_BIG
+  u8* p = (u8*)base + first;
+  for (sz i = 0; i < count; i++, p += stride) {
+    u32 tmp[16];
+    for (sz f = 0; f < fields; f += 16) {
+      sz k = fields - f < 16 ? fields - f : 16;
+      memcpy(tmp, p + f * 4, k * 4);
+      _bswap32_array(tmp, tmp, k);
+      memcpy(p + f * 4, tmp, k * 4);
+    }
+  }
+#else
+  (void)base, (void)count, (void)stride, (void)first, (void)fields;
+#endif
 }
 
 #endif  // UTILS_ENDIAN_IMPLEMENTATION
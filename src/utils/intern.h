@@ -0,0 +1,148 @@
+#ifndef UTILS_INTERN_HEADER_
+#define UTILS_INTERN_HEADER_
+
+#include <string.h>
+
+#include "types.h"
+#include "macros.h"
+#include "arena.h"
+#include "hash.h"
+#include "pool.h"
+
+#define INTERN_DEFAULT_BUCKETS 1024  // must be a power of two
+
+typedef struct intern_node {
+  struct intern_node* next;
+  u64 hash;
+  u32 len;
+  cstr str;
+} intern_node;
+
+// One copy of every distinct string. The vfs interns entry names across all
+// of its paks, so a name shadowed by a later pak is stored once
+typedef struct {
+  arena* mem;             // Backing arena for strings and bucket arrays
+  pool nodes;             // Hash-table nodes
+  intern_node** buckets;  // Chained hash table
+  u32 buckets_count;      // Always a power of two
+  u32 count;              // Distinct strings interned
+  sz bytes;               // Bytes of string data held (with terminators)
+} interner;
+
+/* ****************** utils::intern API ****************** */
+
+// Interner initialization, buckets of 0 picks INTERN_DEFAULT_BUCKETS
+void intern_create(interner* in, arena* mem, u32 buckets);
+
+// Returns the canonical copy of a string, equal strings share one pointer so
+// interned strings compare with '==' instead of strcmp
+cstr intern(interner* in, const char* str, sz len);
+cstr intern_cstr(interner* in, cstr str);
+
+// Returns the canonical copy if the string was interned before, NULL if not
+cstr intern_find(interner* in, const char* str, sz len);
+
+/* ****************** utils::intern API ****************** */
+
+#ifdef UTILS_INTERN_IMPLEMENTATION
+
+//  _                 _                           _        _   _
+// (_)               | |                         | |      | | (_)
+//  _ _ __ ___  _ __ | | ___ _ __ ___   ___ _ __ | |_ __ _| |_ _  ___  _ __
+// | | '_ ` _ \| '_ \| |/ _ \ '_ ` _ \ / _ \ '_ \| __/ _` | __| |/ _ \| '_ \
+// | | | | | | | |_) | |  __/ | | | | |  __/ | | | || (_| | |_| | (_) | | | |
+// |_|_| |_| |_| .__/|_|\___|_| |_| |_|\___|_| |_|\__\__,_|\__|_|\___/|_| |_|
+//             | |
+//             |_|
+
+static intern_node** intern_buckets(arena* mem, u32 count) {
+  intern_node** b = (intern_node**)arena_alloc(
+      mem, sizeof(intern_node*) * count, alignof(intern_node*));
+  makesure(b != NULL, "intern table allocation failed");
+  memset(b, 0, sizeof(intern_node*) * count);
+  return b;
+}
+
+// Doubles the bucket array once the load factor passes one
+static void intern_rehash(interner* in) {
+  u32 nc = in->buckets_count * 2;
+  intern_node** nb = intern_buckets(in->mem, nc);
+
+  for (u32 i = 0; i < in->buckets_count; i++) {
+    intern_node* n = in->buckets[i];
+    while (n) {
+      intern_node* next = n->next;
+      u32 at = (u32)(n->hash & (nc - 1));
+      n->next = nb[at];
+      nb[at] = n;
+      n = next;
+    }
+  }
+
+  in->buckets = nb;
+  in->buckets_count = nc;
+}
+
+void intern_create(interner* in, arena* mem, u32 buckets) {
+  notnull(mem);
+  buckets = buckets ? buckets : INTERN_DEFAULT_BUCKETS;
+  makesure(!(buckets & (buckets - 1)),
+           "intern bucket count '%u' is not a power of two", buckets);
+
+  in->mem = mem;
+  in->buckets = intern_buckets(mem, buckets);
+  in->buckets_count = buckets;
+  in->count = 0;
+  in->bytes = 0;
+  pool_create(&in->nodes, mem, sizeof(intern_node), alignof(intern_node), 0);
+}
+
+static intern_node* intern_lookup(interner* in, const char* str, sz len,
+                                  u64 h) {
+  intern_node* n = in->buckets[h & (in->buckets_count - 1)];
+  for (; n; n = n->next) {
+    if (n->hash == h && n->len == len && !memcmp(n->str, str, len))
+      return n;
+  }
+  return NULL;
+}
+
+cstr intern(interner* in, const char* str, sz len) {
+  u64 h = hash_bytes(str, len);
+  intern_node* n = intern_lookup(in, str, len, h);
+  if (n)
+    return n->str;
+
+  if (in->count >= in->buckets_count)
+    intern_rehash(in);
+
+  char* copy = (char*)arena_alloc(in->mem, len + 1, alignof(char));
+  makesure(copy != NULL, "intern string allocation failed");
+  memcpy(copy, str, len);
+  copy[len] = '\0';
+
+  n = (intern_node*)pool_alloc(&in->nodes);
+  makesure(n != NULL, "intern node allocation failed");
+  n->hash = h;
+  n->len = (u32)len;
+  n->str = copy;
+
+  u32 at = (u32)(h & (in->buckets_count - 1));
+  n->next = in->buckets[at];
+  in->buckets[at] = n;
+  in->count++;
+  in->bytes += len + 1;
+  return copy;
+}
+
+cstr intern_cstr(interner* in, cstr str) {
+  return intern(in, str, strlen(str));
+}
+
+cstr intern_find(interner* in, const char* str, sz len) {
+  intern_node* n = intern_lookup(in, str, len, hash_bytes(str, len));
+  return n ? n->str : NULL;
+}
+
+#endif  // UTILS_INTERN_IMPLEMENTATION
+#endif  // UTILS_INTERN_HEADER_
@@ -3,75 +3,416 @@
 
 #include <stdint.h>
 #include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "types.h"
 #include "arena.h"
 #include "macros.h"
 
+#define FILE_VIEW_MMAP_THRESHOLD (256 * 1024)  // map files from 256KB up
+#define FILE_WRITER_FLUSH_SIZE (4 * 1024 * 1024)  // default flush size, 4MB
+#define FILE_WRITER_ALIGN 4096  // buffer and flush granularity for O_DIRECT
+
+typedef struct {
+  int fd;       // Descriptor the view was created from (-1 once closed)
+  u8* data;     // File contents, either mapped or read into the heap
+  sz size;      // Size of the file in bytes
+  bool mapped;  // True when 'data' is an mmap of the file
+} file_view;
+
+typedef enum {
+  FILE_ADVICE_WILLNEED,    // range will be read soon, start fetching it
+  FILE_ADVICE_DONTNEED,    // range was consumed, drop it from the cache
+  FILE_ADVICE_SEQUENTIAL,  // whole file is read front to back
+} file_advice;
+
+typedef struct {
+  sz flush_size;  // Bytes staged before a write, 0 picks the default
+  u64 prealloc;   // Final file size when known up front, 0 to skip
+  bool direct;    // Bypass the page cache (O_DIRECT, F_NOCACHE on macOS)
+} file_writer_opts;
+
+typedef struct {
+  int fd;        // Output descriptor
+  u8* buf;       // FILE_WRITER_ALIGN aligned staging buffer
+  sz cap;        // Staging buffer size, a multiple of FILE_WRITER_ALIGN
+  sz len;        // Bytes currently staged
+  u64 written;   // Bytes already handed to the kernel
+  bool direct;   // True while the descriptor is in direct mode
+} file_writer;
+
 /* ****************** utils::io API ****************** */
+
+// Descriptor primitives, all reads are positional and never move the file
+// offset so one descriptor can be shared by many readers
+int file_open_read(cstr path);
+void file_close(int fd);
+sz file_fd_size(int fd);
+sz file_read_at(int fd, void* buf, sz len, u64 offset);
+
+// In-place updates of an existing file, for formats patched rather than
+// rewritten
+int file_open_update(cstr path);
+void file_write_at(int fd, const void* buf, sz len, u64 offset);
+
+// Whole file helpers
 sz file_size(cstr);
 sz load_file(cstr, u8**);
 sz load_file_mem(cstr, arena*, u8**);
+
+// Read only view over a whole file, mmap-backed above the threshold
+void file_view_open(cstr path, file_view* v);
+void file_view_close(file_view* v);
+
+// Access pattern hints, best effort and silently ignored where unsupported
+void file_advise(int fd, u64 offset, u64 len, file_advice advice);
+void file_view_advise(file_view* v, u64 offset, u64 len, file_advice advice);
+
+// Large-block buffered writer for bulk outputs, opts may be NULL
+void file_writer_open(cstr path, const file_writer_opts* opts, file_writer* w);
+// Staging size for an output of 'len' bytes: small outputs get a buffer that
+// just fits, large ones are capped at FILE_WRITER_FLUSH_SIZE
+sz file_writer_flush_for(u64 len);
+void file_writer_write(file_writer* w, const void* data, sz len);
+u64 file_writer_tell(file_writer* w);
+void file_writer_close(file_writer* w);
+
 /* ****************** utils::io API ****************** */
 
 #ifdef UTILS_IO_IMPLEMENTATION
 
-sz file_size(cstr path) {
-  FILE* f = fopen(path, "rb");
-  makesure(f != NULL, "failed to open '%s'", path);
+//  _                 _                           _        _   _
+// (_)               | |                         | |      | | (_)
+//  _ _ __ ___  _ __ | | ___ _ __ ___   ___ _ __ | |_ __ _| |_ _  ___  _ __
+// | | '_ ` _ \| '_ \| |/ _ \ '_ ` _ \ / _ \ '_ \| __/ _` | __| |/ _ \| '_ \
+// | | | | | | | |_) | |  __/ | | | | |  __/ | | | || (_| | |_| | (_) | | | |
+// |_|_| |_| |_| .__/|_|\___|_| |_| |_|\___|_| |_|\__\__,_|\__|_|\___/|_| |_|
+//             | |
+//             |_|
+
+/* ****************** Descriptor Primitives ****************** */
 
-  fseek(f, 0, SEEK_END);
-  sz s = ftell(f);
-  rewind(f);
+int file_open_read(cstr path) {
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  makesure(fd >= 0, "failed to open '%s'", path);
+  return fd;
+}
 
-  if (f)
-    fclose(f);
+void file_close(int fd) {
+  if (fd >= 0)
+    close(fd);
+}
 
-  return s;
+sz file_fd_size(int fd) {
+  struct stat st;
+  makesure(fstat(fd, &st) == 0, "failed to stat file descriptor '%d'", fd);
+  return (sz)st.st_size;
 }
 
-sz load_file(cstr path, u8** buf) {
-  FILE* f = fopen(path, "rb");
-  makesure(f != NULL, "failed to open '%s'", path);
+// Loops over pread until 'len' bytes arrived or EOF, returns the bytes read
+sz file_read_at(int fd, void* buf, sz len, u64 offset) {
+  u8* dst = (u8*)buf;
+  sz done = 0;
 
-  fseek(f, 0, SEEK_END);
-  sz fsize = ftell(f);
-  rewind(f);
+  while (done < len) {
+    ssize_t r = pread(fd, dst + done, len - done, (off_t)(offset + done));
+    if (r < 0 && errno == EINTR)
+      continue;
+    makesure(r >= 0, "failed to read '%zu' bytes at offset '%llu'", len,
+             (unsigned long long)offset);
+    if (r == 0)
+      break;
+    done += (sz)r;
+  }
+
+  return done;
+}
+
+int file_open_update(cstr path) {
+  int fd = open(path, O_RDWR | O_CLOEXEC);
+  makesure(fd >= 0, "failed to open '%s' for update", path);
+  return fd;
+}
+
+void file_write_at(int fd, const void* buf, sz len, u64 offset) {
+  const u8* src = (const u8*)buf;
+  sz done = 0;
+
+  while (done < len) {
+    ssize_t r = pwrite(fd, src + done, len - done, (off_t)(offset + done));
+    if (r < 0 && errno == EINTR)
+      continue;
+    makesure(r > 0, "failed to write '%zu' bytes at offset '%llu'", len,
+             (unsigned long long)offset);
+    done += (sz)r;
+  }
+}
+
+/* ****************** Whole File Helpers ****************** */
+
+sz file_size(cstr path) {
+  struct stat st;
+  makesure(stat(path, &st) == 0, "failed to stat '%s'", path);
+  return (sz)st.st_size;
+}
+
+sz load_file(cstr path, u8** buf) {
+  int fd = file_open_read(path);
+  sz fsize = file_fd_size(fd);
 
   *buf = (u8*)malloc(sizeof(u8) * fsize);
   makesure(*buf != NULL, "malloc failed");
 
-  sz rsize = fread(*buf, 1, fsize, f);
+  sz rsize = file_read_at(fd, *buf, fsize, 0);
   makesure(rsize == fsize, "read size '%zu' did not match the file size '%zu'",
            rsize, fsize);
 
-  if (f) {
-    fclose(f);
-  }
-
+  file_close(fd);
   return fsize;
 }
 
 sz load_file_mem(cstr path, arena* mem, u8** buf) {
-  FILE* f = fopen(path, "rb");
-  makesure(f != NULL, "failed to open '%s'", path);
-
-  fseek(f, 0, SEEK_END);
-  sz fsize = ftell(f);
-  rewind(f);
+  int fd = file_open_read(path);
+  sz fsize = file_fd_size(fd);
 
   *buf = (u8*)arena_alloc(mem, sizeof(u8) * fsize, alignof(u8));
   makesure(*buf != NULL, "malloc failed");
 
-  sz rsize = fread(*buf, 1, fsize, f);
+  sz rsize = file_read_at(fd, *buf, fsize, 0);
   makesure(rsize == fsize, "read size '%zu' did not match the file size '%zu'",
            rsize, fsize);
 
-  if (f) {
-    fclose(f);
+  file_close(fd);
+  return fsize;
+}
+
+/* ****************** File View ****************** */
+
+void file_view_open(cstr path, file_view* v) {
+  v->fd = file_open_read(path);
+  v->size = file_fd_size(v->fd);
+  v->data = NULL;
+  v->mapped = false;
+
+  if (v->size == 0)
+    return;
+
+  if (v->size >= FILE_VIEW_MMAP_THRESHOLD) {
+    void* p = mmap(NULL, v->size, PROT_READ, MAP_SHARED, v->fd, 0);
+    if (p != MAP_FAILED) {
+      v->data = (u8*)p;
+      v->mapped = true;
+      return;
+    }
   }
 
-  return fsize;
+  // small files (or a failed map) are cheaper to read in one go
+  v->data = (u8*)malloc(v->size);
+  makesure(v->data != NULL, "malloc failed");
+  sz rsize = file_read_at(v->fd, v->data, v->size, 0);
+  makesure(rsize == v->size,
+           "read size '%zu' did not match the file size '%zu'", rsize,
+           v->size);
+}
+
+void file_view_close(file_view* v) {
+  if (v->data) {
+    if (v->mapped)
+      munmap(v->data, v->size);
+    else
+      free(v->data);
+  }
+  file_close(v->fd);
+  v->fd = -1;
+  v->data = NULL;
+  v->size = 0;
+  v->mapped = false;
+}
+
+/* ****************** Access Hints ****************** */
+
+void file_advise(int fd, u64 offset, u64 len, file_advice advice) {
+#if defined(POSIX_FADV_WILLNEED)
+  static const int map[] = {
+      [FILE_ADVICE_WILLNEED] = POSIX_FADV_WILLNEED,
+      [FILE_ADVICE_DONTNEED] = POSIX_FADV_DONTNEED,
+      [FILE_ADVICE_SEQUENTIAL] = POSIX_FADV_SEQUENTIAL,
+  };
+  posix_fadvise(fd, (off_t)offset, (off_t)len, map[advice]);
+#elif defined(F_RDADVISE)
+  // macOS only knows how to prefetch
+  if (advice == FILE_ADVICE_WILLNEED) {
+    struct radvisory ra = {.ra_offset = (off_t)offset, .ra_count = (int)len};
+    fcntl(fd, F_RDADVISE, &ra);
+  }
+#else
+  (void)fd, (void)offset, (void)len, (void)advice;
+#endif
+}
+
+void file_view_advise(file_view* v, u64 offset, u64 len, file_advice advice) {
+  if (offset >= v->size || len == 0)
+    return;
+  if (len > v->size - offset)
+    len = v->size - offset;
+
+  file_advise(v->fd, offset, len, advice);
+  if (!v->mapped)
+    return;
+
+  // prefetch rounds outwards, dropping rounds inwards so neighbours survive
+  u64 pg = (u64)sysconf(_SC_PAGESIZE);
+  u64 lo = offset & ~(pg - 1);
+  u64 hi = (offset + len + pg - 1) & ~(pg - 1);
+  int a = MADV_SEQUENTIAL;
+  if (advice == FILE_ADVICE_WILLNEED) {
+    a = MADV_WILLNEED;
+  } else if (advice == FILE_ADVICE_DONTNEED) {
+    a = MADV_DONTNEED;
+    lo = (offset + pg - 1) & ~(pg - 1);
+    hi = (offset + len) & ~(pg - 1);
+    if (hi <= lo)
+      return;
+  }
+  madvise(v->data + lo, (sz)(hi - lo), a);
+}
+
+/* ****************** File Writer ****************** */
+
+static void _write_all(int fd, const u8* data, sz len) {
+  while (len > 0) {
+    ssize_t r = write(fd, data, len);
+    if (r < 0 && errno == EINTR)
+      continue;
+    makesure(r > 0, "failed to write '%zu' bytes", len);
+    data += r;
+    len -= (sz)r;
+  }
+}
+
+static void _writer_flush(file_writer* w) {
+  if (w->len == 0)
+    return;
+  _write_all(w->fd, w->buf, w->len);
+  w->written += w->len;
+  w->len = 0;
+}
+
+// Direct IO only accepts aligned lengths, the unaligned tail is written after
+// dropping back to buffered mode
+static void _writer_drop_direct(file_writer* w) {
+  if (!w->direct)
+    return;
+#if defined(O_DIRECT)
+  int fl = fcntl(w->fd, F_GETFL);
+  makesure(fl >= 0 && fcntl(w->fd, F_SETFL, fl & ~O_DIRECT) == 0,
+           "failed to leave direct mode");
+#endif
+  w->direct = false;
+}
+
+void file_writer_open(cstr path, const file_writer_opts* opts, file_writer* w) {
+  file_writer_opts o = opts ? *opts : (file_writer_opts){0};
+  sz cap = o.flush_size ? o.flush_size : FILE_WRITER_FLUSH_SIZE;
+  cap = (cap + FILE_WRITER_ALIGN - 1) & ~(sz)(FILE_WRITER_ALIGN - 1);
+
+  int flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+  w->fd = -1;
+  w->direct = false;
+
+#if defined(O_DIRECT)
+  if (o.direct) {
+    w->fd = open(path, flags | O_DIRECT, 0644);
+    w->direct = w->fd >= 0;  // tmpfs and friends refuse O_DIRECT
+  }
+#endif
+  if (w->fd < 0)
+    w->fd = open(path, flags, 0644);
+  makesure(w->fd >= 0, "failed to create '%s'", path);
+
+#if defined(F_NOCACHE)
+  // macOS has no O_DIRECT, F_NOCACHE keeps pages out of the cache without
+  // imposing any alignment rules so the writer stays in buffered mode
+  if (o.direct)
+    fcntl(w->fd, F_NOCACHE, 1);
+#endif
+
+#if defined(__linux__)
+  // reserve the whole extent at once instead of growing it write by write
+  if (o.prealloc > 0)
+    posix_fallocate(w->fd, 0, (off_t)o.prealloc);
+#endif
+
+  w->buf = NULL;
+  makesure(posix_memalign((void**)&w->buf, FILE_WRITER_ALIGN, cap) == 0,
+           "failed to allocate the writer buffer");
+  w->cap = cap;
+  w->len = 0;
+  w->written = 0;
+}
+
+sz file_writer_flush_for(u64 len) {
+  if (len == 0)
+    return 1;
+  return len < FILE_WRITER_FLUSH_SIZE ? (sz)len : FILE_WRITER_FLUSH_SIZE;
+}
+
+void file_writer_write(file_writer* w, const void* data, sz len) {
+  const u8* src = (const u8*)data;
+
+  // large writes skip the staging copy when nothing is pending
+  if (!w->direct && w->len == 0 && len >= w->cap) {
+    _write_all(w->fd, src, len);
+    w->written += len;
+    return;
+  }
+
+  while (len > 0) {
+    sz n = w->cap - w->len;
+    if (n > len)
+      n = len;
+    memcpy(w->buf + w->len, src, n);
+    w->len += n;
+    src += n;
+    len -= n;
+    if (w->len == w->cap)
+      _writer_flush(w);
+  }
+}
+
+u64 file_writer_tell(file_writer* w) {
+  return w->written + w->len;
+}
+
+void file_writer_close(file_writer* w) {
+  if (w->direct && (w->len % FILE_WRITER_ALIGN) != 0) {
+    sz head = w->len & ~(sz)(FILE_WRITER_ALIGN - 1);
+    if (head > 0) {
+      _write_all(w->fd, w->buf, head);
+      memmove(w->buf, w->buf + head, w->len - head);
+      w->written += head;
+      w->len -= head;
+    }
+    _writer_drop_direct(w);
+  }
+  _writer_flush(w);
+
+  // a preallocated extent may be longer than what was actually written
+  makesure(ftruncate(w->fd, (off_t)w->written) == 0,
+           "failed to truncate output to '%llu' bytes",
+           (unsigned long long)w->written);
+
+  free(w->buf);
+  close(w->fd);
+  w->buf = NULL;
+  w->fd = -1;
 }
 
 #endif  // UTILS_IO_IMPLEMENTATION
@@ -0,0 +1,110 @@
+#ifndef UTILS_POOL_HEADER_
+#define UTILS_POOL_HEADER_
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "types.h"
+#include "macros.h"
+#include "arena.h"
+
+#define POOL_DEFAULT_BLOCK_SLOTS 256  // slots carved per arena block
+
+typedef struct pool_slot {
+  struct pool_slot* next;
+} pool_slot;
+
+// Fixed-size slots for small records that come and go, released slots are
+// reused before the arena is asked for more. The interner takes its hash
+// table nodes from one; pak and wad directories do not, they are read in
+// one piece into a plain arena array
+typedef struct {
+  arena* mem;         // Backing arena, blocks of slots are carved from it
+  sz slot_size;       // Size of one slot (never smaller than a pointer)
+  sz slot_align;      // Alignment of every slot
+  u32 block_slots;    // Slots carved per block
+  pool_slot* free;    // Free-list of released or never used slots
+  sz used;            // Slots currently handed out
+  sz capacity;        // Slots carved from the arena so far
+} pool;
+
+/* ****************** utils::pool API ****************** */
+
+// Pool initialization, block_slots of 0 picks POOL_DEFAULT_BLOCK_SLOTS
+void pool_create(pool* p, arena* mem, sz size, sz alignment, u32 block_slots);
+
+// Slot allocation, pool_alloc returns NULL once the arena is exhausted
+void* pool_alloc(pool* p);
+void pool_free(pool* p, void* ptr);
+
+/* ****************** utils::pool API ****************** */
+
+#ifdef UTILS_POOL_IMPLEMENTATION
+
+//  _                 _                           _        _   _
+// (_)               | |                         | |      | | (_)
+//  _ _ __ ___  _ __ | | ___ _ __ ___   ___ _ __ | |_ __ _| |_ _  ___  _ __
+// | | '_ ` _ \| '_ \| |/ _ \ '_ ` _ \ / _ \ '_ \| __/ _` | __| |/ _ \| '_ \
+// | | | | | | | |_) | |  __/ | | | | |  __/ | | | || (_| | |_| | (_) | | | |
+// |_|_| |_| |_| .__/|_|\___|_| |_| |_|\___|_| |_|\__\__,_|\__|_|\___/|_| |_|
+//             | |
+//             |_|
+
+void pool_create(pool* p, arena* mem, sz size, sz alignment, u32 block_slots) {
+  notnull(mem);
+  makesure(alignment && !(alignment & (alignment - 1)),
+           "pool alignment '%zu' is not a power of two", alignment);
+
+  if (alignment < alignof(pool_slot))
+    alignment = alignof(pool_slot);
+  if (size < sizeof(pool_slot))
+    size = sizeof(pool_slot);
+
+  p->mem = mem;
+  p->slot_size = (size + alignment - 1) & ~(alignment - 1);
+  p->slot_align = alignment;
+  p->block_slots = block_slots ? block_slots : POOL_DEFAULT_BLOCK_SLOTS;
+  p->free = NULL;
+  p->used = 0;
+  p->capacity = 0;
+}
+
+// Carves one block out of the arena and threads its slots onto the free-list
+static bool pool_grow(pool* p) {
+  u8* block = (u8*)arena_alloc(p->mem, p->slot_size * p->block_slots,
+                               p->slot_align);
+  if (!block)
+    return false;
+
+  for (u32 i = p->block_slots; i > 0; i--) {
+    pool_slot* s = (pool_slot*)(block + (sz)(i - 1) * p->slot_size);
+    s->next = p->free;
+    p->free = s;
+  }
+  p->capacity += p->block_slots;
+  return true;
+}
+
+void* pool_alloc(pool* p) {
+  if (!p->free && !pool_grow(p))
+    return NULL;
+
+  pool_slot* s = p->free;
+  p->free = s->next;
+  p->used++;
+  memset(s, 0, p->slot_size);
+  return s;
+}
+
+void pool_free(pool* p, void* ptr) {
+  if (!ptr)
+    return;
+
+  pool_slot* s = (pool_slot*)ptr;
+  s->next = p->free;
+  p->free = s;
+  p->used--;
+}
+
+#endif  // UTILS_POOL_IMPLEMENTATION
+#endif  // UTILS_POOL_HEADER_
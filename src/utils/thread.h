@@ -0,0 +1,207 @@
+#ifndef UTILS_THREAD_HEADER_
+#define UTILS_THREAD_HEADER_
+
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "types.h"
+#include "macros.h"
+
+#define THREAD_MAX_WORKERS 64  // upper bound for automatically picked counts
+
+// Called once per item, 'worker' is a stable id in [0, thread_count())
+typedef void (*thread_fn)(void* ctx, u32 index, u32 worker);
+
+// Dedicated thread running fn(ctx, index, index) once, for pipeline stages
+// that must run concurrently whatever the worker count is
+typedef struct {
+  pthread_t tid;
+  thread_fn fn;
+  void* ctx;
+  u32 index;
+} thread_handle;
+
+// Bounded multi-producer multi-consumer queue of pointers, pushes block while
+// it is full and pops block while it is empty, so a slow stage throttles the
+// ones feeding it instead of letting work pile up in memory
+typedef struct {
+  void** items;        // ring of 'cap' slots, owned by the caller
+  u32 cap;
+  u32 head;
+  u32 len;
+  u32 producers;       // the queue closes once all of them are done
+  pthread_mutex_t lock;
+  pthread_cond_t not_empty;
+  pthread_cond_t not_full;
+} thread_queue;
+
+/* ****************** utils::thread API ****************** */
+
+// Worker count, 0 restores the default of one worker per online CPU
+void thread_set_count(u32 n);
+u32 thread_count(void);
+
+// Runs fn for every index in [0, count) across the workers and returns once
+// all of them finished, items are handed out dynamically so uneven work
+// (one huge lump next to many tiny ones) still balances
+void thread_parallel_for(u32 count, thread_fn fn, void* ctx);
+
+void thread_spawn(thread_handle* h, thread_fn fn, void* ctx, u32 index);
+void thread_join(thread_handle* h);
+
+void thread_queue_init(thread_queue* q, void** items, u32 cap, u32 producers);
+void thread_queue_destroy(thread_queue* q);
+void thread_queue_push(thread_queue* q, void* item);
+// false once every producer is done and the queue is drained
+bool thread_queue_pop(thread_queue* q, void** item);
+// called by each producer when it has nothing more to push
+void thread_queue_done(thread_queue* q);
+
+/* ****************** utils::thread API ****************** */
+
+#ifdef UTILS_THREAD_IMPLEMENTATION
+
+//  _                 _                           _        _   _
+// (_)               | |                         | |      | | (_)
+//  _ _ __ ___  _ __ | | ___ _ __ ___   ___ _ __ | |_ __ _| |_ _  ___  _ __
+// | | '_ ` _ \| '_ \| |/ _ \ '_ ` _ \ / _ \ '_ \| __/ _` | __| |/ _ \| '_ \
+// | | | | | | | |_) | |  __/ | | | | |  __/ | | | || (_| | |_| | (_) | | | |
+// |_|_| |_| |_| .__/|_|\___|_| |_| |_|\___|_| |_|\__\__,_|\__|_|\___/|_| |_|
+//             | |
+//             |_|
+
+static u32 thread_workers = 0;
+
+typedef struct {
+  thread_fn fn;
+  void* ctx;
+  u32 count;
+  atomic_uint next;
+} thread_job;
+
+typedef struct {
+  thread_job* job;
+  u32 worker;
+} thread_arg;
+
+void thread_set_count(u32 n) {
+  thread_workers = n > THREAD_MAX_WORKERS ? THREAD_MAX_WORKERS : n;
+}
+
+u32 thread_count(void) {
+  if (thread_workers)
+    return thread_workers;
+
+  long n = sysconf(_SC_NPROCESSORS_ONLN);
+  if (n < 1)
+    n = 1;
+  if (n > THREAD_MAX_WORKERS)
+    n = THREAD_MAX_WORKERS;
+  return (u32)n;
+}
+
+static void thread_drain(thread_job* job, u32 worker) {
+  for (;;) {
+    u32 i = atomic_fetch_add_explicit(&job->next, 1, memory_order_relaxed);
+    if (i >= job->count)
+      return;
+    job->fn(job->ctx, i, worker);
+  }
+}
+
+static void* thread_main(void* p) {
+  thread_arg* a = (thread_arg*)p;
+  thread_drain(a->job, a->worker);
+  return NULL;
+}
+
+void thread_parallel_for(u32 count, thread_fn fn, void* ctx) {
+  if (count == 0)
+    return;
+
+  u32 n = thread_count();
+  if (n > count)
+    n = count;
+
+  thread_job job = {.fn = fn, .ctx = ctx, .count = count};
+  atomic_init(&job.next, 0);
+
+  // the calling thread is worker 0, so a single worker never spawns
+  pthread_t tids[THREAD_MAX_WORKERS];
+  thread_arg args[THREAD_MAX_WORKERS];
+  for (u32 w = 1; w < n; w++) {
+    args[w] = (thread_arg){.job = &job, .worker = w};
+    makesure(pthread_create(&tids[w], NULL, thread_main, &args[w]) == 0,
+             "failed to start worker thread '%u'", w);
+  }
+
+  thread_drain(&job, 0);
+
+  for (u32 w = 1; w < n; w++)
+    pthread_join(tids[w], NULL);
+}
+
+static void* thread_handle_main(void* p) {
+  thread_handle* h = (thread_handle*)p;
+  h->fn(h->ctx, h->index, h->index);
+  return NULL;
+}
+
+void thread_spawn(thread_handle* h, thread_fn fn, void* ctx, u32 index) {
+  *h = (thread_handle){.fn = fn, .ctx = ctx, .index = index};
+  makesure(pthread_create(&h->tid, NULL, thread_handle_main, h) == 0,
+           "failed to start thread '%u'", index);
+}
+
+void thread_join(thread_handle* h) { pthread_join(h->tid, NULL); }
+
+void thread_queue_init(thread_queue* q, void** items, u32 cap, u32 producers) {
+  makesure(cap > 0 && producers > 0, "a queue needs slots and producers");
+  *q = (thread_queue){.items = items, .cap = cap, .producers = producers};
+  pthread_mutex_init(&q->lock, NULL);
+  pthread_cond_init(&q->not_empty, NULL);
+  pthread_cond_init(&q->not_full, NULL);
+}
+
+void thread_queue_destroy(thread_queue* q) {
+  pthread_mutex_destroy(&q->lock);
+  pthread_cond_destroy(&q->not_empty);
+  pthread_cond_destroy(&q->not_full);
+}
+
+void thread_queue_push(thread_queue* q, void* item) {
+  pthread_mutex_lock(&q->lock);
+  while (q->len == q->cap)
+    pthread_cond_wait(&q->not_full, &q->lock);
+  q->items[(q->head + q->len++) % q->cap] = item;
+  pthread_cond_signal(&q->not_empty);
+  pthread_mutex_unlock(&q->lock);
+}
+
+bool thread_queue_pop(thread_queue* q, void** item) {
+  pthread_mutex_lock(&q->lock);
+  while (q->len == 0 && q->producers > 0)
+    pthread_cond_wait(&q->not_empty, &q->lock);
+
+  bool ok = q->len > 0;
+  if (ok) {
+    *item = q->items[q->head];
+    q->head = (q->head + 1) % q->cap;
+    q->len--;
+    pthread_cond_signal(&q->not_full);
+  }
+  pthread_mutex_unlock(&q->lock);
+  return ok;
+}
+
+void thread_queue_done(thread_queue* q) {
+  pthread_mutex_lock(&q->lock);
+  if (q->producers > 0 && --q->producers == 0)
+    pthread_cond_broadcast(&q->not_empty);
+  pthread_mutex_unlock(&q->lock);
+}
+
+#endif  // UTILS_THREAD_IMPLEMENTATION
+#endif  // UTILS_THREAD_HEADER_
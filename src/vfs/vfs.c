@@ -0,0 +1,3 @@
+#define VFS_IMPLEMENTATION
+
+#include "vfs.h"
@@ -0,0 +1,408 @@
+#ifndef _VFS_HEADER_
+#define _VFS_HEADER_
+
+#include <stdio.h>
+#include <string.h>
+
+#include "../../deps/fs.h"
+#include "../utils/types.h"
+#include "../utils/io.h"
+#include "../utils/macros.h"
+#include "../utils/arena.h"
+#include "../utils/endian.h"
+#include "../utils/hash.h"
+#include "../utils/intern.h"
+#include "../pak/pak.h"
+
+static constexpr u32 VFS_MAX_PATH_LEN = 1024;
+static constexpr u32 VFS_MAX_PAKS = 100;  // pak0.pak .. pak99.pak per game
+static constexpr u32 VFS_MAX_GAMES = 16;  // id1 plus stacked mod directories
+
+typedef enum vfserr { VFS_ERR_UNKNOWN = -1, VFS_ERR_OK = 0 } vfserr;
+
+// A pak or a loose game directory, in increasing order of precedence
+typedef struct {
+  cstr path;
+  bool loose;
+  file_view view;  // paks stay mapped so members are read without copies
+  u32 first;       // first record of this source in vfs.files
+  u32 count;
+} vfs_source;
+
+typedef struct {
+  cstr name;    // interned, so shadowed copies share one string
+  u32 hash;
+  u32 source;   // index into vfs.sources
+  i64 offset;   // inside the pak, 0 for loose files
+  sz size;
+} vfs_file;
+
+typedef struct {
+  interner names;
+  vfs_source* sources;
+  u32 sources_count;
+  vfs_file* files;     // every file of every source, shadowed ones included
+  u32 files_count;
+  u32* index;          // open addressing table of winning file index + 1
+  u32 index_mask;
+  u32 visible;         // distinct names, one per index slot in use
+} vfs;
+
+/* ****************** vfs API ****************** */
+
+// Mounts 'games' (e.g. id1, then the mod) under 'base' the way the engine
+// builds its search path: each game adds its directory, then pak0.pak up to
+// the first missing pakN.pak, and everything mounted later wins
+void vfs_mount(arena*, cstr, cstr*, u32, vfs*);
+void vfs_unmount(vfs*);
+
+// Single probe into the merged index, NULL when no source has the name
+const vfs_file* vfs_find(const vfs*, cstr);
+
+// Pak members are returned straight from the mapping, NULL for loose files
+const u8* vfs_data(const vfs*, const vfs_file*);
+
+// Reads the whole file into 'dst', which must hold file->size bytes
+void vfs_read(const vfs*, const vfs_file*, u8*);
+
+// Prints which source every name resolves to
+vfserr vfs_resolve(arena*, cstr, cstr*, u32, cstr*, u32);
+
+/* ****************** vfs API ****************** */
+
+//  _                 _                           _        _   _
+// (_)               | |                         | |      | | (_)
+//  _ _ __ ___  _ __ | | ___ _ __ ___   ___ _ __ | |_ __ _| |_ _  ___  _ __
+// | | '_ ` _ \| '_ \| |/ _ \ '_ ` _ \ / _ \ '_ \| __/ _` | __| |/ _ \| '_ \
+// | | | | | | | |_) | |  __/ | | | | |  __/ | | | || (_| | |_| | (_) | | | |
+// |_|_| |_| |_| .__/|_|\___|_| |_| |_|\___|_| |_|\__\__,_|\__|_|\___/|_| |_|
+//             | |
+//             |_|
+
+#ifdef VFS_IMPLEMENTATION
+
+/*****************************
+ * HIDDEN FUNCTIONS
+ *****************************/
+
+// Sizes gathered by the counting pass of _vfs_scan
+typedef struct {
+  u32 sources;
+  u32 files;
+  sz names;  // bytes of every name with its terminator
+  sz paths;  // bytes of every source path with its terminator
+} vfs_meta;
+
+static u32 _vfs_pow2(u32 count) {
+  u32 n = 16;
+  while (n < count * 2)
+    n <<= 1;
+  return n;
+}
+
+static bool _vfs_is_dir(cstr path) {
+  fs_file_info fi;
+  return fs_info(NULL, path, FS_READ, &fi) == FS_SUCCESS && fi.directory;
+}
+
+static bool _vfs_is_file(cstr path) {
+  fs_file_info fi;
+  return fs_info(NULL, path, FS_READ, &fi) == FS_SUCCESS && !fi.directory;
+}
+
+static cstr _vfs_copy(arena* m, cstr s) {
+  sz n = strlen(s) + 1;
+  char* c = (char*)arena_alloc(m, n, alignof(char));
+  notnull(c);
+  memcpy(c, s, n);
+  return c;
+}
+
+static vfs_file* _vfs_add(vfs* v, cstr name, sz len, i64 offset, sz size) {
+  vfs_file* f = &v->files[v->files_count];
+  f->name = intern(&v->names, name, len);
+  f->hash = (u32)hash_bytes(name, len);
+  f->source = v->sources_count - 1;
+  f->offset = offset;
+  f->size = size;
+  v->sources[f->source].count++;
+  v->files_count++;
+  return f;
+}
+
+// Walks a loose game directory in name order; only counts while v is NULL
+static void _vfs_walk(vfs* v, vfs_meta* vm, cstr root, cstr rel) {
+  char dir[VFS_MAX_PATH_LEN * 2];
+  snprintf(dir, sizeof(dir), rel[0] ? "%s/%s" : "%s", root, rel);
+
+  fs_iterator* it = fs_first(NULL, dir, FS_READ);
+  for (; it; it = fs_next(it)) {
+    char sub[VFS_MAX_PATH_LEN];
+    int n = snprintf(sub, sizeof(sub), rel[0] ? "%s/%s" : "%s%s", rel,
+                     it->pName);
+    makesure(n > 0 && (u32)n < VFS_MAX_PATH_LEN, "'%s/%s' is too long", dir,
+             it->pName);
+
+    if (it->info.directory) {
+      _vfs_walk(v, vm, root, sub);
+      continue;
+    }
+
+    if (v) {
+      _vfs_add(v, sub, (sz)n, 0, (sz)it->info.size);
+    } else {
+      vm->files++;
+      vm->names += (sz)n + 1;
+    }
+  }
+}
+
+// Reads the directory straight out of the mapping, names are interned and
+// nothing else is copied
+static void _vfs_pak(vfs* v, vfs_source* s) {
+  const file_view* fv = &s->view;
+  makesure(fv->size >= HEADER_LEN, "'%s' is too small to be a pak", s->path);
+
+  pak_header h;
+  memcpy(&h, fv->data, sizeof(h));
+  h.offset = endian_i32(h.offset);
+  h.size = endian_i32(h.size);
+  makesure(memcmp(h.magic_code, MAGIC_CODE, MAGIC_CODE_LEN) == 0,
+           "'%s' has an invalid header magic code", s->path);
+  makesure(h.offset >= 0 && h.size >= 0 && (sz)h.offset + h.size <= fv->size,
+           "'%s' has an invalid entry table", s->path);
+
+  u32 count = (u32)h.size / ENTRY_LEN;
+  for (u32 i = 0; i < count; i++) {
+    pak_entry e;
+    memcpy(&e, fv->data + h.offset + (sz)i * ENTRY_LEN, sizeof(e));
+    e.offset = endian_i32(e.offset);
+    e.size = endian_i32(e.size);
+    makesure(e.offset >= 0 && e.size >= 0 && (sz)e.offset + e.size <= fv->size,
+             "entry '%.56s' of '%s' is out of bounds", e.name, s->path);
+
+    sz len = strnlen((const char*)e.name, ENTRY_NAME_LEN);
+    _vfs_add(v, (const char*)e.name, len, e.offset, (sz)e.size);
+  }
+}
+
+static u32 _vfs_pak_count(cstr path) {
+  pakf f = file_open_read(path);
+  u8 buf[HEADER_LEN];
+  makesure(file_read_at(f, buf, HEADER_LEN, 0) == HEADER_LEN,
+           "failed to read the header of '%s'", path);
+  file_close(f);
+
+  pak_header h;
+  memcpy(&h, buf, sizeof(h));
+  i32 size = endian_i32(h.size);
+  return size > 0 ? (u32)size / ENTRY_LEN : 0;
+}
+
+static vfs_source* _vfs_source(vfs* v, arena* m, cstr path, bool loose) {
+  vfs_source* s = &v->sources[v->sources_count++];
+  *s = (vfs_source){.path = _vfs_copy(m, path),
+                    .loose = loose,
+                    .view = {.fd = -1},
+                    .first = v->files_count};
+  return s;
+}
+
+// Lists the sources in search-path order, counting while v is NULL and
+// filling the tables once they have been allocated
+static void _vfs_scan(arena* m,
+                      cstr base,
+                      cstr* games,
+                      u32 count,
+                      vfs* v,
+                      vfs_meta* vm) {
+  char path[VFS_MAX_PATH_LEN * 2];
+  for (u32 g = 0; g < count; g++) {
+    snprintf(path, sizeof(path), "%s/%s", base, games[g]);
+    if (!_vfs_is_dir(path)) {
+      if (!v)
+        log_warn("skipping game '%s', '%s' is not a directory", games[g], path);
+      continue;
+    }
+
+    if (v) {
+      _vfs_source(v, m, path, true);
+    } else {
+      vm->sources++;
+      vm->paths += strlen(path) + 1;
+    }
+    _vfs_walk(v, vm, path, "");
+
+    for (u32 i = 0; i < VFS_MAX_PAKS; i++) {
+      snprintf(path, sizeof(path), "%s/%s/pak%u.pak", base, games[g], i);
+      if (!_vfs_is_file(path))
+        break;
+
+      if (v) {
+        vfs_source* s = _vfs_source(v, m, path, false);
+        file_view_open(path, &s->view);
+        _vfs_pak(v, s);
+      } else {
+        u32 n = _vfs_pak_count(path);
+        vm->sources++;
+        vm->paths += strlen(path) + 1;
+        vm->files += n;
+        vm->names += (sz)n * (ENTRY_NAME_LEN + 1);
+      }
+    }
+  }
+}
+
+static void _vfs_estimate(arena* m, const vfs_meta* vm) {
+  u32 buckets = _vfs_pow2(vm->files);
+  u32 blocks = (vm->files + POOL_DEFAULT_BLOCK_SLOTS - 1) /
+               POOL_DEFAULT_BLOCK_SLOTS;
+
+  arena_begin_estimate(m);
+  arena_estimate_add(m, vm->sources * sizeof(vfs_source), alignof(vfs_source));
+  arena_estimate_add(m, vm->files * sizeof(vfs_file), alignof(vfs_file));
+  arena_estimate_add(m, buckets * sizeof(u32), alignof(u32));
+  arena_estimate_add(m, vm->paths, alignof(char));
+
+  // interner: buckets sized so it never rehashes, pool blocks, strings
+  arena_estimate_add(m, buckets * sizeof(intern_node*), alignof(intern_node*));
+  for (u32 i = 0; i < blocks; i++)
+    arena_estimate_add(m, POOL_DEFAULT_BLOCK_SLOTS * sizeof(intern_node),
+                       alignof(intern_node));
+  arena_estimate_add(m, vm->names, alignof(char));
+  arena_end_estimate(m);
+}
+
+// Sources are in increasing precedence so a later source replaces the slot;
+// duplicates inside one pak keep the first entry, as the engine finds it
+static void _vfs_build_index(arena* m, vfs* v) {
+  u32 n = _vfs_pow2(v->files_count);
+  v->index = (u32*)arena_alloc(m, n * sizeof(u32), alignof(u32));
+  notnull(v->index);
+  memset(v->index, 0, n * sizeof(u32));
+  v->index_mask = n - 1;
+
+  for (u32 i = 0; i < v->files_count; i++) {
+    const vfs_file* f = &v->files[i];
+    for (u32 at = f->hash & v->index_mask;; at = (at + 1) & v->index_mask) {
+      u32 slot = v->index[at];
+      if (!slot) {
+        v->index[at] = i + 1;
+        v->visible++;
+        break;
+      }
+      const vfs_file* other = &v->files[slot - 1];
+      if (other->name == f->name) {
+        if (other->source != f->source)
+          v->index[at] = i + 1;
+        break;
+      }
+    }
+  }
+}
+
+/*****************************
+ * EXPORTED FUNCTIONS
+ *****************************/
+
+void vfs_mount(arena* m, cstr base, cstr* games, u32 count, vfs* v) {
+  makesure(strlen(base) < VFS_MAX_PATH_LEN,
+           "base directory '%s' path length is larger than supported max of "
+           "'%u'",
+           base, VFS_MAX_PATH_LEN);
+
+  vfs_meta vm = {0};
+  _vfs_scan(m, base, games, count, NULL, &vm);
+  _vfs_estimate(m, &vm);
+
+  *v = (vfs){0};
+  v->sources = (vfs_source*)arena_alloc(m, vm.sources * sizeof(vfs_source),
+                                        alignof(vfs_source));
+  v->files = (vfs_file*)arena_alloc(m, vm.files * sizeof(vfs_file),
+                                    alignof(vfs_file));
+  makesure((v->sources && v->files) || !vm.files, "vfs allocation failed");
+  intern_create(&v->names, m, _vfs_pow2(vm.files));
+
+  _vfs_scan(m, base, games, count, v, &vm);
+  makesure(v->sources_count == vm.sources && v->files_count == vm.files,
+           "'%s' changed while it was being mounted", base);
+  _vfs_build_index(m, v);
+}
+
+void vfs_unmount(vfs* v) {
+  for (u32 i = 0; i < v->sources_count; i++) {
+    if (!v->sources[i].loose)
+      file_view_close(&v->sources[i].view);
+  }
+  v->sources_count = 0;
+  v->files_count = 0;
+}
+
+const vfs_file* vfs_find(const vfs* v, cstr name) {
+  sz len = strlen(name);
+  u32 h = (u32)hash_bytes(name, len);
+
+  for (u32 at = h & v->index_mask;; at = (at + 1) & v->index_mask) {
+    u32 slot = v->index[at];
+    if (!slot)
+      return NULL;
+    const vfs_file* f = &v->files[slot - 1];
+    if (f->hash == h && !strcmp(f->name, name))
+      return f;
+  }
+}
+
+const u8* vfs_data(const vfs* v, const vfs_file* f) {
+  const vfs_source* s = &v->sources[f->source];
+  return s->loose ? NULL : s->view.data + f->offset;
+}
+
+void vfs_read(const vfs* v, const vfs_file* f, u8* dst) {
+  const u8* d = vfs_data(v, f);
+  if (d) {
+    memcpy(dst, d, f->size);
+    return;
+  }
+
+  char path[VFS_MAX_PATH_LEN * 3];
+  snprintf(path, sizeof(path), "%s/%s", v->sources[f->source].path, f->name);
+  int fd = file_open_read(path);
+  makesure(file_read_at(fd, dst, f->size, 0) == f->size,
+           "failed to read '%s'", path);
+  file_close(fd);
+}
+
+vfserr vfs_resolve(arena* m,
+                   cstr base,
+                   cstr* games,
+                   u32 count,
+                   cstr* names,
+                   u32 names_count) {
+  vfs v;
+  vfs_mount(m, base, games, count, &v);
+
+  printf("************** RESOLVE **************\n");
+  printf("↬ base directory: '%s'\n", base);
+  printf("↬ sources:        '%u'\n", v.sources_count);
+  printf("↬ files:          '%u' (%u shadowed)\n", v.visible,
+         v.files_count - v.visible);
+  printf("       (name | source | offset | size)\n");
+
+  u32 missing = 0;
+  for (u32 i = 0; i < names_count; i++) {
+    const vfs_file* f = vfs_find(&v, names[i]);
+    if (!f) {
+      printf("↬ %s : not found\n", names[i]);
+      missing++;
+      continue;
+    }
+    printf("↬ %s : %s : %lld : %zu\n", f->name, v.sources[f->source].path,
+           (long long)f->offset, f->size);
+  }
+
+  vfs_unmount(&v);
+  return missing ? VFS_ERR_UNKNOWN : VFS_ERR_OK;
+}
+
+#endif  // VFS_IMPLEMENTATION
+#endif  //_VFS_HEADER_
@@ -0,0 +1,3 @@
+#define WAD_IMPLEMENTATION
+
+#include "wad.h"
@@ -0,0 +1,761 @@
+#ifndef _WAD_HEADER_
+#define _WAD_HEADER_
+
+#include <string.h>
+#include <strings.h>
+#include <stddef.h>
+
+#include "../../deps/fs.h"
+#include "../../deps/stb_image.h"
+#include "../utils/types.h"
+#include "../utils/io.h"
+#include "../utils/macros.h"
+#include "../utils/arena.h"
+#include "../utils/endian.h"
+#include "../utils/hash.h"
+#include "../utils/thread.h"
+#include "../img/mip.h"
+#include "../img/palette.h"
+
+static constexpr u8 WAD_MAGIC_CODE[] = "WAD2";
+static constexpr u8 WAD_MAGIC_CODE_LEN = 4;
+static constexpr u32 WAD_HEADER_LEN = 12;
+static constexpr u32 WAD_LUMP_NAME_LEN = 16;
+static constexpr u32 WAD_LUMP_LEN = 16 + WAD_LUMP_NAME_LEN;
+static constexpr u32 WAD_MAX_PATH_LEN = 1024;
+static constexpr u32 WAD_PALETTE_LEN = 256 * 3;
+static constexpr u32 WAD_MIPTEX_LEN = WAD_LUMP_NAME_LEN + 4 * 6;
+static constexpr u32 WAD_MIP_LEVELS = 4;
+static constexpr u8 WAD_TRANSPARENT = 255;
+static constexpr u32 WAD_MIPTEX_ALIGN = 16;  // miptex sides must be multiples
+
+typedef enum waderr { WAD_ERR_UNKNOWN = -1, WAD_ERR_OK = 0 } waderr;
+
+typedef enum {
+  WAD_TYPE_NONE = 0x00,
+  WAD_TYPE_LABEL = 0x01,
+  WAD_TYPE_PALETTE = 0x40,  // '@'
+  WAD_TYPE_QTEX = 0x41,     // 'A'
+  WAD_TYPE_QPIC = 0x42,     // 'B', status bar and menu pictures
+  WAD_TYPE_SOUND = 0x43,    // 'C'
+  WAD_TYPE_MIPTEX = 0x44,   // 'D', wall textures with four mip levels
+} wad_type;
+
+typedef struct {
+  u8 magic_code[WAD_MAGIC_CODE_LEN];
+  i32 count;   // number of lumps
+  i32 offset;  // lump directory offset
+} wad_header;
+
+typedef struct {
+  i32 offset;                   // offset to the lump data
+  i32 disk_size;                // size of the lump data in the file
+  i32 size;                     // size of the lump data once uncompressed
+  u8 type;                      // one of wad_type
+  u8 compression;               // never used by the Quake tools
+  u8 pad[2];
+  u8 name[WAD_LUMP_NAME_LEN];   // lump name, not always null terminated
+} wad_lump;
+
+static_assert(sizeof(wad_lump) == WAD_LUMP_LEN, "wad_lump must match disk");
+
+typedef struct {
+  u8 name[WAD_LUMP_NAME_LEN];
+  u32 width;
+  u32 height;
+  u32 offsets[WAD_MIP_LEVELS];  // relative to the start of the miptex
+} wad_miptex;
+
+static_assert(sizeof(wad_miptex) == WAD_MIPTEX_LEN, "wad_miptex must match");
+
+typedef struct {
+  i32 width;
+  i32 height;  // followed by width * height palette indices
+} wad_qpic;
+
+typedef struct wad_s {
+  file_view view;     // whole archive, lump data is read straight from it
+  wad_header header;
+  wad_lump* lumps;    // decoded directory (arena)
+  u32 lumps_count;
+  u32* index;         // open addressing table of lump index + 1, 0 is empty
+  u32 index_mask;
+} wad;
+
+typedef struct {
+  bool direct;    // write outputs with O_DIRECT, bypassing the page cache
+  bool png;       // convert miptex, qpic and palette lumps to PNG
+  bool mips;      // with png, also write the three smaller mip levels
+  cstr palette;   // palette.lmp used for png, defaults to the wad's own
+  u32 level;      // png deflate level, 0 stores the pixels uncompressed
+  bool fast;        // create: quantize with the cube alone, no exact search
+  bool fullbright;  // create: allow the fullbright colours 224..254
+  bool gamma;       // create: filter mip levels in linear light
+} wad_opts;
+
+// Opening maps the file, decodes the directory and hashes the lump names
+void wad_open(arena*, cstr, wad*);
+// Same over memory the caller keeps alive, e.g. a wad inside a mapped pak
+void wad_open_mem(arena*, const u8*, sz, wad*);
+void wad_close(wad*);
+i32 wad_find(wad*, cstr);
+cstr wad_type_name(u8);
+
+waderr wad_info(arena*, cstr, wad*);
+waderr wad_list(arena*, cstr, wad*);
+waderr wad_extract(arena*, cstr, cstr, const wad_opts*, wad*);
+waderr wad_create(arena*, cstr, cstr, const wad_opts*, wad*);
+
+//  _                 _                           _        _   _
+// (_)               | |                         | |      | | (_)
+//  _ _ __ ___  _ __ | | ___ _ __ ___   ___ _ __ | |_ __ _| |_ _  ___  _ __
+// | | '_ ` _ \| '_ \| |/ _ \ '_ ` _ \ / _ \ '_ \| __/ _` | __| |/ _ \| '_ \
+// | | | | | | | |_) | |  __/ | | | | |  __/ | | | || (_| | |_| | (_) | | | |
+// |_|_| |_| |_| .__/|_|\___|_| |_| |_|\___|_| |_|\__\__,_|\__|_|\___/|_| |_|
+//             | |
+//             |_|
+
+#ifdef WAD_IMPLEMENTATION
+
+/*****************************
+ * HIDDEN FUNCTIONS
+ *****************************/
+
+static sz _wad_name_len(const u8* name) {
+  sz n = 0;
+  while (n < WAD_LUMP_NAME_LEN && name[n])
+    n++;
+  return n;
+}
+
+static u32 _wad_index_size(u32 count) {
+  u32 n = 16;
+  while (n < count * 2)
+    n <<= 1;
+  return n;
+}
+
+static void _wad_read_header(wad* w) {
+  makesure(w->view.size >= WAD_HEADER_LEN, "file is too small to be a wad");
+
+  wad_header* hp = (wad_header*)w->view.data;
+  memcpy(w->header.magic_code, hp->magic_code, WAD_MAGIC_CODE_LEN);
+  w->header.count = endian_i32(hp->count);
+  w->header.offset = endian_i32(hp->offset);
+
+  makesure(memcmp(w->header.magic_code, WAD_MAGIC_CODE, WAD_MAGIC_CODE_LEN) ==
+               0,
+           "invalid header magic code");
+  makesure(w->header.count >= 0, "invalid lump count");
+  makesure(w->header.offset >= (i32)WAD_HEADER_LEN &&
+               (sz)w->header.offset + (sz)w->header.count * WAD_LUMP_LEN <=
+                   w->view.size,
+           "invalid lump directory offset");
+}
+
+static void _wad_estimate(arena* m, wad* w) {
+  arena_begin_estimate(m);
+  arena_estimate_add(m, w->lumps_count * sizeof(wad_lump), alignof(wad_lump));
+  arena_estimate_add(m, _wad_index_size(w->lumps_count) * sizeof(u32),
+                     alignof(u32));
+  arena_end_estimate(m);
+}
+
+// The directory is copied out of the mapping in one go and fixed up in place
+static void _wad_read_lumps(arena* m, wad* w) {
+  sz ls = w->lumps_count * sizeof(wad_lump);
+  w->lumps = (wad_lump*)arena_alloc(m, ls, alignof(wad_lump));
+  notnull(w->lumps);
+
+  memcpy(w->lumps, w->view.data + w->header.offset, ls);
+  endian_i32_fields(w->lumps, w->lumps_count, sizeof(wad_lump), 0, 3);
+
+  for (u32 i = 0; i < w->lumps_count; i++) {
+    wad_lump* l = &w->lumps[i];
+    makesure(l->offset >= 0 && l->disk_size >= 0 &&
+                 (sz)l->offset + (sz)l->disk_size <= w->view.size,
+             "lump '%.16s' is out of bounds", l->name);
+  }
+}
+
+static void _wad_build_index(arena* m, wad* w) {
+  u32 n = _wad_index_size(w->lumps_count);
+  w->index = (u32*)arena_alloc(m, n * sizeof(u32), alignof(u32));
+  notnull(w->index);
+  memset(w->index, 0, n * sizeof(u32));
+  w->index_mask = n - 1;
+
+  // the first lump with a given name wins, W_GetLumpinfo in the engine
+  // walks the directory front to back and stops at the first match
+  for (u32 i = 0; i < w->lumps_count; i++) {
+    const u8* name = w->lumps[i].name;
+    sz len = _wad_name_len(name);
+    u32 at = (u32)hash_bytes_ci(name, len) & w->index_mask;
+
+    for (;; at = (at + 1) & w->index_mask) {
+      u32 slot = w->index[at];
+      if (!slot) {
+        w->index[at] = i + 1;
+        break;
+      }
+      const u8* other = w->lumps[slot - 1].name;
+      if (_wad_name_len(other) == len &&
+          !strncasecmp((cstr)other, (cstr)name, len))
+        break;
+    }
+  }
+}
+
+static void _wad_load(arena* m, wad* w) {
+  _wad_read_header(w);
+  w->lumps_count = (u32)w->header.count;
+
+  _wad_estimate(m, w);
+  _wad_read_lumps(m, w);
+  _wad_build_index(m, w);
+}
+
+static cstr _wad_extension(u8 type) {
+  switch (type) {
+    case WAD_TYPE_MIPTEX:
+      return "mip";
+    case WAD_TYPE_QPIC:
+    case WAD_TYPE_PALETTE:
+      return "lmp";
+    default:
+      return "bin";
+  }
+}
+
+// Builds '<dir>/<name>.<ext>', or '<dir>/<name>' when ext is NULL, replacing
+// characters that would escape 'dir'
+static void _wad_lump_path(char* buf, cstr dir, wad_lump* l, cstr ext) {
+  char name[WAD_LUMP_NAME_LEN + 1] = {0};
+  memcpy(name, l->name, _wad_name_len(l->name));
+  for (char* c = name; *c; c++) {
+    if (*c == '/' || *c == '\\')
+      *c = '_';
+  }
+  if (ext)
+    snprintf(buf, WAD_MAX_PATH_LEN + WAD_LUMP_NAME_LEN + 8, "%s/%s.%s", dir,
+             name, ext);
+  else
+    snprintf(buf, WAD_MAX_PATH_LEN + WAD_LUMP_NAME_LEN + 8, "%s/%s", dir,
+             name);
+}
+
+typedef struct {
+  wad* w;
+  cstr dir;
+  const wad_opts* o;
+  palette pal;  // index to RGBA, used with png
+  u32* lumps;   // lumps to write, one per distinct name
+} wad_extract_job;
+
+static void _wad_load_palette(wad* w, const wad_opts* o, palette* pal) {
+  if (o->palette) {
+    palette_load(pal, o->palette);
+    return;
+  }
+
+  i32 i = wad_find(w, "palette");
+  makesure(i >= 0 && w->lumps[i].disk_size >= (i32)WAD_PALETTE_LEN,
+           "the wad has no palette lump, pass one with --palette");
+  palette_from_rgb(pal, w->view.data + w->lumps[i].offset);
+}
+
+static bool _wad_png_miptex(wad_extract_job* job, wad_lump* l, cstr path) {
+  const u8* data = job->w->view.data + l->offset;
+  sz ds = l->disk_size;
+  if (ds < WAD_MIPTEX_LEN)
+    return false;
+
+  wad_miptex mt;
+  memcpy(&mt, data, sizeof(mt));
+  endian_i32_fields(&mt, 1, sizeof(mt), offsetof(wad_miptex, width), 6);
+
+  // every level is checked up front so a bad one falls back to a raw copy
+  // without leaving the PNGs of the levels before it behind
+  u32 levels = job->o->mips ? WAD_MIP_LEVELS : 1;
+  for (u32 m = 0; m < levels; m++) {
+    u32 mw = mt.width >> m;
+    u32 mh = mt.height >> m;
+    if (!mw || !mh || (sz)mt.offsets[m] + (sz)mw * mh > ds)
+      return false;
+  }
+
+  // names starting with '{' use index 255 as a cutout
+  bool cut = l->name[0] == '{';
+  for (u32 m = 0; m < levels; m++) {
+    char mp[WAD_MAX_PATH_LEN + WAD_LUMP_NAME_LEN + 24];
+    i32 n = m ? snprintf(mp, sizeof(mp), "%s_mip%u.png", path, m)
+              : snprintf(mp, sizeof(mp), "%s.png", path);
+    makesure(n > 0 && (sz)n < sizeof(mp), "path '%s' is too long", path);
+    palette_write_png(&job->pal, mp, data + mt.offsets[m], mt.width >> m,
+                      mt.height >> m, cut, job->o->level);
+  }
+  return true;
+}
+
+static bool _wad_png_qpic(wad_extract_job* job, wad_lump* l, cstr path) {
+  const u8* data = job->w->view.data + l->offset;
+  sz ds = l->disk_size;
+  if (ds < sizeof(wad_qpic))
+    return false;
+
+  wad_qpic qp;
+  memcpy(&qp, data, sizeof(qp));
+  qp.width = endian_i32(qp.width);
+  qp.height = endian_i32(qp.height);
+  if (qp.width <= 0 || qp.height <= 0 ||
+      sizeof(wad_qpic) + (sz)qp.width * qp.height > ds)
+    return false;
+
+  char mp[WAD_MAX_PATH_LEN + WAD_LUMP_NAME_LEN + 16];
+  snprintf(mp, sizeof(mp), "%s.png", path);
+  palette_write_png(&job->pal, mp, data + sizeof(wad_qpic), qp.width,
+                    qp.height, true, job->o->level);
+  return true;
+}
+
+static bool _wad_png_palette(wad_extract_job* job, wad_lump* l, cstr path) {
+  if (l->disk_size < (i32)WAD_PALETTE_LEN)
+    return false;
+
+  palette pal;
+  palette_from_rgb(&pal, job->w->view.data + l->offset);
+
+  u8 swatch[256];
+  for (u32 i = 0; i < 256; i++)
+    swatch[i] = (u8)i;
+
+  char mp[WAD_MAX_PATH_LEN + WAD_LUMP_NAME_LEN + 16];
+  snprintf(mp, sizeof(mp), "%s.png", path);
+  palette_write_png(&pal, mp, swatch, 16, 16, false, job->o->level);
+  return true;
+}
+
+static bool _wad_png_lump(wad_extract_job* job, wad_lump* l, cstr path) {
+  switch (l->type) {
+    case WAD_TYPE_MIPTEX:
+      return _wad_png_miptex(job, l, path);
+    case WAD_TYPE_QPIC:
+      return _wad_png_qpic(job, l, path);
+    case WAD_TYPE_PALETTE:
+      return _wad_png_palette(job, l, path);
+    default:
+      return false;
+  }
+}
+
+static void _wad_extract_lump(void* ctx, u32 i, u32 worker) {
+  wad_extract_job* job = (wad_extract_job*)ctx;
+  wad_lump* l = &job->w->lumps[job->lumps[i]];
+  char path[WAD_MAX_PATH_LEN + WAD_LUMP_NAME_LEN + 8];
+
+  if (l->compression) {
+    log_warn("skipping compressed lump '%.16s'", l->name);
+    return;
+  }
+
+  // picture lumps become PNGs, anything else (or malformed) is copied raw
+  if (job->o && job->o->png) {
+    _wad_lump_path(path, job->dir, l, NULL);
+    if (_wad_png_lump(job, l, path))
+      return;
+  }
+
+  _wad_lump_path(path, job->dir, l, _wad_extension(l->type));
+
+  sz is = l->disk_size;
+  file_writer fw;
+  file_writer_opts wo = {.flush_size = file_writer_flush_for(is),
+                         .prealloc = is,
+                         .direct = job->o && job->o->direct};
+  file_writer_open(path, &wo, &fw);
+  file_writer_write(&fw, job->w->view.data + l->offset, is);
+  file_writer_close(&fw);
+}
+
+typedef struct {
+  wad* w;
+  cstr dir;
+  const wad_opts* o;
+  palette pal;
+  char (*files)[WAD_MAX_PATH_LEN];  // input image per lump
+  u8** data;                        // encoded miptex per lump (malloc)
+} wad_create_job;
+
+static bool _wad_is_image(cstr name) {
+  cstr dot = strrchr(name, '.');
+  return dot && (!strcasecmp(dot, ".png") || !strcasecmp(dot, ".tga"));
+}
+
+// Images directly under 'dir', counted when 'job' is NULL, recorded otherwise
+static void _wad_collect(cstr dir, wad_create_job* job, u32* n) {
+  fs_iterator* it = fs_first(NULL, dir, FS_READ);
+  for (; it; it = fs_next(it)) {
+    if (it->info.directory || !_wad_is_image(it->pName))
+      continue;
+
+    sz len = strrchr(it->pName, '.') - it->pName;
+    makesure(len > 0 && len < WAD_LUMP_NAME_LEN,
+             "'%s' needs a name of 1 to %u characters to be a lump", it->pName,
+             WAD_LUMP_NAME_LEN - 1);
+
+    if (job) {
+      wad_lump* l = &job->w->lumps[*n];
+      memcpy(l->name, it->pName, len);
+      snprintf(job->files[*n], WAD_MAX_PATH_LEN, "%s/%s", dir, it->pName);
+    }
+    (*n)++;
+  }
+}
+
+static int _wad_lump_cmp(const void* a, const void* b) {
+  return strncasecmp((cstr)((const wad_lump*)a)->name,
+                     (cstr)((const wad_lump*)b)->name, WAD_LUMP_NAME_LEN);
+}
+
+static sz _wad_miptex_size(u32 width, u32 height) {
+  sz n = WAD_MIPTEX_LEN;
+  for (u32 m = 0; m < WAD_MIP_LEVELS; m++)
+    n += (sz)(width >> m) * (height >> m);
+  return n;
+}
+
+// Smaller levels are box filtered from the full colour image, level by
+// level, and each one is quantized on its own so no error accumulates. A
+// '{' texture leaves its cutout texels out of the colour average
+static void _wad_mips(wad_create_job* job,
+                      u8* data,
+                      const wad_miptex* mt,
+                      const u8* rgba) {
+  bool cut = mt->name[0] == '{';
+  sz n = (sz)mt->width * mt->height;
+  sz levels = n / 4 + n / 16 + n / 64;  // pixels in levels 1..3
+  u8* cur = (u8*)malloc(levels * 4);
+  u16* lin = NULL;
+  makesure(cur != NULL, "malloc failed");
+
+  if (job->o->gamma) {
+    lin = (u16*)malloc((n + levels) * 4 * sizeof(u16));
+    makesure(lin != NULL, "malloc failed");
+    mip_to_linear(lin, rgba, n);
+  }
+
+  const u8* src8 = rgba;
+  u8* dst8 = cur;
+  u16* src16 = lin;
+  u16* dst16 = lin ? lin + n * 4 : NULL;
+  for (u32 m = 1; m < WAD_MIP_LEVELS; m++) {
+    u32 pw = mt->width >> (m - 1);
+    u32 ph = mt->height >> (m - 1);
+    sz mn = (sz)(pw / 2) * (ph / 2);
+
+    if (lin) {
+      if (cut)
+        mip_cutout_rgba16(dst16, src16, pw, ph);
+      else
+        mip_box_rgba16(dst16, src16, pw, ph);
+      mip_from_linear(dst8, dst16, mn);
+      src16 = dst16;
+      dst16 += mn * 4;
+    } else if (cut) {
+      mip_cutout_rgba8(dst8, src8, pw, ph);
+    } else {
+      mip_box_rgba8(dst8, src8, pw, ph);
+    }
+
+    palette_quantize(&job->pal, data + mt->offsets[m], dst8, mn,
+                     !job->o->fast);
+    src8 = dst8;
+    dst8 += mn * 4;
+  }
+
+  free(lin);
+  free(cur);
+}
+
+static void _wad_create_lump(void* ctx, u32 i, u32 worker) {
+  wad_create_job* job = (wad_create_job*)ctx;
+  wad_lump* l = &job->w->lumps[i];
+  cstr path = job->files[i];
+
+  int width, height, comp;
+  u8* rgba = stbi_load(path, &width, &height, &comp, 4);
+  makesure(rgba != NULL, "failed to load '%s': %s", path,
+           stbi_failure_reason());
+  makesure(width > 0 && height > 0 && width % WAD_MIPTEX_ALIGN == 0 &&
+               height % WAD_MIPTEX_ALIGN == 0,
+           "'%s' is %dx%d, miptex sides must be multiples of %u", path, width,
+           height, WAD_MIPTEX_ALIGN);
+
+  wad_miptex mt = {0};
+  memcpy(mt.name, l->name, WAD_LUMP_NAME_LEN);
+  mt.width = (u32)width;
+  mt.height = (u32)height;
+  mt.offsets[0] = WAD_MIPTEX_LEN;
+  for (u32 m = 1; m < WAD_MIP_LEVELS; m++)
+    mt.offsets[m] = mt.offsets[m - 1] + (mt.width >> (m - 1)) *
+                                            (mt.height >> (m - 1));
+
+  sz size = _wad_miptex_size(mt.width, mt.height);
+  u8* data = (u8*)malloc(size);
+  makesure(data != NULL, "malloc failed");
+
+  palette_quantize(&job->pal, data + mt.offsets[0], rgba,
+                   (sz)mt.width * mt.height, !job->o->fast);
+  _wad_mips(job, data, &mt, rgba);
+  stbi_image_free(rgba);
+
+  wad_miptex* hp = (wad_miptex*)data;
+  memcpy(hp, &mt, sizeof(mt));
+  endian_i32_fields(hp, 1, sizeof(mt), offsetof(wad_miptex, width), 6);
+
+  job->data[i] = data;
+  l->type = WAD_TYPE_MIPTEX;
+  l->size = l->disk_size = (i32)size;
+}
+
+/*****************************
+ * EXPORTED FUNCTIONS
+ *****************************/
+
+void wad_open(arena* m, cstr path, wad* w) {
+  file_view_open(path, &w->view);
+  _wad_load(m, w);
+}
+
+void wad_open_mem(arena* m, const u8* data, sz size, wad* w) {
+  // a borrowed view has no descriptor, closing it leaves 'data' alone
+  w->view = (file_view){.fd = -1, .data = (u8*)data, .size = size};
+  _wad_load(m, w);
+}
+
+void wad_close(wad* w) {
+  if (w->view.fd >= 0)
+    file_view_close(&w->view);
+  w->view = (file_view){.fd = -1};
+  w->lumps = NULL;
+  w->index = NULL;
+  w->lumps_count = 0;
+}
+
+i32 wad_find(wad* w, cstr name) {
+  sz len = strnlen(name, WAD_LUMP_NAME_LEN);
+  u32 at = (u32)hash_bytes_ci(name, len) & w->index_mask;
+
+  for (;; at = (at + 1) & w->index_mask) {
+    u32 slot = w->index[at];
+    if (!slot)
+      return -1;
+    const u8* other = w->lumps[slot - 1].name;
+    if (_wad_name_len(other) == len && !strncasecmp((cstr)other, name, len))
+      return (i32)(slot - 1);
+  }
+}
+
+cstr wad_type_name(u8 type) {
+  switch (type) {
+    case WAD_TYPE_NONE:
+      return "none";
+    case WAD_TYPE_LABEL:
+      return "label";
+    case WAD_TYPE_PALETTE:
+      return "palette";
+    case WAD_TYPE_QTEX:
+      return "qtex";
+    case WAD_TYPE_QPIC:
+      return "qpic";
+    case WAD_TYPE_SOUND:
+      return "sound";
+    case WAD_TYPE_MIPTEX:
+      return "miptex";
+    default:
+      return "unknown";
+  }
+}
+
+waderr wad_info(arena* m, cstr path, wad* w) {
+  wad_open(m, path, w);
+
+  u32 types[256] = {0};
+  for (u32 i = 0; i < w->lumps_count; i++)
+    types[w->lumps[i].type]++;
+
+  printf("************** INFO **************\n");
+  printf("↬ file name:      '%s'\n", path);
+  printf("↬ file size:      '%zu MB (%zu Bytes)'\n", w->view.size / 1000000,
+         w->view.size);
+  printf("↬ lumps counts:   '%u'\n", w->lumps_count);
+  for (u32 t = 0; t < 256; t++) {
+    if (types[t])
+      printf("↬   %-8s      '%u'\n", wad_type_name((u8)t), types[t]);
+  }
+
+  wad_close(w);
+  return WAD_ERR_OK;
+}
+
+waderr wad_list(arena* m, cstr path, wad* w) {
+  wad_open(m, path, w);
+
+  printf("************** LUMPS **************\n");
+  printf("       (index | name | type | size)\n");
+  for (u32 i = 0; i < w->lumps_count; i++) {
+    wad_lump* l = &w->lumps[i];
+    printf("↬ [%u] %.16s : %s : %.2f MB (%d Bytes)\n", i + 1, l->name,
+           wad_type_name(l->type), (f32)l->disk_size / 1000000, l->disk_size);
+  }
+
+  wad_close(w);
+  return WAD_ERR_OK;
+}
+
+waderr wad_extract(arena* m, cstr path, cstr odir, const wad_opts* o, wad* w) {
+  makesure(
+      strlen(odir) < WAD_MAX_PATH_LEN,
+      "output director '%s' path length is larger than supported max of '%d'",
+      odir, WAD_MAX_PATH_LEN);
+
+  fs_file_info od;
+  makesure(fs_info(NULL, odir, FS_READ, &od) != FS_SUCCESS,
+           "the output directory at '%s' already exists", odir);
+  makesure(fs_mkdir(NULL, odir, 0) == FS_SUCCESS,
+           "failed to create directory '%s'", odir);
+
+  wad_open(m, path, w);
+  file_view_advise(&w->view, 0, w->view.size, FILE_ADVICE_SEQUENTIAL);
+
+  // duplicate names map to one output path, so only the lump a lookup would
+  // find is written, otherwise two workers race on the same file
+  u32* lumps = (u32*)malloc((w->lumps_count ? w->lumps_count : 1) *
+                            sizeof(u32));
+  makesure(lumps != NULL, "malloc failed");
+  u32 n = 0;
+  for (u32 i = 0; i < w->lumps_count; i++) {
+    if (wad_find(w, (cstr)w->lumps[i].name) == (i32)i)
+      lumps[n++] = i;
+    else
+      log_warn("skipping duplicate lump '%.16s'", w->lumps[i].name);
+  }
+
+  wad_extract_job job = {.w = w, .dir = odir, .o = o, .lumps = lumps};
+  if (o && o->png)
+    _wad_load_palette(w, o, &job.pal);
+  thread_parallel_for(n, _wad_extract_lump, &job);
+
+  free(lumps);
+  wad_close(w);
+  return WAD_ERR_OK;
+}
+
+waderr wad_create(arena* m, cstr dir, cstr path, const wad_opts* o, wad* w) {
+  makesure(strlen(dir) < WAD_MAX_PATH_LEN - WAD_LUMP_NAME_LEN - 8,
+           "input director '%s' path length is larger than supported max of "
+           "'%d'",
+           dir, WAD_MAX_PATH_LEN);
+  makesure(o && o->palette, "creating a wad needs a palette, pass --palette");
+
+  fs_file_info fi;
+  makesure(fs_info(NULL, dir, FS_READ, &fi) == FS_SUCCESS && fi.directory,
+           "the input directory at '%s' does not exist", dir);
+
+  wad_create_job job = {.w = w, .dir = dir, .o = o};
+
+  u32 fc = 0;
+  arena_begin_estimate(m);
+  _wad_collect(dir, NULL, &fc);
+  makesure(fc > 0, "no png or tga images found under '%s'", dir);
+  arena_estimate_add(m, fc * sizeof(wad_lump), alignof(wad_lump));
+  arena_estimate_add(m, fc * sizeof(*job.files), alignof(char));
+  arena_estimate_add(m, fc * sizeof(u8*), alignof(u8*));
+  arena_end_estimate(m);
+
+  w->lumps = (wad_lump*)arena_alloc(m, fc * sizeof(wad_lump), alignof(wad_lump));
+  job.files = (typeof(job.files))arena_alloc(m, fc * sizeof(*job.files), 1);
+  job.data = (u8**)arena_alloc(m, fc * sizeof(u8*), alignof(u8*));
+  notnull(w->lumps);
+  notnull(job.files);
+  notnull(job.data);
+  memset(w->lumps, 0, fc * sizeof(wad_lump));
+
+  u32 n = 0;
+  _wad_collect(dir, &job, &n);
+  makesure(n == fc, "the input directory changed while packing");
+  w->lumps_count = fc;
+
+  // sort by name so the output is stable, offset holds the input index until
+  // the real offsets are known
+  for (u32 i = 0; i < fc; i++)
+    w->lumps[i].offset = (i32)i;
+  qsort(w->lumps, fc, sizeof(wad_lump), _wad_lump_cmp);
+
+  char(*files)[WAD_MAX_PATH_LEN] = malloc(fc * sizeof(*job.files));
+  makesure(files != NULL, "malloc failed");
+  for (u32 i = 0; i < fc; i++)
+    memcpy(files[i], job.files[w->lumps[i].offset], WAD_MAX_PATH_LEN);
+  memcpy(job.files, files, fc * sizeof(*job.files));
+  free(files);
+
+  for (u32 i = 1; i < fc; i++) {
+    makesure(_wad_lump_cmp(&w->lumps[i - 1], &w->lumps[i]) != 0,
+             "two images map to the lump '%.16s'", w->lumps[i].name);
+  }
+
+  // fullbrights glow in the dark in game, leave them out unless asked,
+  // 255 is reserved for the '{' cutout
+  palette_load(&job.pal, o->palette);
+  palette_build_quant(&job.pal, 0,
+                      o->fullbright ? PALETTE_TRANSPARENT - 1
+                                    : PALETTE_FULLBRIGHTS - 1);
+
+  thread_parallel_for(fc, _wad_create_lump, &job);
+  palette_free(&job.pal);
+
+  i64 of = WAD_HEADER_LEN;
+  for (u32 i = 0; i < fc; i++) {
+    w->lumps[i].offset = (i32)of;
+    of += w->lumps[i].disk_size;
+    makesure(of <= INT32_MAX, "the wad would be larger than 2GB");
+  }
+
+  memcpy(w->header.magic_code, WAD_MAGIC_CODE, WAD_MAGIC_CODE_LEN);
+  w->header.count = (i32)fc;
+  w->header.offset = (i32)of;
+
+  file_writer fw;
+  file_writer_opts wo = {.prealloc = (u64)of + fc * WAD_LUMP_LEN,
+                         .direct = o->direct};
+  file_writer_open(path, &wo, &fw);
+
+  wad_header hd;
+  memcpy(hd.magic_code, WAD_MAGIC_CODE, WAD_MAGIC_CODE_LEN);
+  hd.count = endian_i32(w->header.count);
+  hd.offset = endian_i32(w->header.offset);
+  file_writer_write(&fw, &hd, WAD_HEADER_LEN);
+
+  for (u32 i = 0; i < fc; i++) {
+    file_writer_write(&fw, job.data[i], w->lumps[i].disk_size);
+    free(job.data[i]);
+  }
+
+  for (u32 i = 0; i < fc; i++) {
+    wad_lump l = w->lumps[i];
+    endian_i32_fields(&l, 1, sizeof(l), 0, 3);
+    file_writer_write(&fw, &l, WAD_LUMP_LEN);
+  }
+  file_writer_close(&fw);
+
+  sz total = (sz)of + fc * WAD_LUMP_LEN;
+  printf("************** CREATE **************\n");
+  printf("↬ file name:      '%s'\n", path);
+  printf("↬ file size:      '%zu MB (%zu Bytes)'\n", total / 1000000, total);
+  printf("↬ lumps counts:   '%u'\n", fc);
+
+  return WAD_ERR_OK;
+}
+
+#endif  // WAD_IMPLEMENTATION
+#endif  //_WAD_HEADER_
@@ -0,0 +1,113 @@
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../src/img/img.h"
+#include "test.h"
+
+// Every kernel against the plain per-pixel loop a converter would otherwise
+// write, in ns per pixel, the best of a few runs over a buffer that does not
+// fit the caches. Only meaningful for an optimized build, and the vector
+// paths only run when the build targets them (--native)
+
+static constexpr sz BENCH_PIXELS = 4 << 20;
+static constexpr u32 BENCH_RUNS = 9;
+
+static f64 _now(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (f64)t.tv_sec + (f64)t.tv_nsec / 1e9;
+}
+
+typedef struct {
+  u32* rgba;
+  u8* index;
+  u8* cube;
+  u32 lut[256];
+} bench_data;
+
+static void _ref_expand(bench_data* d) {
+  for (sz i = 0; i < BENCH_PIXELS; i++)
+    d->rgba[i] = d->lut[d->index[i]];
+}
+
+static void _img_expand(bench_data* d) {
+  img_expand(d->rgba, d->index, BENCH_PIXELS, d->lut);
+}
+
+static void _ref_mask(bench_data* d) {
+  for (sz i = 0; i < BENCH_PIXELS; i++) {
+    if (d->index[i] == 255)
+      d->rgba[i] = 0;
+  }
+}
+
+static void _img_mask(bench_data* d) {
+  img_mask_index(d->rgba, d->index, BENCH_PIXELS, 255);
+}
+
+static void _ref_quantize(bench_data* d) {
+  const u8* p = (const u8*)d->rgba;
+  for (sz i = 0; i < BENCH_PIXELS; i++, p += 4) {
+    u32 c = ((u32)(p[0] >> 3) << 10) | ((u32)(p[1] >> 3) << 5) | (p[2] >> 3);
+    d->index[i] = p[3] < 128 ? 255 : d->cube[c];
+  }
+}
+
+static void _img_quantize(bench_data* d) {
+  img_quantize_lut(d->index, (const u8*)d->rgba, BENCH_PIXELS, d->cube, 5,
+                   255);
+}
+
+static f64 _time(void (*fn)(bench_data*), bench_data* d) {
+  f64 best = 0;
+  for (u32 r = 0; r < BENCH_RUNS; r++) {
+    f64 t0 = _now();
+    fn(d);
+    f64 t = _now() - t0;
+    best = !r || t < best ? t : best;
+  }
+  return best * 1e9 / (f64)BENCH_PIXELS;
+}
+
+void bench_img(void) {
+  bench_data d = {0};
+  d.rgba = (u32*)malloc(BENCH_PIXELS * sizeof(u32));
+  d.index = (u8*)malloc(BENCH_PIXELS);
+  d.cube = (u8*)malloc(((sz)1 << 15) + 3);
+  if (!d.rgba || !d.index || !d.cube) {
+    printf("bench_img: malloc failed\n");
+    goto done;
+  }
+
+  u32 seed = 0x9E3779B9;
+  for (u32 i = 0; i < 256; i++)
+    d.lut[i] = test_rand(&seed);
+  for (sz i = 0; i < ((sz)1 << 15) + 3; i++)
+    d.cube[i] = (u8)test_rand(&seed);
+  for (sz i = 0; i < BENCH_PIXELS; i++) {
+    d.index[i] = (u8)test_rand(&seed);
+    d.rgba[i] = test_rand(&seed);
+  }
+
+  static const struct {
+    cstr name;
+    void (*kernel)(bench_data*);
+    void (*ref)(bench_data*);
+  } benches[] = {
+      {"img_expand", _img_expand, _ref_expand},
+      {"img_mask_index", _img_mask, _ref_mask},
+      {"img_quantize_lut", _img_quantize, _ref_quantize},
+  };
+  for (u32 i = 0; i < sizeof(benches) / sizeof(*benches); i++) {
+    f64 k = _time(benches[i].kernel, &d);
+    f64 r = _time(benches[i].ref, &d);
+    printf("%-18s %6.3f ns/px  per-pixel loop %6.3f ns/px  x%.2f\n",
+           benches[i].name, k, r, r / k);
+  }
+
+done:
+  free(d.cube);
+  free(d.index);
+  free(d.rgba);
+}
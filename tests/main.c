@@ -0,0 +1,39 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "test.h"
+
+static const struct {
+  char name[32];
+  test_fn fn;
+} tests[] = {
+    {"img_expand", test_img_expand},
+    {"img_mask_index", test_img_mask_index},
+    {"img_quantize_lut", test_img_quantize_lut},
+    {"mip_cutout", test_mip_cutout},
+    {"pak_fs_stream", test_pak_fs_stream},
+    {"pak_fs_mapped", test_pak_fs_mapped},
+    {"pool_reuse", test_pool_reuse},
+    {"pool_grow", test_pool_grow},
+    {"intern_identity", test_intern_identity},
+};
+
+int main(int argc, char** argv) {
+  if (argc > 1 && !strcmp(argv[1], "--bench")) {
+    bench_img();
+    return EXIT_SUCCESS;
+  }
+
+  u32 failed = 0;
+  u32 n = sizeof(tests) / sizeof(*tests);
+  for (u32 i = 0; i < n; i++) {
+    bool ok = tests[i].fn();
+    printf("%s %s\n", ok ? "ok  " : "FAIL", tests[i].name);
+    failed += !ok;
+  }
+
+  printf("%u/%u passed\n", n - failed, n);
+  return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,316 @@
+#!/bin/sh
+# End-to-end round trips through the sqt binary, every section builds its
+# input from a generated tree and checks the output byte for byte.
+#
+#   tests/roundtrip.sh [SQT]    (defaults to BUILD/sqt)
+
+set -u
+
+SQT=$(cd "$(dirname "${1:-BUILD/sqt}")" && pwd)/$(basename "${1:-BUILD/sqt}")
+WORK=$(mktemp -d "${TMPDIR:-/tmp}/sqt-roundtrip.XXXXXX")
+trap 'rm -rf "$WORK"' EXIT
+cd "$WORK" || exit 1
+
+passed=0
+failed=0
+
+ok() {
+  printf 'ok   %s\n' "$1"
+  passed=$((passed + 1))
+}
+
+fail() {
+  printf 'FAIL %s\n' "$1"
+  failed=$((failed + 1))
+}
+
+# check NAME COMMAND... runs the command quietly and records the result
+check() {
+  name=$1
+  shift
+  if "$@" >/dev/null 2>&1; then ok "$name"; else fail "$name"; fi
+}
+
+sqt() {
+  "$SQT" "$@" >/dev/null 2>&1
+}
+
+# A small mod tree: nested directories, an empty file, a file named like a
+# directory next to it, text that deflates well and a binary blob bigger
+# than one pakz chunk
+mktree() {
+  mkdir -p "$1/maps" "$1/sound/ambience" "$1/gfx"
+  i=0
+  while [ $i -lt 40 ]; do
+    printf 'sample %d\n' $i >"$1/sound/ambience/s$i.wav"
+    i=$((i + 1))
+  done
+  seq 1 20000 >"$1/maps/e1m1.ent"
+  : >"$1/gfx/empty.lmp"
+  printf 'WAD2' >"$1/gfx.wad"
+  awk 'BEGIN { srand(7); for (i = 0; i < 300000; i++)
+               printf "%c", int(rand() * 94) + 33 }' >"$1/maps/e1m1.bsp"
+  printf 'progs\n' >"$1/progs.dat"
+}
+
+mktree src
+sqt pak create -i src -o base.pak || { echo "cannot create base.pak"; exit 1; }
+
+# ---- pak create: every file of the tree makes it in
+
+sqt pak extract -i base.pak -o basex
+check "create keeps every file" diff -r src basex
+check "create keeps gfx.wad next to gfx/" test -f basex/gfx.wad
+
+# ---- pak convert: pak -> pk3 -> pak keeps every entry and byte
+
+sqt pak convert -i base.pak -o base.pk3
+sqt pak convert -i base.pk3 -o back.pak
+sqt pk3 extract -i base.pk3 -o pk3x
+sqt pak extract -i back.pak -o backx
+check "convert pak to pk3" diff -r src pk3x
+check "convert pk3 to pak" diff -r src backx
+check "convert level 0 stores" sqt pak convert -i base.pak -o store.pk3 \
+  --level 0
+check "convert rejects --level 10" \
+  sh -c '! "$0" pak convert -i base.pak -o x.pk3 --level 10' "$SQT"
+
+# a flipped byte in the middle of the archive fails a crc, convert must
+# exit non-zero and leave neither the output nor its temporary behind
+cp base.pk3 bad.pk3
+half=$(($(wc -c <bad.pk3) / 2))
+printf '\377' | dd of=bad.pk3 bs=1 seek=$half conv=notrunc 2>/dev/null
+check "convert fails on a corrupt pk3" \
+  sh -c '! "$0" pak convert -i bad.pk3 -o bad.pak' "$SQT"
+check "convert leaves no partial output" \
+  sh -c '[ ! -e bad.pak ] && [ ! -e bad.pak.tmp ]'
+
+# ---- pakz: deflate -> inflate is lossless, cat reads single entries
+
+sqt pak deflate -i base.pak -o base.pakz --chunk 64
+sqt pak inflate -i base.pakz -o inflated.pak
+check "pakz deflate/inflate" cmp base.pak inflated.pak
+sqt pak deflate -i base.pak -o store.pakz --level 0
+sqt pak inflate -i store.pakz -o stored.pak
+check "pakz level 0" cmp base.pak stored.pak
+sqt pak cat -i base.pakz -o cat.bsp maps/e1m1.bsp
+check "pakz cat" cmp src/maps/e1m1.bsp cat.bsp
+check "pakz cat of a missing entry fails" \
+  sh -c '! "$0" pak cat -i base.pakz -o none nope.txt' "$SQT"
+# the arena report must not end up in the entry bytes on stdout
+"$SQT" --mem-stats pak cat -i base.pakz maps/e1m1.bsp >stats.bsp 2>/dev/null
+check "pakz cat to stdout with --mem-stats" cmp src/maps/e1m1.bsp stats.bsp
+
+# ---- pak compact: the layout changes, the entries do not
+
+"$SQT" pak compact -i base.pak -o aligned.pak --align 4096 >align.log 2>&1
+"$SQT" pak compact -i aligned.pak -o packed.pak >pack.log 2>&1
+sqt pak extract -i aligned.pak -o alignedx
+check "compact --align" diff -r src alignedx
+check "compact drops the padding" cmp base.pak packed.pak
+
+# padding is reported apart from what was reclaimed, the same as pak info
+
+# bytes LOG FIELD prints the byte count a '↬ FIELD: ...' line reports
+bytes() {
+  sed -n "s/.*$2: *'\([0-9]*\) Bytes.*/\1/p" "$1"
+}
+
+"$SQT" pak info -i aligned.pak >info.log 2>&1
+pad=$(bytes info.log padding)
+check "info reports the alignment padding" test "${pad:-0}" -gt 0
+check "compact --align reports its padding like info" \
+  test "$(bytes align.log padding)" = "$pad"
+check "compact --align reclaims nothing from a packed pak" \
+  test "$(bytes align.log reclaimed)" = 0
+check "compact reclaims the padding it drops" \
+  test "$(bytes pack.log reclaimed)" = "$pad"
+
+# --order lays data out in trace order. Comments, blank lines, names the pak
+# does not hold and repeats are skipped, untraced entries follow
+mkdir -p ord/maps ord/sound
+printf 'DATA-MAP' >ord/maps/e1m1.bsp
+printf 'DATA-PROGS' >ord/progs.dat
+printf 'DATA-SOUND' >ord/sound/s.wav
+printf 'DATA-CFG' >ord/autoexec.cfg
+printf '# load order\nsound/s.wav\n\nnope.txt\nsound/s.wav\n  progs.dat  \n' \
+  >trace.txt
+printf 'maps/e1m1.bsp\n' >retrace.txt
+
+# at FILE DATA prints the byte offset DATA starts at in FILE
+at() {
+  grep -abo "$2" "$1" | head -n 1 | cut -d: -f1
+}
+
+# laid FILE DATA... checks the DATA follow one another from the header on
+laid() {
+  f=$1
+  shift
+  last=11
+  for d in "$@"; do
+    o=$(at "$f" "$d")
+    [ -n "$o" ] && [ "$o" -gt "$last" ] || return 1
+    last=$o
+  done
+  [ "$(at "$f" "$1")" -eq 12 ]
+}
+
+sqt pak create -i ord -o ord.pak --order trace.txt
+check "create --order puts the trace first" \
+  laid ord.pak DATA-SOUND DATA-PROGS DATA-CFG DATA-MAP
+sqt pak compact -i ord.pak -o ordc.pak
+check "compact without a trace keeps the layout" cmp ord.pak ordc.pak
+sqt pak compact -i ord.pak -o ordr.pak --order retrace.txt
+check "compact --order lays out again, the rest keeps its order" \
+  laid ordr.pak DATA-MAP DATA-SOUND DATA-PROGS DATA-CFG
+sqt pak extract -i ordr.pak -o ordx
+check "compact --order keeps every entry" diff -r ord ordx
+
+# the input stays mapped while compact writes, the output naming the same
+# file under another spelling must not truncate it first
+cp aligned.pak self.pak
+sqt pak compact -i self.pak -o ./self.pak
+check "compact onto itself" cmp base.pak self.pak
+check "compact leaves no temporary" test ! -e self.pak.tmp
+
+# ---- pak extract --update: rewrites what changed, prunes only its own files
+
+cp -R src small
+rm -r small/sound small/maps/e1m1.ent
+printf 'progs 2\n' >small/progs.dat
+sqt pak create -i small -o small.pak
+
+sqt pak extract -i base.pak -o up --update
+printf 'mine\n' >up/keep.txt
+mkdir -p elsewhere
+mv up/sound elsewhere/sound
+ln -s ../elsewhere/sound up/sound
+sqt pak extract -i small.pak -o up --update
+check "update rewrites a changed entry" cmp small/progs.dat up/progs.dat
+check "update prunes a dropped entry" test ! -e up/maps/e1m1.ent
+check "update keeps files it did not write" test -f up/keep.txt
+check "update does not follow symlinks" \
+  test -f elsewhere/sound/ambience/s0.wav
+
+# a tree extracted without --update has no manifest, nothing is pruned
+sqt pak extract -i base.pak -o plain
+sqt pak extract -i small.pak -o plain --update
+check "update without a manifest prunes nothing" test -f plain/maps/e1m1.ent
+check "update without a manifest still writes" \
+  cmp small/progs.dat plain/progs.dat
+
+# ---- pak create --watch: mirrors the tree, survives losing every file
+
+# waitfor COMMAND... retries the command for up to ~5s until it succeeds
+waitfor() {
+  t=0
+  until "$@" >/dev/null 2>&1; do
+    [ $t -ge 50 ] && return 1
+    sleep 0.1
+    t=$((t + 1))
+  done
+}
+
+# mirrored PAK DIR, the pak extracts to exactly the tree in DIR
+mirrored() {
+  rm -rf mirror && "$SQT" pak extract -i "$1" -o mirror && diff -r "$2" mirror
+}
+
+cp -R small live
+"$SQT" pak create -i live -o live.pak --watch >watch.log 2>&1 &
+watcher=$!
+waitfor grep -q WATCH watch.log
+printf 'new\n' >live/new.txt
+check "watch picks up a new file" waitfor mirrored live.pak live
+
+# deleting everything leaves an empty directory, which must not bring the
+# watcher down when it weighs compacting
+rm -r live/*
+waitfor sh -c '[ "$(grep -c refreshed watch.log)" -ge 2 ]'
+sleep 0.5
+check "watch survives every file going away" kill -0 $watcher
+cp -R small/. live
+check "watch recovers once files return" waitfor mirrored live.pak small
+kill $watcher 2>/dev/null
+wait $watcher 2>/dev/null
+
+# ---- pak grep: exits like grep, zero only when something matched
+
+check "grep finds a match" sqt pak grep progs -i base.pak small.pak
+check "grep --hex finds a match" sqt pak grep --hex '70 72 6f 67' -i base.pak
+check "grep fails without a match" \
+  sh -c '! "$0" pak grep no-such-bytes -i base.pak' "$SQT"
+check "grep fails without a pattern" sh -c '! "$0" pak grep -i base.pak' \
+  "$SQT"
+
+# ---- pak resolve: the search path picks the same file the engine would
+
+# le32 N writes N as four little-endian bytes
+le32() {
+  printf "$(printf '\\%03o\\%03o\\%03o\\%03o' $(($1 & 255)) \
+    $(($1 >> 8 & 255)) $(($1 >> 16 & 255)) $(($1 >> 24 & 255)))"
+}
+
+# longpak OUT COUNT writes a pak of empty entries whose names fill all 56
+# bytes of the name field, with no terminator; pak create cannot make one
+longpak() {
+  {
+    printf 'PACK'
+    le32 12
+    le32 $(($2 * 64))
+    i=0
+    while [ $i -lt "$2" ]; do
+      printf 'maps/%044d%03d.bsp' 0 $i
+      le32 12
+      le32 0
+      i=$((i + 1))
+    done
+  } >"$1"
+}
+
+# resolves BASE NAME SOURCE [GAME]... checks NAME comes from SOURCE
+resolves() {
+  base=$1
+  entry=$2
+  from=$3
+  shift 3
+  games=
+  for g in "$@"; do games="$games -g $g"; done
+  # shellcheck disable=SC2086
+  "$SQT" pak resolve -b "$base" $games "$entry" 2>/dev/null |
+    grep -qF " $entry : $from :"
+}
+
+mkdir -p v0/maps v0/gfx v1 v2/maps vbase/id1/gfx vbase/mod vlong/id1
+printf 'id1 pak0\n' >v0/progs.dat
+printf 'id1 map\n' >v0/maps/e1m1.bsp
+printf 'pak conback\n' >v0/gfx/conback.lmp
+printf 'id1 pak1\n' >v1/progs.dat
+printf 'mod map\n' >v2/maps/e1m1.bsp
+sqt pak create -i v0 -o vbase/id1/pak0.pak
+sqt pak create -i v1 -o vbase/id1/pak1.pak
+sqt pak create -i v2 -o vbase/mod/pak0.pak
+printf 'loose conback\n' >vbase/id1/gfx/conback.lmp
+printf 'loose only\n' >vbase/id1/autoexec.cfg
+longpak vlong/id1/pak0.pak 40
+
+check "resolve pak1 over pak0" resolves vbase progs.dat vbase/id1/pak1.pak
+check "resolve id1 without a mod" \
+  resolves vbase maps/e1m1.bsp vbase/id1/pak0.pak
+check "resolve mod over id1" \
+  resolves vbase maps/e1m1.bsp vbase/mod/pak0.pak mod
+check "resolve id1 under a mod" \
+  resolves vbase progs.dat vbase/id1/pak1.pak mod
+check "resolve pak over a loose file" \
+  resolves vbase gfx/conback.lmp vbase/id1/pak0.pak
+check "resolve a loose file" resolves vbase autoexec.cfg vbase/id1
+
+# nothing else in the mount, so no shorter name leaves slack in the arena
+long=$(printf 'maps/%044d%03d.bsp' 0 39)
+check "resolve 56 character names" \
+  resolves vlong "$long" vlong/id1/pak0.pak
+check "resolve fails on a missing name" \
+  sh -c '! "$0" pak resolve -b vbase nope.txt' "$SQT"
+
+printf '%d/%d passed\n' $passed $((passed + failed))
+[ $failed -eq 0 ]
@@ -0,0 +1,49 @@
+#ifndef _TEST_HEADER_
+#define _TEST_HEADER_
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "../src/utils/types.h"
+
+// Each test is a function returning true when every check in it holds, the
+// first failing check prints where it is and ends the test
+#define check(expr)                                                  \
+  do {                                                               \
+    if (!(expr)) {                                                   \
+      printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #expr); \
+      return false;                                                  \
+    }                                                                \
+  } while (0)
+
+typedef bool (*test_fn)(void);
+
+// Deterministic xorshift so failures reproduce
+static inline u32 test_rand(u32* state) {
+  u32 x = *state;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  return *state = x;
+}
+
+/* ****************** img ****************** */
+bool test_img_expand(void);
+bool test_img_mask_index(void);
+bool test_img_quantize_lut(void);
+bool test_mip_cutout(void);
+
+/* ****************** pak_fs ****************** */
+bool test_pak_fs_stream(void);
+bool test_pak_fs_mapped(void);
+
+/* ****************** utils ****************** */
+bool test_pool_reuse(void);
+bool test_pool_grow(void);
+bool test_intern_identity(void);
+
+/* ****************** bench ****************** */
+// 'tests --bench' runs these instead of the tests, each prints its own lines
+void bench_img(void);
+
+#endif  // _TEST_HEADER_
@@ -0,0 +1,121 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "../src/img/img.h"
+#include "../src/img/mip.h"
+#include "test.h"
+
+// The pixel kernels run their vector loop over whole blocks and finish with
+// a scalar tail. Calling them one pixel at a time only ever reaches the tail,
+// so comparing that against one bulk call checks the vector path against the
+// scalar one. Build with --native or the bulk call is scalar too.
+
+static constexpr sz PIXELS = 1031;  // not a multiple of any vector width
+
+bool test_img_expand(void) {
+  u32 seed = 0x9E3779B9;
+  u32 lut[256];
+  u8 src[PIXELS];
+  for (u32 i = 0; i < 256; i++)
+    lut[i] = test_rand(&seed);
+  for (sz i = 0; i < PIXELS; i++)
+    src[i] = (u8)test_rand(&seed);
+
+  u32 bulk[PIXELS];
+  u32 one[PIXELS];
+  img_expand(bulk, src, PIXELS, lut);
+  for (sz i = 0; i < PIXELS; i++)
+    img_expand(one + i, src + i, 1, lut);
+
+  check(!memcmp(bulk, one, sizeof(bulk)));
+  return true;
+}
+
+bool test_img_mask_index(void) {
+  u32 seed = 0x2545F491;
+  u8 src[PIXELS];
+  u32 bulk[PIXELS];
+  u32 one[PIXELS];
+  for (sz i = 0; i < PIXELS; i++) {
+    // a small index range so the masked index shows up often
+    src[i] = (u8)(250 + test_rand(&seed) % 6);
+    bulk[i] = one[i] = test_rand(&seed) | 1;
+  }
+
+  img_mask_index(bulk, src, PIXELS, 255);
+  for (sz i = 0; i < PIXELS; i++)
+    img_mask_index(one + i, src + i, 1, 255);
+
+  check(!memcmp(bulk, one, sizeof(bulk)));
+  for (sz i = 0; i < PIXELS; i++)
+    check((bulk[i] == 0) == (src[i] == 255));
+  return true;
+}
+
+bool test_img_quantize_lut(void) {
+  for (u32 bits = 4; bits <= 6; bits++) {
+    u32 seed = 0xB5297A4D + bits;
+
+    // readable 3 bytes past the end, as img_quantize_lut asks
+    sz cells = (sz)1 << (3 * bits);
+    u8* cube = (u8*)malloc(cells + 3);
+    check(cube != NULL);
+    for (sz c = 0; c < cells + 3; c++)
+      cube[c] = (u8)test_rand(&seed);
+
+    // alpha cycles around the 128 cutoff so both sides of it are covered
+    u8 rgba[PIXELS * 4];
+    for (sz i = 0; i < PIXELS; i++) {
+      u32 px = test_rand(&seed);
+      memcpy(rgba + i * 4, &px, 3);
+      rgba[i * 4 + 3] = (u8)(125 + i % 6);
+    }
+
+    u8 bulk[PIXELS];
+    u8 one[PIXELS];
+    img_quantize_lut(bulk, rgba, PIXELS, cube, bits, 255);
+    for (sz i = 0; i < PIXELS; i++)
+      img_quantize_lut(one + i, rgba + i * 4, 1, cube, bits, 255);
+    free(cube);
+
+    check(!memcmp(bulk, one, sizeof(bulk)));
+    for (sz i = 0; i < PIXELS; i++) {
+      if (rgba[i * 4 + 3] < 128)
+        check(bulk[i] == 255);
+    }
+  }
+  return true;
+}
+
+bool test_mip_cutout(void) {
+  // one 2x2 block: two opaque red texels, two clear ones hiding bright green
+  const u8 red[4] = {200, 0, 0, 255};
+  const u8 hidden[4] = {0, 255, 0, 0};
+  u8 src[4 * 4];
+  memcpy(src + 0, red, 4);
+  memcpy(src + 4, hidden, 4);
+  memcpy(src + 8, hidden, 4);
+  memcpy(src + 12, red, 4);
+
+  u8 box[4];
+  u8 cut[4];
+  mip_box_rgba8(box, src, 2, 2);
+  mip_cutout_rgba8(cut, src, 2, 2);
+  check(box[1] > 100);  // the plain box filter lets the green through
+  check(cut[0] == 200 && cut[1] == 0 && cut[2] == 0 && cut[3] == 128);
+
+  u16 lin[4 * 4];
+  u16 lcut[4];
+  u8 back[4];
+  mip_to_linear(lin, src, 4);
+  mip_cutout_rgba16(lcut, lin, 2, 2);
+  mip_from_linear(back, lcut, 1);
+  check(back[0] == 200 && back[1] == 0 && back[2] == 0 && back[3] == 128);
+
+  // with nothing opaque the block is cleared, its colour is the average
+  memcpy(src + 0, hidden, 4);
+  memcpy(src + 12, hidden, 4);
+  mip_cutout_rgba8(cut, src, 2, 2);
+  check(cut[1] == 255 && cut[3] == 0);
+  return true;
+}
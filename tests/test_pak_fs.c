@@ -0,0 +1,125 @@
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../src/pak/pak_fs.h"
+#include "test.h"
+
+// A pak with a nested directory and a duplicate name, the first copy of a
+// name is the one lookups must see
+static const struct {
+  cstr name;
+  cstr data;
+} files[] = {
+    {"maps/e1m1.bsp", "first map"},
+    {"maps/e1m2.bsp", "second map"},
+    {"progs.dat", "progs"},
+    {"maps/e1m1.bsp", "shadowed"},
+};
+
+static constexpr u32 FILES = sizeof(files) / sizeof(*files);
+
+static bool _write_pak(char* path) {
+  i32 fd = mkstemps(path, 4);
+  if (fd < 0)
+    return false;
+  FILE* f = fdopen(fd, "wb");
+  if (!f)
+    return false;
+
+  u32 at = HEADER_LEN;
+  pak_entry table[FILES];
+  memset(table, 0, sizeof(table));
+  for (u32 i = 0; i < FILES; i++) {
+    strncpy((char*)table[i].name, files[i].name, ENTRY_NAME_LEN);
+    table[i].offset = endian_i32((i32)at);
+    table[i].size = endian_i32((i32)strlen(files[i].data));
+    at += strlen(files[i].data);
+  }
+
+  pak_header h = {.offset = endian_i32((i32)at),
+                  .size = endian_i32((i32)sizeof(table))};
+  memcpy(h.magic_code, MAGIC_CODE, MAGIC_CODE_LEN);
+
+  bool ok = fwrite(&h, sizeof(h), 1, f) == 1;
+  for (u32 i = 0; i < FILES; i++)
+    ok = ok && fwrite(files[i].data, strlen(files[i].data), 1, f) == 1;
+  ok = ok && fwrite(table, sizeof(table), 1, f) == 1;
+  return !fclose(f) && ok;
+}
+
+static bool _read_entry(fs* pfs, cstr name, cstr want, bool mapped) {
+  fs_file* f = NULL;
+  check(fs_file_open(pfs, name, FS_READ, &f) == FS_SUCCESS);
+
+  char buf[64] = {0};
+  sz n = 0;
+  check(fs_file_read(f, buf, sizeof(buf), &n) == FS_SUCCESS);
+  check(n == strlen(want) && !memcmp(buf, want, n));
+
+  sz dz = 0;
+  const u8* d = pak_fs_file_data(f, &dz);
+  check(mapped ? d && dz == n && !memcmp(d, want, n) : !d);
+  fs_file_close(f);
+  return true;
+}
+
+static bool _check_tree(fs* pfs, bool mapped) {
+  check(_read_entry(pfs, "maps/e1m1.bsp", "first map", mapped));
+  check(_read_entry(pfs, "progs.dat", "progs", mapped));
+
+  fs_file_info fi;
+  check(fs_info(pfs, "maps", FS_READ, &fi) == FS_SUCCESS && fi.directory);
+  check(fs_info(pfs, "nope", FS_READ, &fi) != FS_SUCCESS);
+
+  u32 seen = 0;
+  for (fs_iterator* it = fs_first(pfs, "maps", FS_READ); it; it = fs_next(it))
+    seen++;
+  check(seen == 2);
+  return true;
+}
+
+static fs* _init(fs_archive_type* types) {
+  fs_config c = fs_config_init(FS_STDIO, NULL, NULL);
+  c.pArchiveTypes = types;
+  c.archiveTypeCount = 1;
+  fs* pfs = NULL;
+  return fs_init(&c, &pfs) == FS_SUCCESS ? pfs : NULL;
+}
+
+// fs_uninit asserts when a mount still holds archive references, so both
+// tests run to the end only if every opened entry gave its reference back
+bool test_pak_fs_stream(void) {
+  char path[] = "/tmp/sqt-pak-fs-XXXXXX.pak";
+  check(_write_pak(path));
+
+  fs_archive_type types[] = {{PAK_FS, "pak"}};
+  fs* pfs = _init(types);
+  check(pfs);
+
+  check(fs_mount(pfs, path, "", FS_READ) == FS_SUCCESS);
+  bool ok = _check_tree(pfs, false);
+  fs_unmount(pfs, path, FS_READ);
+
+  fs_uninit(pfs);
+  unlink(path);
+  return ok;
+}
+
+bool test_pak_fs_mapped(void) {
+  char path[] = "/tmp/sqt-pak-fs-XXXXXX.pak";
+  check(_write_pak(path));
+
+  fs_archive_type types[] = {{PAK_FS, "pak"}};
+  fs* pfs = _init(types);
+  check(pfs);
+
+  pak_fs_mapped m = {0};
+  check(pak_fs_mount(pfs, path, "", &m) == FS_SUCCESS);
+  bool ok = _check_tree(pfs, true);
+  pak_fs_unmount(pfs, &m);
+
+  fs_uninit(pfs);
+  unlink(path);
+  return ok;
+}
@@ -0,0 +1,101 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "../src/utils/intern.h"
+#include "../src/utils/pool.h"
+#include "test.h"
+
+bool test_pool_reuse(void) {
+  arena m = {0};
+  arena_create(&m, 4096);
+  pool p;
+  pool_create(&p, &m, 24, 8, 4);
+
+  void* a = pool_alloc(&p);
+  void* b = pool_alloc(&p);
+  check(a && b && a != b);
+  check(p.used == 2 && p.capacity == 4);
+
+  // a released slot is the next one handed out, zeroed again
+  memset(a, 0xAB, 24);
+  pool_free(&p, a);
+  check(p.used == 1);
+  u8* c = (u8*)pool_alloc(&p);
+  check(c == a);
+  for (u32 i = 0; i < 24; i++)
+    check(c[i] == 0);
+
+  // releasing everything and starting over carves nothing new
+  sz used = m.offset;
+  pool_free(&p, b);
+  pool_free(&p, c);
+  for (u32 i = 0; i < 4; i++)
+    check(pool_alloc(&p) != NULL);
+  check(p.capacity == 4 && m.offset == used);
+
+  arena_destroy(&m);
+  return true;
+}
+
+bool test_pool_grow(void) {
+  arena m = {0};
+  arena_create(&m, 4096);
+  pool p;
+  pool_create(&p, &m, 40, 16, 4);
+
+  // three blocks and a bit, every slot aligned and none overlapping
+  u8* slots[13];
+  for (u32 i = 0; i < 13; i++) {
+    slots[i] = (u8*)pool_alloc(&p);
+    check(slots[i] != NULL);
+    check(((uintptr_t)slots[i] & 15) == 0);
+    memset(slots[i], (int)i, 40);
+  }
+  check(p.capacity == 16 && p.used == 13);
+  for (u32 i = 0; i < 13; i++) {
+    for (u32 k = 0; k < 40; k++)
+      check(slots[i][k] == (u8)i);
+  }
+
+  // a block that no longer fits the arena ends the pool, not the program
+  while (pool_alloc(&p))
+    ;
+  check(p.used == p.capacity && m.size - m.offset < 48 * 4);
+
+  arena_destroy(&m);
+  return true;
+}
+
+bool test_intern_identity(void) {
+  arena m = {0};
+  arena_create(&m, 64 * 1024);
+  interner in;
+  intern_create(&in, &m, 2);  // tiny on purpose, so the table rehashes
+
+  char a[] = "maps/e1m1.bsp";
+  char b[] = "maps/e1m1.bsp";
+  check(intern_find(&in, a, strlen(a)) == NULL);
+  cstr first = intern_cstr(&in, a);
+  check(first != a && !strcmp(first, a));
+  check(intern_cstr(&in, b) == first);
+  check(intern(&in, "maps/e1m1.bsp.bak", 13) == first);
+  check(intern_cstr(&in, "maps/e1m2.bsp") != first);
+
+  // pointers handed out before a rehash stay the canonical copies after it
+  char name[32];
+  cstr names[100];
+  for (u32 i = 0; i < 100; i++) {
+    snprintf(name, sizeof(name), "sound/s%u.wav", i);
+    names[i] = intern_cstr(&in, name);
+  }
+  check(in.buckets_count >= 64 && in.count == 102);
+  for (u32 i = 0; i < 100; i++) {
+    snprintf(name, sizeof(name), "sound/s%u.wav", i);
+    check(intern_find(&in, name, strlen(name)) == names[i]);
+    check(intern_cstr(&in, name) == names[i]);
+  }
+  check(intern_find(&in, a, strlen(a)) == first && in.count == 102);
+
+  arena_destroy(&m);
+  return true;
+}